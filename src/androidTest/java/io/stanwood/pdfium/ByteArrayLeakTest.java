@@ -0,0 +1,40 @@
+package io.stanwood.pdfium;
+
+import android.os.Debug;
+import android.test.AndroidTestCase;
+
+/**
+ * Documents opened from a byte[] are copied to native memory, the copy has to be freed when the
+ * document is closed. Leaking it once per open would grow the native heap by the document size
+ * on every iteration.
+ */
+public class ByteArrayLeakTest extends AndroidTestCase {
+    private static final int DOCUMENT_PADDING = 4 * 1024 * 1024;
+    private static final int ITERATIONS = 50;
+
+    public void testOpenAndCloseDoesNotGrowNativeHeap() {
+        byte[] data = TestDocuments.create(4, DOCUMENT_PADDING);
+        // pdfium's global state and the allocator's arenas are set up by the first documents
+        for (int i = 0; i < 3; i++) {
+            openAndClose(data);
+        }
+        long before = Debug.getNativeHeapAllocatedSize();
+        for (int i = 0; i < ITERATIONS; i++) {
+            openAndClose(data);
+        }
+        long growth = Debug.getNativeHeapAllocatedSize() - before;
+        // A leaked copy per open would be ITERATIONS times the document size
+        assertTrue("Native heap grew by " + growth + " bytes over " + ITERATIONS + " documents of "
+                + data.length + " bytes", growth < 2L * data.length);
+    }
+
+    private static void openAndClose(byte[] data) {
+        PdfDocument document = new PdfDocument(data, null);
+        try {
+            assertEquals(4, document.getPageCount());
+            document.openPage(0).close();
+        } finally {
+            document.close();
+        }
+    }
+}
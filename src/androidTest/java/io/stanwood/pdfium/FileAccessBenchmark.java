@@ -0,0 +1,96 @@
+package io.stanwood.pdfium;
+
+import android.graphics.Bitmap;
+import android.graphics.Color;
+import android.os.ParcelFileDescriptor;
+import android.test.AndroidTestCase;
+import android.util.Log;
+
+import java.io.File;
+import java.util.Locale;
+
+/**
+ * Open and first render latency of the two file access backends, with the syscalls each of
+ * them made. The numbers are logged under the tag FileAccessBenchmark. The document file is in
+ * the page cache after the first open, so the runs compare the cost of serving pdfium's reads
+ * rather than the cost of the storage.
+ */
+public class FileAccessBenchmark extends AndroidTestCase {
+    private static final String TAG = "FileAccessBenchmark";
+    private static final int RUNS = 5;
+
+    private File mFile;
+    private Bitmap mBitmap;
+
+    @Override
+    protected void setUp() throws Exception {
+        super.setUp();
+        // Large enough that the read path cannot hold the document in its block cache
+        mFile = TestDocuments.createFile(getContext().getCacheDir(), "file-access-benchmark.pdf", 200, 8 * 1024 * 1024);
+        mBitmap = Bitmap.createBitmap(1080, 1400, Bitmap.Config.ARGB_8888);
+    }
+
+    @Override
+    protected void tearDown() throws Exception {
+        mBitmap.recycle();
+        mFile.delete();
+        super.tearDown();
+    }
+
+    public void testOpenAndFirstRender() throws Exception {
+        // Page cache and library initialization are warm for both backends
+        measure(PdfDocument.FILE_ACCESS_READ);
+        Result read = measure(PdfDocument.FILE_ACCESS_READ);
+        Result mapped = measure(PdfDocument.FILE_ACCESS_MAPPED);
+        for (int run = 1; run < RUNS; run++) {
+            read = read.best(measure(PdfDocument.FILE_ACCESS_READ));
+            mapped = mapped.best(measure(PdfDocument.FILE_ACCESS_MAPPED));
+        }
+        Log.i(TAG, String.format(Locale.US, "%d KB document, best of %d runs", mFile.length() / 1024, RUNS));
+        Log.i(TAG, "read:   " + read);
+        Log.i(TAG, "mapped: " + mapped);
+        assertTrue(mapped.stats.mapped);
+        assertFalse(read.stats.mapped);
+        assertTrue(mapped.stats.syscalls < read.stats.syscalls);
+    }
+
+    private Result measure(int fileAccess) throws Exception {
+        long start = System.nanoTime();
+        PdfDocument document = new PdfDocument(ParcelFileDescriptor.open(mFile, ParcelFileDescriptor.MODE_READ_ONLY), null, fileAccess);
+        try {
+            long opened = System.nanoTime();
+            PdfDocument.PdfPage page = document.openPage(0);
+            try {
+                page.render(mBitmap, 0, 0, mBitmap.getWidth(), mBitmap.getHeight(), Color.WHITE, false, 0);
+            } finally {
+                page.close();
+            }
+            long rendered = System.nanoTime();
+            return new Result(opened - start, rendered - opened, document.getFileAccessStats());
+        } finally {
+            document.close();
+        }
+    }
+
+    private static final class Result {
+        final long openNanos;
+        final long firstRenderNanos;
+        final PdfDocument.FileAccessStats stats;
+
+        Result(long openNanos, long firstRenderNanos, PdfDocument.FileAccessStats stats) {
+            this.openNanos = openNanos;
+            this.firstRenderNanos = firstRenderNanos;
+            this.stats = stats;
+        }
+
+        Result best(Result other) {
+            return other.openNanos + other.firstRenderNanos < openNanos + firstRenderNanos ? other : this;
+        }
+
+        @Override
+        public String toString() {
+            return String.format(Locale.US, "open %.2f ms, first render %.2f ms, %d reads of %d KB, %d syscalls",
+                    openNanos / 1e6, firstRenderNanos / 1e6, stats.reads, stats.bytesRead / 1024, stats.syscalls);
+        }
+    }
+}
@@ -0,0 +1,86 @@
+package io.stanwood.pdfium;
+
+import android.graphics.Bitmap;
+import android.graphics.Color;
+import android.test.AndroidTestCase;
+import android.util.Log;
+
+import java.util.Locale;
+
+/**
+ * Render cost of the quality modes on a generated document of text and curves. The time per
+ * page of every mode is logged under the tag RenderQualityBenchmark.
+ */
+public class RenderQualityBenchmark extends AndroidTestCase {
+    private static final String TAG = "RenderQualityBenchmark";
+    private static final int PAGE_COUNT = 8;
+    private static final int RUNS = 3;
+    private static final int BITMAP_WIDTH = 1080;
+
+    private PdfDocument mDocument;
+    private Bitmap mBitmap;
+
+    @Override
+    protected void setUp() throws Exception {
+        super.setUp();
+        mDocument = new PdfDocument(TestDocuments.create(PAGE_COUNT, 0), null);
+        PdfDocument.PdfPage page = mDocument.openPage(0);
+        try {
+            mBitmap = Bitmap.createBitmap(BITMAP_WIDTH, BITMAP_WIDTH * page.height / page.width, Bitmap.Config.ARGB_8888);
+        } finally {
+            page.close();
+        }
+    }
+
+    @Override
+    protected void tearDown() throws Exception {
+        mBitmap.recycle();
+        mDocument.close();
+        super.tearDown();
+    }
+
+    public void testRenderCostPerMode() {
+        // Fonts, glyph and image caches are warm for every mode
+        renderAllPages(0);
+        long normal = bestNanosPerPage(0);
+        long draft = bestNanosPerPage(PdfDocument.PdfPage.RENDER_FLAG_DRAFT);
+        long print = bestNanosPerPage(PdfDocument.PdfPage.RENDER_FLAG_PRINT);
+        Log.i(TAG, String.format(Locale.US, "%dx%d, ms per page: normal %.2f, draft %.2f (%.2fx), print %.2f (%.2fx)",
+                mBitmap.getWidth(), mBitmap.getHeight(), normal / 1e6, draft / 1e6, (double) normal / draft,
+                print / 1e6, (double) normal / print));
+        assertTrue(normal > 0 && draft > 0 && print > 0);
+    }
+
+    public void testDraftAndPrintExcludeEachOther() {
+        PdfDocument.PdfPage page = mDocument.openPage(0);
+        try {
+            page.render(mBitmap, 0, 0, mBitmap.getWidth(), mBitmap.getHeight(), Color.WHITE, false,
+                    PdfDocument.PdfPage.RENDER_FLAG_DRAFT | PdfDocument.PdfPage.RENDER_FLAG_PRINT);
+            fail("RENDER_FLAG_DRAFT | RENDER_FLAG_PRINT must be rejected");
+        } catch (IllegalArgumentException expected) {
+        } finally {
+            page.close();
+        }
+    }
+
+    private long bestNanosPerPage(int renderFlags) {
+        long best = Long.MAX_VALUE;
+        for (int run = 0; run < RUNS; run++) {
+            long start = System.nanoTime();
+            renderAllPages(renderFlags);
+            best = Math.min(best, System.nanoTime() - start);
+        }
+        return best / PAGE_COUNT;
+    }
+
+    private void renderAllPages(int renderFlags) {
+        for (int i = 0; i < PAGE_COUNT; i++) {
+            PdfDocument.PdfPage page = mDocument.openPage(i);
+            try {
+                page.render(mBitmap, 0, 0, mBitmap.getWidth(), mBitmap.getHeight(), Color.WHITE, false, renderFlags);
+            } finally {
+                page.close();
+            }
+        }
+    }
+}
@@ -0,0 +1,146 @@
+package io.stanwood.pdfium;
+
+import java.io.ByteArrayOutputStream;
+import java.io.File;
+import java.io.FileOutputStream;
+import java.io.IOException;
+import java.nio.charset.Charset;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.Locale;
+import java.util.Random;
+
+/**
+ * Generated PDF documents for the instrumentation tests, so no test files have to be shipped.
+ * Every page has a column of text and a few hundred stroked curves, which keeps text, path
+ * anti-aliasing and pdfium's content parsing busy the way a real page does.
+ */
+final class TestDocuments {
+    private static final Charset ASCII = Charset.forName("US-ASCII");
+    private static final int PAGE_WIDTH = 612;
+    private static final int PAGE_HEIGHT = 792;
+
+    private TestDocuments() {
+    }
+
+    /**
+     * @param pageCount    number of pages
+     * @param paddingBytes size of an unreferenced filler stream, to make the document as large
+     *                     as a real one with images
+     */
+    static byte[] create(int pageCount, int paddingBytes) {
+        Writer writer = new Writer();
+        writer.write("%PDF-1.4\n");
+        int firstPage = 4;
+        writer.startObject(1);
+        writer.write("<< /Type /Catalog /Pages 2 0 R >>\n");
+        writer.endObject();
+        StringBuilder kids = new StringBuilder();
+        for (int i = 0; i < pageCount; i++) {
+            kids.append(firstPage + i * 2).append(" 0 R ");
+        }
+        writer.startObject(2);
+        writer.write("<< /Type /Pages /Kids [" + kids + "] /Count " + pageCount + " >>\n");
+        writer.endObject();
+        writer.startObject(3);
+        writer.write("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>\n");
+        writer.endObject();
+        for (int i = 0; i < pageCount; i++) {
+            int page = firstPage + i * 2;
+            writer.startObject(page);
+            writer.write("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 " + PAGE_WIDTH + " " + PAGE_HEIGHT
+                    + "] /Resources << /Font << /F1 3 0 R >> >> /Contents " + (page + 1) + " 0 R >>\n");
+            writer.endObject();
+            writer.startObject(page + 1);
+            writer.writeStream(pageContent(i).getBytes(ASCII));
+            writer.endObject();
+        }
+        int objectCount = firstPage + pageCount * 2;
+        if (paddingBytes > 0) {
+            byte[] padding = new byte[paddingBytes];
+            new Random(paddingBytes).nextBytes(padding);
+            writer.startObject(objectCount);
+            writer.writeStream(padding);
+            writer.endObject();
+            objectCount++;
+        }
+        writer.finish(objectCount);
+        return writer.toByteArray();
+    }
+
+    static File createFile(File directory, String name, int pageCount, int paddingBytes) throws IOException {
+        File file = new File(directory, name);
+        FileOutputStream output = new FileOutputStream(file);
+        try {
+            output.write(create(pageCount, paddingBytes));
+        } finally {
+            output.close();
+        }
+        return file;
+    }
+
+    private static String pageContent(int pageIndex) {
+        Random random = new Random(pageIndex);
+        StringBuilder content = new StringBuilder();
+        content.append("BT /F1 11 Tf 14 TL 40 750 Td\n");
+        for (int line = 0; line < 48; line++) {
+            content.append("(Page ").append(pageIndex + 1).append(" line ").append(line + 1)
+                    .append(": the quick brown fox jumps over the lazy dog 0123456789) '\n");
+        }
+        content.append("ET\n");
+        for (int path = 0; path < 400; path++) {
+            content.append(String.format(Locale.US, "%.2f %.2f %.2f RG %.1f w ", random.nextFloat(),
+                    random.nextFloat(), random.nextFloat(), 0.2f + random.nextFloat() * 2));
+            content.append(point(random)).append(" m ");
+            content.append(point(random)).append(' ').append(point(random)).append(' ')
+                    .append(point(random)).append(" c S\n");
+        }
+        return content.toString();
+    }
+
+    private static String point(Random random) {
+        return random.nextInt(PAGE_WIDTH) + " " + random.nextInt(PAGE_HEIGHT);
+    }
+
+    // Keeps the offsets of the objects for the cross reference table
+    private static final class Writer {
+        private final ByteArrayOutputStream mOutput = new ByteArrayOutputStream();
+        private final List<Integer> mOffsets = new ArrayList<>();
+
+        void write(String text) {
+            byte[] bytes = text.getBytes(ASCII);
+            mOutput.write(bytes, 0, bytes.length);
+        }
+
+        void startObject(int number) {
+            while (mOffsets.size() < number) {
+                mOffsets.add(0);
+            }
+            mOffsets.set(number - 1, mOutput.size());
+            write(number + " 0 obj\n");
+        }
+
+        void writeStream(byte[] data) {
+            write("<< /Length " + data.length + " >>\nstream\n");
+            mOutput.write(data, 0, data.length);
+            write("\nendstream\n");
+        }
+
+        void endObject() {
+            write("endobj\n");
+        }
+
+        void finish(int objectCount) {
+            int xref = mOutput.size();
+            write("xref\n0 " + (objectCount + 1) + "\n0000000000 65535 f \n");
+            for (int i = 0; i < objectCount; i++) {
+                write(String.format(Locale.US, "%010d 00000 n \n", mOffsets.get(i)));
+            }
+            write("trailer\n<< /Size " + (objectCount + 1) + " /Root 1 0 R >>\nstartxref\n" + xref + "\n%%EOF\n");
+        }
+
+        byte[] toByteArray() {
+            return mOutput.toByteArray();
+        }
+    }
+}
@@ -1,8 +1,10 @@
 package io.stanwood.pdfium;
 
+import android.content.res.AssetFileDescriptor;
 import android.graphics.Bitmap;
 import android.graphics.Color;
 import android.graphics.Point;
+import android.graphics.Rect;
 import android.graphics.RectF;
 import android.os.ParcelFileDescriptor;
 import android.support.annotation.NonNull;
@@ -11,19 +13,37 @@ import android.util.Log;
 import android.view.Surface;
 
 import java.io.Closeable;
+import java.io.File;
 import java.io.FileDescriptor;
 import java.io.IOException;
 import java.lang.reflect.Field;
+import java.nio.ByteBuffer;
 import java.util.ArrayList;
+import java.util.Arrays;
 import java.util.Collections;
+import java.util.HashMap;
+import java.util.Iterator;
 import java.util.List;
 
 public class PdfDocument implements Closeable {
+    /**
+     * Map a regular file once and copy the blocks pdfium reads out of the mapping. Descriptors
+     * which cannot be mapped, e.g. pipes and sockets, and files on FUSE storage such as shared
+     * storage on Android 11 and later are read as with {@link #FILE_ACCESS_READ}.
+     */
+    public static final int FILE_ACCESS_MAPPED = 0;
+    /**
+     * Read the file in 64 KB blocks kept in a small LRU cache, adjacent and repeated reads of
+     * pdfium share one syscall. Blocks following a sequential read are read ahead.
+     */
+    public static final int FILE_ACCESS_READ = 1;
+
     private static final String TAG = PdfDocument.class.getName();
     private static final Class FD_CLASS = FileDescriptor.class;
     private static final String FD_FIELD_NAME = "descriptor";
     private static final Object lock = new Object();
     private static Field mFdField = null;
+    private static long sNextDocumentId = 1;
 
     static {
         try {
@@ -39,24 +59,100 @@ public class PdfDocument implements Closeable {
     }
 
     private final Point mTempPoint = new Point();
+    // Identifies this document in tile caches, native pointers may be reused after close
+    private final long mDocumentId;
     private ParcelFileDescriptor mFileDescriptor;
+    // Range of the file holding the document
+    private long mFileOffset;
+    private long mFileLength;
+    // Kept for render workers, which open the document again
+    private final String mPassword;
     private int mPageCount;
     private long mNativePtr;
 
     public PdfDocument(@NonNull ParcelFileDescriptor input, @Nullable String password) {
+        this(input, password, FILE_ACCESS_MAPPED);
+    }
+
+    /**
+     * @param fileAccess {@link #FILE_ACCESS_MAPPED} or {@link #FILE_ACCESS_READ}. The file must
+     *                   not be truncated while a mapping of it is open.
+     */
+    public PdfDocument(@NonNull ParcelFileDescriptor input, @Nullable String password, int fileAccess) {
+        this(input, 0, -1, password, fileAccess);
+    }
+
+    /**
+     * Open a document stored in a range of a file in place, e.g. an uncompressed entry of an
+     * archive or bundle, without extracting it first.
+     *
+     * @param length     bytes of the document from offset on, -1 for the rest of the file
+     * @param fileAccess {@link #FILE_ACCESS_MAPPED} or {@link #FILE_ACCESS_READ}
+     */
+    public PdfDocument(@NonNull ParcelFileDescriptor input, long offset, long length, @Nullable String password, int fileAccess) {
         mFileDescriptor = input;
+        mPassword = password;
         synchronized (lock) {
+            mDocumentId = sNextDocumentId++;
             long size = nativeGetFileSize(getNumFd(input));
-            initDocument(nativeOpen(mFileDescriptor.getFd(), size, password));
+            if (length < 0) {
+                length = size - offset;
+            }
+            if (offset < 0 || length <= 0 || offset + length > size) {
+                throw new IllegalArgumentException("Document range outside of the file");
+            }
+            mFileOffset = offset;
+            mFileLength = length;
+            initDocument(nativeOpen(mFileDescriptor.getFd(), offset, length, password, fileAccess));
         }
     }
 
+    /**
+     * Open a document from an asset in place. The asset must be stored uncompressed, e.g. with
+     * {@code aaptOptions { noCompress "pdf" }}, compressed assets have no file descriptor. The
+     * asset is closed with the document.
+     */
+    public PdfDocument(@NonNull AssetFileDescriptor asset, @Nullable String password) {
+        this(asset.getParcelFileDescriptor(), asset.getStartOffset(), asset.getLength(), password, FILE_ACCESS_MAPPED);
+    }
+
+    /**
+     * The data is copied, the copy is released when the document is closed. Use
+     * {@link #PdfDocument(ByteBuffer, String)} to open a large document without a copy.
+     */
     public PdfDocument(@NonNull byte[] data, @Nullable String password) {
+        mPassword = password;
         synchronized (lock) {
+            mDocumentId = sNextDocumentId++;
             initDocument(nativeOpenByteArray(data, password));
         }
     }
 
+    /**
+     * Open the document between position and limit of a direct buffer in place, e.g. a mapped
+     * file or memory owned by other native code. The bytes must not change while the document
+     * is open, the buffer is kept reachable until it is closed.
+     */
+    public PdfDocument(@NonNull ByteBuffer data, @Nullable String password) {
+        if (!data.isDirect()) {
+            throw new IllegalArgumentException("Buffer must be direct");
+        }
+        mPassword = password;
+        synchronized (lock) {
+            mDocumentId = sNextDocumentId++;
+            initDocument(nativeOpenDirectBuffer(data, data.position(), data.remaining(), password));
+        }
+    }
+
+    // Opened by a StreamingLoader
+    private PdfDocument(long nativePtr, @Nullable String password) {
+        mPassword = password;
+        synchronized (lock) {
+            mDocumentId = sNextDocumentId++;
+            initDocument(nativePtr);
+        }
+    }
+
     private static int getNumFd(ParcelFileDescriptor fdObj) {
         try {
             if (mFdField == null) {
@@ -76,6 +172,21 @@ public class PdfDocument implements Closeable {
 
     private static native long nativeInit();
 
+    /**
+     * Release the native scratch buffers kept between renders, call from
+     * {@link android.content.ComponentCallbacks2#onTrimMemory(int)}.
+     * Buffers used by a running render are kept until it finishes.
+     */
+    public static void trimMemory() {
+        nativeTrimScratchBuffers();
+    }
+
+    public static ScratchBufferStats getScratchBufferStats() {
+        long[] stats = new long[7];
+        nativeGetScratchBufferStats(stats);
+        return new ScratchBufferStats(stats[0], stats[1], stats[2], stats[3], stats[4], stats[5], stats[6]);
+    }
+
     private void initDocument(long nativePtr) {
         synchronized (lock) {
             mNativePtr = nativePtr;
@@ -95,6 +206,23 @@ public class PdfDocument implements Closeable {
         }
     }
 
+    /**
+     * How pdfium has read this document so far, e.g. to compare the FILE_ACCESS_* modes.
+     *
+     * @return null if the document was not opened from a file descriptor
+     */
+    @Nullable
+    public FileAccessStats getFileAccessStats() {
+        long[] stats = new long[7];
+        synchronized (lock) {
+            throwIfClosed();
+            if (!nativeGetFileAccessStats(mNativePtr, stats)) {
+                return null;
+            }
+        }
+        return new FileAccessStats(stats[0] != 0, stats[1], stats[2], stats[3], stats[4], stats[5], stats[6]);
+    }
+
     public Point getPageSize(int pageIndex) {
         Point point = new Point();
         synchronized (lock) {
@@ -123,6 +251,65 @@ public class PdfDocument implements Closeable {
         return mPageCount;
     }
 
+    /**
+     * Render many pages in one native call and one lock acquisition, e.g. for thumbnail grids.
+     * Pages are opened and closed by the call, consecutive jobs on the same page share it. The
+     * status and time of each job are stored in the job.
+     *
+     * @param renderFlags combination of the {@link PdfPage} RENDER_FLAG_* options
+     * @param token       optional token, once it is cancelled the remaining jobs are skipped
+     */
+    public void renderPages(@NonNull RenderJob[] jobs, long backgroundColor, boolean renderAnnot, int renderFlags, @Nullable RenderToken token) {
+        checkRenderFlags(renderFlags);
+        int[] pageIndices = new int[jobs.length];
+        Bitmap[] bitmaps = new Bitmap[jobs.length];
+        int[] viewports = new int[jobs.length * 4];
+        packRenderJobs(jobs, pageIndices, bitmaps, viewports);
+        int[] status = new int[jobs.length];
+        long[] nanos = new long[jobs.length];
+        Arrays.fill(status, RenderToken.STATUS_FAILED);
+        synchronized (lock) {
+            throwIfClosed();
+            if (token != null) {
+                token.throwIfClosed();
+            }
+            try {
+                nativeRenderPages(mNativePtr, pageIndices, bitmaps, viewports, backgroundColor, renderAnnot, renderFlags, token != null ? token.mNativePtr : 0, status, nanos);
+            } catch (Exception e) {
+                Log.e(TAG, "Exception throw from native");
+                e.printStackTrace();
+                Arrays.fill(status, RenderToken.STATUS_FAILED);
+            }
+        }
+        unpackRenderJobs(jobs, status, nanos);
+    }
+
+    // The quality flags select one pdfium rendering mode each and cannot be combined
+    private static void checkRenderFlags(int renderFlags) {
+        if ((renderFlags & PdfPage.RENDER_FLAG_DRAFT) != 0 && (renderFlags & PdfPage.RENDER_FLAG_PRINT) != 0) {
+            throw new IllegalArgumentException("RENDER_FLAG_DRAFT and RENDER_FLAG_PRINT exclude each other");
+        }
+    }
+
+    private static void packRenderJobs(RenderJob[] jobs, int[] pageIndices, Bitmap[] bitmaps, int[] viewports) {
+        for (int i = 0; i < jobs.length; i++) {
+            RenderJob job = jobs[i];
+            pageIndices[i] = job.pageIndex;
+            bitmaps[i] = job.bitmap;
+            viewports[i * 4] = job.startX;
+            viewports[i * 4 + 1] = job.startY;
+            viewports[i * 4 + 2] = job.drawSizeX;
+            viewports[i * 4 + 3] = job.drawSizeY;
+        }
+    }
+
+    private static void unpackRenderJobs(RenderJob[] jobs, int[] status, long[] nanos) {
+        for (int i = 0; i < jobs.length; i++) {
+            jobs[i].mStatus = status[i];
+            jobs[i].mRenderTimeNanos = nanos[i];
+        }
+    }
+
     /**
      * Get metadata for given document
      */
@@ -198,10 +385,12 @@ public class PdfDocument implements Closeable {
 
     private native long nativeGetFileSize(int fd);
 
-    private native long nativeOpen(int fd, long size, String password);
+    private native long nativeOpen(int fd, long offset, long size, String password, int fileAccess);
 
     private native void nativeClose(long documentPtr);
 
+    private static native boolean nativeGetFileAccessStats(long documentPtr, long[] outStats);
+
     private native long nativeOpenPageAndGetSize(long documentPtr, int pageIndex, Point outSize);
 
     private native boolean nativeScaleForPrinting(long documentPtr);
@@ -234,11 +423,115 @@ public class PdfDocument implements Closeable {
 
     private native long nativeOpenByteArray(byte[] data, String password);
 
+    private native long nativeOpenDirectBuffer(ByteBuffer data, int offset, int length, String password);
+
     private native void nativeClosePage(long pagePtr);
 
     private native void nativeRenderPage(long pagePtr, Surface surface, int startX, int startY, int drawSizeHor, int drawSizeVer, boolean renderAnnot);
 
-    private native void nativeRenderPageBitmap(long pagePtr, Bitmap bitmap, int startX, int startY, int drawSizeHor, int drawSizeVer, long backgroundColor, boolean renderAnnot);
+    private static native long nativeOpenSurfaceSession(Surface surface);
+
+    private static native void nativeUpdateSurfaceSession(long sessionPtr);
+
+    private static native void nativeCloseSurfaceSession(long sessionPtr);
+
+    private static native boolean nativeRenderSurfaceSession(long sessionPtr, long pagePtr, int startX, int startY, int drawSizeHor, int drawSizeVer, long backgroundColor, boolean renderAnnot, int renderFlags, int[] dirtyBounds);
+
+    private native boolean nativeRenderPageBuffer(long pagePtr, ByteBuffer buffer, int width, int height, int stride, int format, int startX, int startY, int drawSizeHor, int drawSizeVer, long backgroundColor, boolean renderAnnot, int renderFlags);
+
+    private static native boolean nativeEncodePage(long pagePtr, int fd, int imageFormat, int quality, int width, int height, int startX, int startY, int drawSizeHor, int drawSizeVer, long backgroundColor, boolean renderAnnot, int renderFlags);
+
+    private static native int nativeRenderPageToFile(long pagePtr, String tempDir, int width, int height, int format, int startX, int startY, int drawSizeHor, int drawSizeVer, long backgroundColor, boolean renderAnnot, int renderFlags, long[] outLayout);
+
+    private static native boolean nativeRenderPageScrolled(long pagePtr, Bitmap bitmap, int deltaX, int deltaY, int startX, int startY, int drawSizeHor, int drawSizeVer, long backgroundColor, boolean renderAnnot, int renderFlags);
+
+    private native void nativeRenderPages(long documentPtr, int[] pageIndices, Bitmap[] bitmaps, int[] viewports, long backgroundColor, boolean renderAnnot, int renderFlags, long tokenPtr, int[] outStatus, long[] outNanos);
+
+    private native void nativeRenderPageBitmap(long pagePtr, Bitmap bitmap, int startX, int startY, int drawSizeHor, int drawSizeVer, long backgroundColor, boolean renderAnnot, int renderFlags);
+
+    private native boolean nativeRenderPageTiles(long pagePtr, Bitmap atlas, int tileSize, float zoom, int[] tiles, long backgroundColor, boolean renderAnnot, int renderFlags, long tokenPtr, long cachePtr, long documentId, int pageIndex, boolean[] completed);
+
+    private static native long nativeCreateTileCache(long budgetBytes);
+
+    private static native void nativeDestroyTileCache(long cachePtr);
+
+    private static native void nativeSetTileCacheBudget(long cachePtr, long budgetBytes);
+
+    private static native void nativeClearTileCache(long cachePtr);
+
+    private static native void nativeGetTileCacheStats(long cachePtr, long[] outStats);
+
+    private static native long nativeCreateRenderPyramid(long budgetBytes);
+
+    private static native void nativeDestroyRenderPyramid(long pyramidPtr);
+
+    private static native int nativeBuildRenderPyramid(long pyramidPtr, long pagePtr, float scale, long backgroundColor, boolean renderAnnot, int renderFlags);
+
+    private static native int nativeFindPyramidLevel(long pyramidPtr, float scale);
+
+    private static native float nativeGetPyramidLevel(long pyramidPtr, int level, Point outSize);
+
+    private static native boolean nativeCopyPyramidLevel(long pyramidPtr, int level, Bitmap bitmap);
+
+    private static native void nativeClearRenderPyramid(long pyramidPtr);
+
+    private static native void nativeGetRenderPyramidStats(long pyramidPtr, long[] outStats);
+
+    private static native long nativeCreateRenderWorkerPool(int workerCount);
+
+    private static native void nativeDestroyRenderWorkerPool(long poolPtr);
+
+    private static native int nativeGetRenderWorkerCount(long poolPtr);
+
+    private static native void nativeRenderPagesInWorkers(long poolPtr, long documentId, int fd, long documentOffset, long documentLength, String password, int[] pageIndices, Bitmap[] bitmaps, int[] viewports, long backgroundColor, boolean renderAnnot, int renderFlags, int[] outStatus, long[] outNanos);
+
+    private static native long nativeCreateStreamSource(int fd, long length);
+
+    private static native void nativeReleaseStreamSource(long streamPtr);
+
+    private static native void nativeAddAvailableRange(long streamPtr, long offset, long length);
+
+    private static native long[] nativeGetRequestedRanges(long streamPtr);
+
+    private static native long nativeOpenStreamDocument(long streamPtr, String password);
+
+    private static native boolean nativeIsStreamPageAvailable(long streamPtr, int pageIndex);
+
+    private static native boolean nativeIsStreamLinearized(long streamPtr);
+
+    private static native long nativeCreateRenderQueue();
+
+    private static native void nativeDestroyRenderQueue(long queuePtr);
+
+    private static native long nativeSubmitRenderJob(long queuePtr, long documentId, int pageIndex, long tag, int priority, long group);
+
+    private static native long nativeTakeRenderJob(long queuePtr);
+
+    private static native boolean nativeCancelRenderJob(long queuePtr, long jobId);
+
+    private static native int nativeCancelRenderGroup(long queuePtr, long group);
+
+    private static native void nativeCloseRenderQueue(long queuePtr);
+
+    private static native void nativeGetRenderQueueStats(long queuePtr, long[] outStats);
+
+    private static native boolean nativeBlitCachedTiles(long cachePtr, long documentId, int pageIndex, Bitmap atlas, int tileSize, float zoom, int[] tiles, long backgroundColor, boolean renderAnnot, int renderFlags, boolean[] completed);
+
+    private native int nativeRenderPageBitmapProgressive(long pagePtr, long tokenPtr, Bitmap bitmap, int startX, int startY, int drawSizeHor, int drawSizeVer, long backgroundColor, boolean renderAnnot, int renderFlags, long timeSliceMillis, boolean publishPartial);
+
+    private static native long nativeCreateRenderToken();
+
+    private static native void nativeCancelRenderToken(long tokenPtr);
+
+    private static native boolean nativeIsRenderTokenCancelled(long tokenPtr);
+
+    private static native void nativeAbortRenderToken(long tokenPtr);
+
+    private static native void nativeDestroyRenderToken(long tokenPtr);
+
+    private static native void nativeTrimScratchBuffers();
+
+    private static native void nativeGetScratchBufferStats(long[] outStats);
 
     private native String nativeGetMetaText(long docPtr, String tag);
 
@@ -264,6 +557,88 @@ public class PdfDocument implements Closeable {
 
     private native void nativePageRectToDevice(long pagePtr, int startX, int startY, int sizeX, int sizeY, int rotate, float left, float top, float right, float bottom, RectF outRect);
 
+    /**
+     * Usage of the native buffers which intermediate render results (RGB_565 and tiles) go
+     * through. Buffers are reused between renders and grow to the largest size requested.
+     */
+    public static class ScratchBufferStats {
+        public final long acquires;
+        // Buffers allocated because no idle buffer was large enough
+        public final long allocations;
+        public final long trims;
+        public final long idleBuffers;
+        public final long idleBytes;
+        public final long usedBytes;
+        public final long highWaterBytes;
+
+        ScratchBufferStats(long acquires, long allocations, long trims, long idleBuffers, long idleBytes, long usedBytes, long highWaterBytes) {
+            this.acquires = acquires;
+            this.allocations = allocations;
+            this.trims = trims;
+            this.idleBuffers = idleBuffers;
+            this.idleBytes = idleBytes;
+            this.usedBytes = usedBytes;
+            this.highWaterBytes = highWaterBytes;
+        }
+    }
+
+    public static class FileAccessStats {
+        // False if the blocks are read with pread
+        public final boolean mapped;
+        // Blocks pdfium asked for and their total size
+        public final long reads;
+        public final long bytesRead;
+        public final long syscalls;
+        // Cache blocks of the read path found, read on demand and read ahead
+        public final long cacheHits;
+        public final long cacheMisses;
+        public final long readaheadBlocks;
+
+        FileAccessStats(boolean mapped, long reads, long bytesRead, long syscalls, long cacheHits, long cacheMisses, long readaheadBlocks) {
+            this.mapped = mapped;
+            this.reads = reads;
+            this.bytesRead = bytesRead;
+            this.syscalls = syscalls;
+            this.cacheHits = cacheHits;
+            this.cacheMisses = cacheMisses;
+            this.readaheadBlocks = readaheadBlocks;
+        }
+    }
+
+    /**
+     * One page of {@link #renderPages(RenderJob[], long, boolean, int, RenderToken)}, the page
+     * area between startX/startY and drawSizeX/drawSizeY is mapped as by {@link PdfPage#render}.
+     */
+    public static final class RenderJob {
+        public final int pageIndex;
+        public final Bitmap bitmap;
+        public final int startX;
+        public final int startY;
+        public final int drawSizeX;
+        public final int drawSizeY;
+        private int mStatus = RenderToken.STATUS_FAILED;
+        private long mRenderTimeNanos;
+
+        public RenderJob(int pageIndex, @NonNull Bitmap bitmap, int startX, int startY, int drawSizeX, int drawSizeY) {
+            this.pageIndex = pageIndex;
+            this.bitmap = bitmap;
+            this.startX = startX;
+            this.startY = startY;
+            this.drawSizeX = drawSizeX;
+            this.drawSizeY = drawSizeY;
+        }
+
+        // One of the RenderToken STATUS_* constants, STATUS_PARTIAL is never set
+        public int getStatus() {
+            return mStatus;
+        }
+
+        // Time spent on this job including opening the page
+        public long getRenderTimeNanos() {
+            return mRenderTimeNanos;
+        }
+    }
+
     public static class PdfSearchResult {
         public final int startIndex;
         public final int length;
@@ -274,32 +649,50 @@ public class PdfDocument implements Closeable {
         }
     }
 
-    public final class PdfTextSearch implements Closeable {
+    /**
+     * Drives a progressive render started with
+     * {@link PdfPage#renderProgressive(Bitmap, int, int, int, int, long, boolean, int, RenderToken, long)}.
+     * {@link #cancel()} may be called from any thread, it does not wait for a running render.
+     */
+    public static final class RenderToken implements Closeable {
+        // The page has been rendered completely
+        public final static int STATUS_COMPLETE = 0;
+        // The time slice ran out, call renderProgressive again with this token to continue
+        public final static int STATUS_PARTIAL = 1;
+        // The render was abandoned because the token has been cancelled
+        public final static int STATUS_CANCELLED = 2;
+        public final static int STATUS_FAILED = 3;
+
         private long mNativePtr;
+        private PdfPage mPage;
 
-        PdfTextSearch(long textPtr, String query, int startIndex, int flags) {
-            synchronized (lock) {
-                mNativePtr = nativeTextFindStart(textPtr, query, flags, startIndex);
-            }
+        public RenderToken() {
+            mNativePtr = nativeCreateRenderToken();
         }
 
-        @Nullable
-        public PdfSearchResult findNext() {
-            synchronized (lock) {
-                if (nativeTextFindNext(mNativePtr)) {
-                    return new PdfSearchResult(nativeTextGetSchResultIndex(mNativePtr), nativeTextGetSchCount(mNativePtr));
+        /**
+         * Stop the render at the next pause point. A cancelled token stays cancelled.
+         */
+        public void cancel() {
+            synchronized (this) {
+                if (mNativePtr != 0) {
+                    nativeCancelRenderToken(mNativePtr);
                 }
-                return null;
             }
         }
 
-        @Nullable
-        public PdfSearchResult findPrev() {
-            synchronized (lock) {
-                if (nativeTextFindPrev(mNativePtr)) {
-                    return new PdfSearchResult(nativeTextGetSchResultIndex(mNativePtr), nativeTextGetSchCount(mNativePtr));
-                }
-                return null;
+        public boolean isCancelled() {
+            synchronized (this) {
+                return mNativePtr == 0 || nativeIsRenderTokenCancelled(mNativePtr);
+            }
+        }
+
+        // Must be called while holding the render lock
+        private void abort() {
+            nativeAbortRenderToken(mNativePtr);
+            if (mPage != null) {
+                mPage.mProgressiveToken = null;
+                mPage = null;
             }
         }
 
@@ -310,11 +703,12 @@ public class PdfDocument implements Closeable {
         }
 
         private void doClose() {
-            if (mNativePtr != 0) {
-                synchronized (lock) {
-                    nativeTextFindClose(mNativePtr);
+            synchronized (lock) {
+                abort();
+                synchronized (this) {
+                    nativeDestroyRenderToken(mNativePtr);
+                    mNativePtr = 0;
                 }
-                mNativePtr = 0;
             }
         }
 
@@ -325,58 +719,133 @@ public class PdfDocument implements Closeable {
         }
     }
 
-    public final class PdfText implements Closeable {
-        // If not set, it will not match case by default.
-        public final static int SEARCH_FLAG_MATCHCASE = 0x00000001;
-        // If not set, it will not match the whole word by default.
-        public final static int SEARCH_MATCH_WHOLE_WORD = 0x00000002;
-
+    /**
+     * LRU cache of rendered tiles bounded by a byte budget, see
+     * {@link PdfPage#renderTiles(Bitmap, int, float, int[], long, boolean, int, RenderToken, TileCache)}.
+     * Tiles are kept per document, page, zoom and tile position and may be shared between documents.
+     */
+    public static final class TileCache implements Closeable {
         private long mNativePtr;
 
-        PdfText(long pagePtr) {
-            synchronized (lock) {
-                mNativePtr = nativeTextLoadPage(pagePtr);
+        public TileCache(long budgetBytes) {
+            mNativePtr = nativeCreateTileCache(budgetBytes);
+        }
+
+        public synchronized void setBudget(long budgetBytes) {
+            throwIfClosed();
+            nativeSetTileCacheBudget(mNativePtr, budgetBytes);
+        }
+
+        public synchronized void clear() {
+            throwIfClosed();
+            nativeClearTileCache(mNativePtr);
+        }
+
+        public synchronized Stats getStats() {
+            throwIfClosed();
+            long[] stats = new long[6];
+            nativeGetTileCacheStats(mNativePtr, stats);
+            return new Stats(stats[0], stats[1], stats[2], stats[3], stats[4], stats[5]);
+        }
+
+        // Returns true when every tile has been found
+        private synchronized boolean blitTiles(long documentId, int pageIndex, Bitmap atlas, int tileSize, float zoom, int[] tiles, long backgroundColor, boolean renderAnnot, int renderFlags, boolean[] completed) {
+            throwIfClosed();
+            return nativeBlitCachedTiles(mNativePtr, documentId, pageIndex, atlas, tileSize, zoom, tiles, backgroundColor, renderAnnot, renderFlags, completed);
+        }
+
+        @Override
+        public synchronized void close() {
+            throwIfClosed();
+            nativeDestroyTileCache(mNativePtr);
+            mNativePtr = 0;
+        }
+
+        private void throwIfClosed() {
+            if (mNativePtr == 0) {
+                throw new IllegalStateException("Already closed");
             }
         }
 
-        public String getText() {
-            synchronized (lock) {
-                int length = nativeTextCountChars(mNativePtr);
-                return length > 0 ? nativeTextGetText(mNativePtr, 0, length) : "";
+        public static class Stats {
+            public final long hits;
+            public final long misses;
+            public final long evictions;
+            public final long tileCount;
+            public final long sizeBytes;
+            public final long budgetBytes;
+
+            Stats(long hits, long misses, long evictions, long tileCount, long sizeBytes, long budgetBytes) {
+                this.hits = hits;
+                this.misses = misses;
+                this.evictions = evictions;
+                this.tileCount = tileCount;
+                this.sizeBytes = sizeBytes;
+                this.budgetBytes = budgetBytes;
             }
         }
+    }
 
-        public List<RectF> getTextRects(int start, int count) {
-            synchronized (lock) {
-                int rectsCount = nativeTextCountRects(mNativePtr, start, count);
-                if (rectsCount > 0) {
-                    List<RectF> result = new ArrayList<>(rectsCount);
-                    for (int i = 0; i < rectsCount; i++) {
-                        RectF rect = new RectF();
-                        nativeTextGetRect(mNativePtr, i, rect);
-                        result.add(rect);
-                    }
-                    return result;
-                }
+    /**
+     * Renders successive frames into one {@link Surface}. The native window is acquired and
+     * configured once when the session is opened instead of on every frame like
+     * {@link PdfPage#render(Surface, int, int, int, int, boolean)} does.
+     */
+    public static final class SurfaceRenderSession implements Closeable {
+        private final int[] mDirtyBounds = new int[4];
+        private long mNativePtr;
+
+        public SurfaceRenderSession(@NonNull Surface surface) {
+            mNativePtr = nativeOpenSurfaceSession(surface);
+            if (mNativePtr == 0) {
+                throw new IllegalArgumentException("Surface has no native window");
             }
-            return Collections.emptyList();
         }
 
         /**
-         * Start a search
-         *
-         * @param query      A match pattern
-         * @param startIndex Start from this character. -1 for end of the page.
-         * @param flags      Option flags.
-         * @return Search result
+         * Pick up a new surface size, call from surfaceChanged
          */
-        public PdfTextSearch search(@NonNull String query, int startIndex, int flags) {
-            return new PdfTextSearch(mNativePtr, query, startIndex, flags);
+        public void onSurfaceChanged() {
+            synchronized (lock) {
+                throwIfClosed();
+                nativeUpdateSurfaceSession(mNativePtr);
+            }
         }
 
-        public long getTextLength() {
+        /**
+         * Render the next frame.
+         *
+         * @param renderFlags combination of the {@link PdfPage} RENDER_FLAG_* options
+         * @param dirty       region which changed since the last frame, null for the whole surface.
+         *                    It is updated to the region which actually has been redrawn, the rest
+         *                    of the surface keeps the previous frame.
+         * @return false if the surface could not be locked
+         */
+        public boolean render(@NonNull PdfPage page, int startX, int startY, int drawSizeX, int drawSizeY, long backgroundColor, boolean renderAnnot, int renderFlags, @Nullable Rect dirty) {
+            checkRenderFlags(renderFlags);
             synchronized (lock) {
-                return nativeTextCountChars(mNativePtr);
+                throwIfClosed();
+                page.abortProgressiveRender();
+                int[] bounds = null;
+                if (dirty != null) {
+                    bounds = mDirtyBounds;
+                    bounds[0] = dirty.left;
+                    bounds[1] = dirty.top;
+                    bounds[2] = dirty.right;
+                    bounds[3] = dirty.bottom;
+                }
+                boolean rendered;
+                try {
+                    rendered = nativeRenderSurfaceSession(mNativePtr, page.mNativePtr, startX, startY, drawSizeX, drawSizeY, backgroundColor, renderAnnot, renderFlags, bounds);
+                } catch (Exception e) {
+                    Log.e(TAG, "Exception throw from native");
+                    e.printStackTrace();
+                    return false;
+                }
+                if (rendered && dirty != null) {
+                    dirty.set(bounds[0], bounds[1], bounds[2], bounds[3]);
+                }
+                return rendered;
             }
         }
 
@@ -387,10 +856,8 @@ public class PdfDocument implements Closeable {
         }
 
         private void doClose() {
-            if (mNativePtr != 0) {
-                synchronized (lock) {
-                    nativeTextClosePage(mNativePtr);
-                }
+            synchronized (lock) {
+                nativeCloseSurfaceSession(mNativePtr);
                 mNativePtr = 0;
             }
         }
@@ -402,12 +869,766 @@ public class PdfDocument implements Closeable {
         }
     }
 
-    public final class PdfPage implements Closeable {
-        public final int index;
-        public final int width;
-        public final int height;
+    /**
+     * Renders of one page at power of two scales for instant zoom transitions, see
+     * {@link PdfPage#buildPyramid(RenderPyramid, float, long, boolean, int)}. Only the finest
+     * level is rendered, coarser levels are downsampled from it. While zooming, the best level
+     * is shown scaled until a sharp render at the new zoom is ready. Levels are read without
+     * waiting for the render lock.
+     */
+    public static final class RenderPyramid implements Closeable {
         private long mNativePtr;
 
+        public RenderPyramid(long budgetBytes) {
+            mNativePtr = nativeCreateRenderPyramid(budgetBytes);
+        }
+
+        /**
+         * @return the coarsest level at least as sharp as scale, the finest level if none is,
+         * null if the pyramid has not been built
+         */
+        @Nullable
+        public synchronized Level findLevel(float scale) {
+            throwIfClosed();
+            int index = nativeFindPyramidLevel(mNativePtr, scale);
+            if (index < 0) {
+                return null;
+            }
+            Point size = new Point();
+            float levelScale = nativeGetPyramidLevel(mNativePtr, index, size);
+            return new Level(index, size.x, size.y, levelScale);
+        }
+
+        /**
+         * Copy a level into an RGBA_8888 bitmap of exactly the level size
+         */
+        public synchronized boolean copyLevel(@NonNull Level level, @NonNull Bitmap bitmap) {
+            throwIfClosed();
+            return nativeCopyPyramidLevel(mNativePtr, level.index, bitmap);
+        }
+
+        public synchronized void clear() {
+            throwIfClosed();
+            nativeClearRenderPyramid(mNativePtr);
+        }
+
+        public synchronized Stats getStats() {
+            throwIfClosed();
+            long[] stats = new long[3];
+            nativeGetRenderPyramidStats(mNativePtr, stats);
+            return new Stats(stats[0], stats[1], stats[2]);
+        }
+
+        @Override
+        public void close() {
+            synchronized (lock) {
+                synchronized (this) {
+                    throwIfClosed();
+                    nativeDestroyRenderPyramid(mNativePtr);
+                    mNativePtr = 0;
+                }
+            }
+        }
+
+        private void throwIfClosed() {
+            if (mNativePtr == 0) {
+                throw new IllegalStateException("Already closed");
+            }
+        }
+
+        public static class Level {
+            public final int index;
+            public final int width;
+            public final int height;
+            // Pixels per page point
+            public final float scale;
+
+            Level(int index, int width, int height, float scale) {
+                this.index = index;
+                this.width = width;
+                this.height = height;
+                this.scale = scale;
+            }
+        }
+
+        public static class Stats {
+            public final long levelCount;
+            public final long sizeBytes;
+            public final long budgetBytes;
+
+            Stats(long levelCount, long sizeBytes, long budgetBytes) {
+                this.levelCount = levelCount;
+                this.sizeBytes = sizeBytes;
+                this.budgetBytes = budgetBytes;
+            }
+        }
+    }
+
+    /**
+     * Renders pages in helper processes, so bulk thumbnailing and export scale with the cores
+     * although pdfium renders one page at a time per process. Every worker runs the bundled
+     * libpdfiumworker.so executable with its own instance of the library and opens the document
+     * again on its own file descriptor, the pixels come back through shared memory. The helper
+     * is executed from the native library directory, so the app must keep native libraries
+     * extracted ({@code android:extractNativeLibs}). Calls do not take the render lock,
+     * rendering in this process goes on meanwhile.
+     */
+    public static final class RenderWorkerPool implements Closeable {
+        private long mNativePtr;
+
+        /**
+         * @param workerCount e.g. {@code Runtime.getRuntime().availableProcessors()}
+         */
+        public RenderWorkerPool(int workerCount) {
+            mNativePtr = nativeCreateRenderWorkerPool(workerCount);
+            if (mNativePtr == 0) {
+                throw new IllegalStateException("Cannot start render workers");
+            }
+        }
+
+        // Workers still running, a worker which crashed on a page is not replaced
+        public synchronized int getWorkerCount() {
+            throwIfClosed();
+            return nativeGetRenderWorkerCount(mNativePtr);
+        }
+
+        /**
+         * Render the jobs spread over the workers, blocking until all of them are done. The
+         * status and time of each job are stored in the job, a job fails if its worker crashes.
+         *
+         * @param document    opened from a file descriptor
+         * @param renderFlags combination of the {@link PdfPage} RENDER_FLAG_* options
+         */
+        public synchronized void renderPages(@NonNull PdfDocument document, @NonNull RenderJob[] jobs, long backgroundColor, boolean renderAnnot, int renderFlags) {
+            checkRenderFlags(renderFlags);
+            throwIfClosed();
+            ParcelFileDescriptor input;
+            synchronized (lock) {
+                document.throwIfClosed();
+                if (document.mFileDescriptor == null) {
+                    throw new IllegalArgumentException("Document must be opened from a file descriptor");
+                }
+                try {
+                    // Stays valid if the document is closed meanwhile
+                    input = document.mFileDescriptor.dup();
+                } catch (IOException e) {
+                    Log.e(TAG, "Cannot duplicate document file descriptor", e);
+                    unpackRenderJobs(jobs, filledStatus(jobs.length), new long[jobs.length]);
+                    return;
+                }
+            }
+            int[] pageIndices = new int[jobs.length];
+            Bitmap[] bitmaps = new Bitmap[jobs.length];
+            int[] viewports = new int[jobs.length * 4];
+            packRenderJobs(jobs, pageIndices, bitmaps, viewports);
+            int[] status = filledStatus(jobs.length);
+            long[] nanos = new long[jobs.length];
+            try {
+                nativeRenderPagesInWorkers(mNativePtr, document.mDocumentId, input.getFd(), document.mFileOffset, document.mFileLength, document.mPassword, pageIndices, bitmaps, viewports, backgroundColor, renderAnnot, renderFlags, status, nanos);
+            } catch (Exception e) {
+                Log.e(TAG, "Exception throw from native");
+                e.printStackTrace();
+                Arrays.fill(status, RenderToken.STATUS_FAILED);
+            } finally {
+                try {
+                    input.close();
+                } catch (IOException e) {
+                    /*no op*/
+                }
+            }
+            unpackRenderJobs(jobs, status, nanos);
+        }
+
+        private static int[] filledStatus(int length) {
+            int[] status = new int[length];
+            Arrays.fill(status, RenderToken.STATUS_FAILED);
+            return status;
+        }
+
+        @Override
+        public synchronized void close() {
+            throwIfClosed();
+            nativeDestroyRenderWorkerPool(mNativePtr);
+            mNativePtr = 0;
+        }
+
+        private void throwIfClosed() {
+            if (mNativePtr == 0) {
+                throw new IllegalStateException("Already closed");
+            }
+        }
+    }
+
+    /**
+     * Runs render tasks one at a time on its own thread, always the most valuable one queued:
+     * visible pages before pages next to the viewport, prefetch and background work, and within
+     * a priority the most recent request. A request for a page and tag which is still queued is
+     * coalesced with it, and the queued work of a viewport which is no longer shown is dropped
+     * with {@link #cancelGroup(long)}. Tasks run holding the render lock.
+     */
+    public static final class RenderScheduler implements Closeable {
+        public static final int PRIORITY_VISIBLE = 0;
+        public static final int PRIORITY_NEAR_VISIBLE = 1;
+        public static final int PRIORITY_PREFETCH = 2;
+        public static final int PRIORITY_BACKGROUND = 3;
+
+        private final HashMap<Long, Job> mJobs = new HashMap<>();
+        private final Thread mThread;
+        private long mNativePtr;
+
+        public RenderScheduler() {
+            final long nativePtr = nativeCreateRenderQueue();
+            mNativePtr = nativePtr;
+            mThread = new Thread(new Runnable() {
+                @Override
+                public void run() {
+                    runJobs(nativePtr);
+                }
+            }, "PdfRenderScheduler");
+            mThread.start();
+        }
+
+        /**
+         * Queue a task. If a task for the same document, page and tag is still queued, the new
+         * task replaces it: the job keeps its id, the more urgent priority and the new group.
+         *
+         * @param tag      distinguishes the renders of one page, e.g. tile and zoom
+         * @param priority one of the PRIORITY_* constants
+         * @param group    e.g. a viewport generation, see {@link #cancelGroup(long)}
+         * @return the job id
+         */
+        public synchronized long submit(@NonNull PdfDocument document, int pageIndex, long tag, int priority, long group, @NonNull Runnable task) {
+            throwIfClosed();
+            long id = nativeSubmitRenderJob(mNativePtr, document.mDocumentId, pageIndex, tag, priority, group);
+            mJobs.put(id, new Job(task, group));
+            return id;
+        }
+
+        /**
+         * @return true if the task was removed before it started
+         */
+        public synchronized boolean cancel(long jobId) {
+            throwIfClosed();
+            nativeCancelRenderJob(mNativePtr, jobId);
+            // Also catches a job which was just taken but has not started yet
+            return mJobs.remove(jobId) != null;
+        }
+
+        /**
+         * Remove all tasks of the group which have not started yet, e.g. when the viewport
+         * moves on. A running task completes, use a {@link RenderToken} to stop it early.
+         *
+         * @return the number of removed tasks
+         */
+        public synchronized int cancelGroup(long group) {
+            throwIfClosed();
+            nativeCancelRenderGroup(mNativePtr, group);
+            int count = 0;
+            Iterator<Job> jobs = mJobs.values().iterator();
+            while (jobs.hasNext()) {
+                if (jobs.next().group == group) {
+                    jobs.remove();
+                    count++;
+                }
+            }
+            return count;
+        }
+
+        public synchronized Stats getStats() {
+            throwIfClosed();
+            long[] stats = new long[5];
+            nativeGetRenderQueueStats(mNativePtr, stats);
+            return new Stats(stats[0], stats[1], stats[2], stats[3], stats[4]);
+        }
+
+        private void runJobs(long nativePtr) {
+            while (true) {
+                long id = nativeTakeRenderJob(nativePtr);
+                if (id < 0) {
+                    break;
+                }
+                Job job;
+                synchronized (this) {
+                    job = mJobs.remove(id);
+                }
+                if (job == null) {
+                    continue;
+                }
+                try {
+                    synchronized (lock) {
+                        job.task.run();
+                    }
+                } catch (RuntimeException e) {
+                    Log.e(TAG, "Render task failed", e);
+                }
+            }
+            // Closed, nothing else uses the queue anymore
+            nativeDestroyRenderQueue(nativePtr);
+        }
+
+        /**
+         * Drop the queued tasks and wait for the running one to finish, unless called from a
+         * task itself.
+         */
+        @Override
+        public void close() {
+            synchronized (this) {
+                throwIfClosed();
+                nativeCloseRenderQueue(mNativePtr);
+                mNativePtr = 0;
+                mJobs.clear();
+            }
+            if (Thread.currentThread() == mThread) {
+                return;
+            }
+            boolean interrupted = false;
+            while (true) {
+                try {
+                    mThread.join();
+                    break;
+                } catch (InterruptedException e) {
+                    interrupted = true;
+                }
+            }
+            if (interrupted) {
+                Thread.currentThread().interrupt();
+            }
+        }
+
+        private void throwIfClosed() {
+            if (mNativePtr == 0) {
+                throw new IllegalStateException("Already closed");
+            }
+        }
+
+        private static final class Job {
+            final Runnable task;
+            final long group;
+
+            Job(Runnable task, long group) {
+                this.task = task;
+                this.group = group;
+            }
+        }
+
+        public static class Stats {
+            public final long queued;
+            public final long submitted;
+            // Requests merged into a job which was already queued
+            public final long coalesced;
+            public final long cancelled;
+            public final long started;
+
+            Stats(long queued, long submitted, long coalesced, long cancelled, long started) {
+                this.queued = queued;
+                this.submitted = submitted;
+                this.coalesced = coalesced;
+                this.cancelled = cancelled;
+                this.started = started;
+            }
+        }
+    }
+
+    /**
+     * Opens a document while it is still being downloaded. The download writes into a file of
+     * the final length in any order and reports every range written with
+     * {@link #addAvailableRange(long, long)}. pdfium reads only reported ranges, the ranges it
+     * needs next are listed by {@link #getRequestedRanges()}, e.g. for HTTP range requests.
+     * A linearized document opens and shows its first page as soon as the start of the file has
+     * arrived, others once their cross-reference data at the end has.
+     */
+    public static final class StreamingLoader implements Closeable {
+        private long mNativePtr;
+        private boolean mDocumentOpened;
+
+        /**
+         * @param file   the file the download writes to, it is duplicated and may be closed
+         * @param length final length of the document
+         */
+        public StreamingLoader(@NonNull ParcelFileDescriptor file, long length) {
+            if (length <= 0) {
+                throw new IllegalArgumentException("Length must be positive");
+            }
+            synchronized (lock) {
+                mNativePtr = nativeCreateStreamSource(file.getFd(), length);
+            }
+        }
+
+        /**
+         * The bytes from offset on have been written to the file. May be called from the
+         * download thread, it does not wait for renders.
+         */
+        public synchronized void addAvailableRange(long offset, long length) {
+            throwIfClosed();
+            nativeAddAvailableRange(mNativePtr, offset, length);
+        }
+
+        /**
+         * @return offset and length pairs pdfium asked for which have not been reported yet
+         */
+        @NonNull
+        public synchronized long[] getRequestedRanges() {
+            throwIfClosed();
+            return nativeGetRequestedRanges(mNativePtr);
+        }
+
+        /**
+         * Open the document once enough has arrived. Call again whenever new data arrives.
+         * The loader must stay open to check pages of the document.
+         *
+         * @return null while data is missing, see {@link #getRequestedRanges()}
+         */
+        @Nullable
+        public PdfDocument openDocument(@Nullable String password) {
+            synchronized (lock) {
+                synchronized (this) {
+                    throwIfClosed();
+                    if (mDocumentOpened) {
+                        throw new IllegalStateException("Document already opened");
+                    }
+                    long documentPtr = nativeOpenStreamDocument(mNativePtr, password);
+                    if (documentPtr == 0) {
+                        return null;
+                    }
+                    mDocumentOpened = true;
+                    return new PdfDocument(documentPtr, password);
+                }
+            }
+        }
+
+        /**
+         * Check whether a page of the opened document can be loaded, pages must not be opened
+         * before. Call again whenever new data arrives.
+         *
+         * @return false while data is missing, see {@link #getRequestedRanges()}, and while
+         * the document is not open
+         */
+        public boolean isPageAvailable(int pageIndex) {
+            synchronized (lock) {
+                synchronized (this) {
+                    throwIfClosed();
+                    return nativeIsStreamPageAvailable(mNativePtr, pageIndex);
+                }
+            }
+        }
+
+        // False until the first kilobyte has arrived
+        public boolean isLinearized() {
+            synchronized (lock) {
+                synchronized (this) {
+                    throwIfClosed();
+                    return nativeIsStreamLinearized(mNativePtr);
+                }
+            }
+        }
+
+        /**
+         * A document opened from this loader stays open, but no further data can be reported
+         * for it and its pages cannot be checked anymore.
+         */
+        @Override
+        public void close() {
+            synchronized (lock) {
+                synchronized (this) {
+                    throwIfClosed();
+                    nativeReleaseStreamSource(mNativePtr);
+                    mNativePtr = 0;
+                }
+            }
+        }
+
+        private void throwIfClosed() {
+            if (mNativePtr == 0) {
+                throw new IllegalStateException("Already closed");
+            }
+        }
+    }
+
+    /**
+     * A page rendered into a file by {@link PdfPage#renderToFile}. The file starts with a native
+     * endian header of magic 'PDFR', version, width, height, stride and format as 32 bit values
+     * followed by the row offset and row size as 64 bit values. The rows start at
+     * {@link #dataOffset}, a multiple of the page size, so they can be mapped or read in bands.
+     */
+    public static final class RenderFile implements Closeable {
+        private final ParcelFileDescriptor mFileDescriptor;
+        public final int width;
+        public final int height;
+        // Bytes between the starts of two rows
+        public final int stride;
+        // One of the PdfPage PIXEL_FORMAT_* constants
+        public final int format;
+        public final long dataOffset;
+        public final long dataSize;
+
+        RenderFile(ParcelFileDescriptor fileDescriptor, long[] layout) {
+            mFileDescriptor = fileDescriptor;
+            width = (int) layout[0];
+            height = (int) layout[1];
+            stride = (int) layout[2];
+            format = (int) layout[3];
+            dataOffset = layout[4];
+            dataSize = layout[5];
+        }
+
+        /**
+         * The file, anonymous shared memory or an already deleted temp file. It stays valid
+         * until this is closed, use {@link ParcelFileDescriptor#dup()} to keep it longer.
+         */
+        @NonNull
+        public ParcelFileDescriptor getFileDescriptor() {
+            return mFileDescriptor;
+        }
+
+        @Override
+        public void close() throws IOException {
+            mFileDescriptor.close();
+        }
+    }
+
+    /**
+     * Renders a viewport into one bitmap and keeps the frame. When only the page offset changes
+     * between two frames, the still visible pixels are moved and just the newly exposed strips
+     * are rendered, so a small pan costs in proportion to the exposed area, not the viewport.
+     * The bitmap must not be drawn into by anything else while the renderer uses it.
+     */
+    public static final class ViewportRenderer {
+        private final Bitmap mBitmap;
+        // Page of the frame in the bitmap, null if there is no valid frame
+        private PdfPage mPage;
+        private long mPagePtr;
+        private int mStartX;
+        private int mStartY;
+        private int mDrawSizeX;
+        private int mDrawSizeY;
+        private long mBackgroundColor;
+        private boolean mRenderAnnot;
+        private int mRenderFlags;
+
+        public ViewportRenderer(@NonNull Bitmap bitmap) {
+            mBitmap = bitmap;
+        }
+
+        @NonNull
+        public Bitmap getBitmap() {
+            return mBitmap;
+        }
+
+        /**
+         * Render the next frame fully, e.g. after the bitmap has been modified
+         */
+        public void invalidate() {
+            synchronized (lock) {
+                mPage = null;
+            }
+        }
+
+        /**
+         * Render the page with the given offsets. Only a change of startX and startY by less
+         * than the bitmap size reuses the previous frame, any other change renders it fully.
+         *
+         * @param renderFlags combination of the {@link PdfPage} RENDER_FLAG_* options
+         */
+        public void render(@NonNull PdfPage page, int startX, int startY, int drawSizeX, int drawSizeY, long backgroundColor, boolean renderAnnot, int renderFlags) {
+            checkRenderFlags(renderFlags);
+            synchronized (lock) {
+                page.throwIfClosed();
+                boolean scroll = mPage == page && mPagePtr == page.mNativePtr
+                        && mDrawSizeX == drawSizeX && mDrawSizeY == drawSizeY
+                        && mBackgroundColor == backgroundColor && mRenderAnnot == renderAnnot
+                        && mRenderFlags == renderFlags;
+                boolean rendered = true;
+                if (!scroll) {
+                    // Strips exposed later are cleared, so the whole frame starts out clear
+                    mBitmap.eraseColor(Color.TRANSPARENT);
+                    page.render(mBitmap, startX, startY, drawSizeX, drawSizeY, backgroundColor, renderAnnot, renderFlags);
+                } else if (startX != mStartX || startY != mStartY) {
+                    page.abortProgressiveRender();
+                    try {
+                        rendered = nativeRenderPageScrolled(page.mNativePtr, mBitmap, startX - mStartX, startY - mStartY, startX, startY, drawSizeX, drawSizeY, backgroundColor, renderAnnot, renderFlags);
+                    } catch (Exception e) {
+                        Log.e(TAG, "Exception throw from native");
+                        e.printStackTrace();
+                        rendered = false;
+                    }
+                }
+                mPage = rendered ? page : null;
+                mPagePtr = page.mNativePtr;
+                mStartX = startX;
+                mStartY = startY;
+                mDrawSizeX = drawSizeX;
+                mDrawSizeY = drawSizeY;
+                mBackgroundColor = backgroundColor;
+                mRenderAnnot = renderAnnot;
+                mRenderFlags = renderFlags;
+            }
+        }
+    }
+
+    public final class PdfTextSearch implements Closeable {
+        private long mNativePtr;
+
+        PdfTextSearch(long textPtr, String query, int startIndex, int flags) {
+            synchronized (lock) {
+                mNativePtr = nativeTextFindStart(textPtr, query, flags, startIndex);
+            }
+        }
+
+        @Nullable
+        public PdfSearchResult findNext() {
+            synchronized (lock) {
+                if (nativeTextFindNext(mNativePtr)) {
+                    return new PdfSearchResult(nativeTextGetSchResultIndex(mNativePtr), nativeTextGetSchCount(mNativePtr));
+                }
+                return null;
+            }
+        }
+
+        @Nullable
+        public PdfSearchResult findPrev() {
+            synchronized (lock) {
+                if (nativeTextFindPrev(mNativePtr)) {
+                    return new PdfSearchResult(nativeTextGetSchResultIndex(mNativePtr), nativeTextGetSchCount(mNativePtr));
+                }
+                return null;
+            }
+        }
+
+        @Override
+        public void close() {
+            throwIfClosed();
+            doClose();
+        }
+
+        private void doClose() {
+            if (mNativePtr != 0) {
+                synchronized (lock) {
+                    nativeTextFindClose(mNativePtr);
+                }
+                mNativePtr = 0;
+            }
+        }
+
+        private void throwIfClosed() {
+            if (mNativePtr == 0) {
+                throw new IllegalStateException("Already closed");
+            }
+        }
+    }
+
+    public final class PdfText implements Closeable {
+        // If not set, it will not match case by default.
+        public final static int SEARCH_FLAG_MATCHCASE = 0x00000001;
+        // If not set, it will not match the whole word by default.
+        public final static int SEARCH_MATCH_WHOLE_WORD = 0x00000002;
+
+        private long mNativePtr;
+
+        PdfText(long pagePtr) {
+            synchronized (lock) {
+                mNativePtr = nativeTextLoadPage(pagePtr);
+            }
+        }
+
+        public String getText() {
+            synchronized (lock) {
+                int length = nativeTextCountChars(mNativePtr);
+                return length > 0 ? nativeTextGetText(mNativePtr, 0, length) : "";
+            }
+        }
+
+        public List<RectF> getTextRects(int start, int count) {
+            synchronized (lock) {
+                int rectsCount = nativeTextCountRects(mNativePtr, start, count);
+                if (rectsCount > 0) {
+                    List<RectF> result = new ArrayList<>(rectsCount);
+                    for (int i = 0; i < rectsCount; i++) {
+                        RectF rect = new RectF();
+                        nativeTextGetRect(mNativePtr, i, rect);
+                        result.add(rect);
+                    }
+                    return result;
+                }
+            }
+            return Collections.emptyList();
+        }
+
+        /**
+         * Start a search
+         *
+         * @param query      A match pattern
+         * @param startIndex Start from this character. -1 for end of the page.
+         * @param flags      Option flags.
+         * @return Search result
+         */
+        public PdfTextSearch search(@NonNull String query, int startIndex, int flags) {
+            return new PdfTextSearch(mNativePtr, query, startIndex, flags);
+        }
+
+        public long getTextLength() {
+            synchronized (lock) {
+                return nativeTextCountChars(mNativePtr);
+            }
+        }
+
+        @Override
+        public void close() {
+            throwIfClosed();
+            doClose();
+        }
+
+        private void doClose() {
+            if (mNativePtr != 0) {
+                synchronized (lock) {
+                    nativeTextClosePage(mNativePtr);
+                }
+                mNativePtr = 0;
+            }
+        }
+
+        private void throwIfClosed() {
+            if (mNativePtr == 0) {
+                throw new IllegalStateException("Already closed");
+            }
+        }
+    }
+
+    public final class PdfPage implements Closeable {
+        // Dither RGB_565 output with an ordered 4x4 pattern instead of truncating each channel,
+        // removes banding on gradients and scans at a small cost
+        public final static int RENDER_FLAG_DITHER = 0x00000001;
+        // Draft quality for flings and previews: no anti-aliasing of text, images and paths and a
+        // limited image cache, much cheaper than the default sub-pixel text rendering. Render
+        // calls throw IllegalArgumentException if it is combined with RENDER_FLAG_PRINT.
+        public final static int RENDER_FLAG_DRAFT = 0x00000002;
+        // Render the page the way pdfium renders it for printing, excludes RENDER_FLAG_DRAFT
+        public final static int RENDER_FLAG_PRINT = 0x00000004;
+        // Skip the background fill for callers compositing the page over their own background:
+        // ARGB_8888 bitmaps and RGBA/BGRA buffers get the page on a transparent backdrop with
+        // premultiplied alpha and backgroundColor is ignored. Sub-pixel text is disabled, other
+        // formats as well as tiles, progressive and surface rendering ignore the flag
+        public final static int RENDER_FLAG_TRANSPARENT = 0x00000008;
+
+        // Pixel formats of render(ByteBuffer, ...), named by the order of the bytes in memory
+        public final static int PIXEL_FORMAT_RGBA_8888 = 1;
+        public final static int PIXEL_FORMAT_BGRA_8888 = 2;
+        public final static int PIXEL_FORMAT_RGB_888 = 3;
+        public final static int PIXEL_FORMAT_BGR_888 = 4;
+        // Native endian 16 bit values as in Bitmap.Config.RGB_565, RENDER_FLAG_DITHER applies
+        public final static int PIXEL_FORMAT_RGB_565 = 5;
+        public final static int PIXEL_FORMAT_GRAY_8 = 6;
+
+        // Image formats of renderToImage
+        public final static int IMAGE_FORMAT_PNG = 1;
+        // Baseline JPEG with 4:2:0 chroma subsampling
+        public final static int IMAGE_FORMAT_JPEG = 2;
+
+        public final int index;
+        public final int width;
+        public final int height;
+        private long mNativePtr;
+        private RenderToken mProgressiveToken;
+
         PdfPage(long documentPtr, int index) {
             Point size = mTempPoint;
             synchronized (lock) {
@@ -423,18 +1644,254 @@ public class PdfDocument implements Closeable {
         }
 
         public void render(@NonNull Bitmap bitmap, int startX, int startY, int drawSizeX, int drawSizeY, long backgroundColor, boolean renderAnnot) {
+            render(bitmap, startX, startY, drawSizeX, drawSizeY, backgroundColor, renderAnnot, 0);
+        }
+
+        /**
+         * Render into an RGBA_8888, RGB_565 or ALPHA_8 bitmap. ALPHA_8 bitmaps receive the page
+         * luminance at one byte per pixel, rendered in grayscale mode.
+         *
+         * @param renderFlags combination of the RENDER_FLAG_* options
+         */
+        public void render(@NonNull Bitmap bitmap, int startX, int startY, int drawSizeX, int drawSizeY, long backgroundColor, boolean renderAnnot, int renderFlags) {
+            checkRenderFlags(renderFlags);
+            synchronized (lock) {
+                abortProgressiveRender();
+                try {
+                    nativeRenderPageBitmap(mNativePtr, bitmap, startX, startY, drawSizeX, drawSizeY, backgroundColor, renderAnnot, renderFlags);
+                } catch (Exception e) {
+                    Log.e(TAG, "Exception throw from native");
+                    e.printStackTrace();
+                }
+            }
+        }
+
+        /**
+         * Render into a direct buffer, e.g. for offscreen processing or texture upload. pdfium
+         * writes the pixels straight into the buffer, only RGB_565 goes through a small band
+         * buffer. Rows start at the beginning of the buffer regardless of its position.
+         *
+         * @param stride      bytes between the starts of two rows
+         * @param format      one of the PIXEL_FORMAT_* constants
+         * @param renderFlags combination of the RENDER_FLAG_* options
+         * @return false if the buffer is too small for the given size, stride and format
+         */
+        public boolean render(@NonNull ByteBuffer buffer, int width, int height, int stride, int format, int startX, int startY, int drawSizeX, int drawSizeY, long backgroundColor, boolean renderAnnot, int renderFlags) {
+            checkRenderFlags(renderFlags);
+            if (!buffer.isDirect()) {
+                throw new IllegalArgumentException("Buffer must be direct");
+            }
+            synchronized (lock) {
+                abortProgressiveRender();
+                try {
+                    return nativeRenderPageBuffer(mNativePtr, buffer, width, height, stride, format, startX, startY, drawSizeX, drawSizeY, backgroundColor, renderAnnot, renderFlags);
+                } catch (Exception e) {
+                    Log.e(TAG, "Exception throw from native");
+                    e.printStackTrace();
+                    return false;
+                }
+            }
+        }
+
+        /**
+         * Render the page straight into an image file without a Bitmap. The page is rendered
+         * in bands of rows and each band is compressed and written as soon as it is rendered, so
+         * memory use depends on the width only. Outside of the page the image is white, or
+         * transparent for PNG with RENDER_FLAG_TRANSPARENT.
+         *
+         * @param output      written from its current position, e.g. a file or pipe
+         * @param imageFormat one of the IMAGE_FORMAT_* constants. PNG is RGB, or RGBA with
+         *                    RENDER_FLAG_TRANSPARENT
+         * @param quality     1 to 100, JPEG only
+         * @param renderFlags combination of the RENDER_FLAG_* options, dithering does not apply
+         * @return false on failure, output may then hold part of the image
+         */
+        public boolean renderToImage(@NonNull ParcelFileDescriptor output, int imageFormat, int quality, int width, int height, int startX, int startY, int drawSizeX, int drawSizeY, long backgroundColor, boolean renderAnnot, int renderFlags) {
+            checkRenderFlags(renderFlags);
             synchronized (lock) {
+                throwIfClosed();
+                abortProgressiveRender();
                 try {
-                    nativeRenderPageBitmap(mNativePtr, bitmap, startX, startY, drawSizeX, drawSizeY, backgroundColor, renderAnnot);
+                    return nativeEncodePage(mNativePtr, output.getFd(), imageFormat, quality, width, height, startX, startY, drawSizeX, drawSizeY, backgroundColor, renderAnnot, renderFlags);
                 } catch (Exception e) {
                     Log.e(TAG, "Exception throw from native");
                     e.printStackTrace();
+                    return false;
                 }
             }
         }
 
+        /**
+         * Render into a file instead of memory, for pages far larger than a bitmap or the native
+         * heap allows, such as posters and plans at print resolution. pdfium renders one band of
+         * rows at a time into a shared mapping of the file, so the kernel writes back or swaps
+         * out the finished rows as needed. The file is anonymous shared memory where the kernel
+         * supports it, otherwise an already deleted file in {@code tempDir}.
+         *
+         * @param format      one of the PIXEL_FORMAT_* constants
+         * @param renderFlags combination of the RENDER_FLAG_* options
+         * @param tempDir     directory for the fallback file, e.g. {@code Context.getCacheDir()}
+         * @return the rendered file, null on failure, e.g. when there is not enough space
+         */
+        @Nullable
+        public RenderFile renderToFile(int width, int height, int format, int startX, int startY, int drawSizeX, int drawSizeY, long backgroundColor, boolean renderAnnot, int renderFlags, @Nullable File tempDir) {
+            checkRenderFlags(renderFlags);
+            synchronized (lock) {
+                throwIfClosed();
+                abortProgressiveRender();
+                long[] layout = new long[6];
+                int fd;
+                try {
+                    fd = nativeRenderPageToFile(mNativePtr, tempDir != null ? tempDir.getPath() : null, width, height, format, startX, startY, drawSizeX, drawSizeY, backgroundColor, renderAnnot, renderFlags, layout);
+                } catch (Exception e) {
+                    Log.e(TAG, "Exception throw from native");
+                    e.printStackTrace();
+                    return null;
+                }
+                return fd < 0 ? null : new RenderFile(ParcelFileDescriptor.adoptFd(fd), layout);
+            }
+        }
+
+        /**
+         * Render the whole page at {@code scale} pixels per point into the finest level of the
+         * pyramid and derive the coarser levels from it, replacing the previous levels. The
+         * scale is halved until the pyramid fits its budget.
+         *
+         * @param renderFlags combination of the RENDER_FLAG_* options, dithering does not apply
+         * @return number of levels, 0 on failure
+         */
+        public int buildPyramid(@NonNull RenderPyramid pyramid, float scale, long backgroundColor, boolean renderAnnot, int renderFlags) {
+            checkRenderFlags(renderFlags);
+            synchronized (lock) {
+                throwIfClosed();
+                abortProgressiveRender();
+                // Not synchronized on the pyramid, so its levels stay readable while building.
+                // Closing it waits for the render lock.
+                pyramid.throwIfClosed();
+                try {
+                    return nativeBuildRenderPyramid(pyramid.mNativePtr, mNativePtr, scale, backgroundColor, renderAnnot, renderFlags);
+                } catch (Exception e) {
+                    Log.e(TAG, "Exception throw from native");
+                    e.printStackTrace();
+                    return 0;
+                }
+            }
+        }
+
+        /**
+         * Render the page in time slices which can be cancelled. Each call works for at most
+         * {@code timeSliceMillis} and returns {@link RenderToken#STATUS_PARTIAL} if the page is not
+         * finished yet, calling again with the same token and bitmap continues where it stopped.
+         * An RGBA_8888 bitmap contains the partially rendered page in between calls, an RGB_565
+         * bitmap is only written once the page is complete.
+         *
+         * @param renderFlags     combination of the RENDER_FLAG_* options, dithering does not apply
+         * @param token           token driving the render, cancel it to abandon the page
+         * @param timeSliceMillis maximum time spent in this call, 0 to run until done or cancelled
+         * @return one of the {@link RenderToken} STATUS_* constants
+         */
+        public int renderProgressive(@NonNull Bitmap bitmap, int startX, int startY, int drawSizeX, int drawSizeY, long backgroundColor, boolean renderAnnot, int renderFlags, @NonNull RenderToken token, long timeSliceMillis) {
+            return renderProgressive(bitmap, startX, startY, drawSizeX, drawSizeY, backgroundColor, renderAnnot, renderFlags, token, timeSliceMillis, false);
+        }
+
+        /**
+         * Same as {@link #renderProgressive(Bitmap, int, int, int, int, long, boolean, int, RenderToken, long)}.
+         * With {@code publishPartial} an RGB_565 bitmap also receives the partially rendered page
+         * after every slice, which converts the whole bitmap each time.
+         */
+        public int renderProgressive(@NonNull Bitmap bitmap, int startX, int startY, int drawSizeX, int drawSizeY, long backgroundColor, boolean renderAnnot, int renderFlags, @NonNull RenderToken token, long timeSliceMillis, boolean publishPartial) {
+            checkRenderFlags(renderFlags);
+            synchronized (lock) {
+                token.throwIfClosed();
+                throwIfClosed();
+                // pdfium keeps one render context per page and a token drives one page at a time
+                if (mProgressiveToken != token) {
+                    abortProgressiveRender();
+                }
+                if (token.mPage != null && token.mPage != this) {
+                    token.abort();
+                }
+                int status;
+                try {
+                    status = nativeRenderPageBitmapProgressive(mNativePtr, token.mNativePtr, bitmap, startX, startY, drawSizeX, drawSizeY, backgroundColor, renderAnnot, renderFlags, timeSliceMillis, publishPartial);
+                } catch (Exception e) {
+                    Log.e(TAG, "Exception throw from native");
+                    e.printStackTrace();
+                    token.abort();
+                    return RenderToken.STATUS_FAILED;
+                }
+                if (status == RenderToken.STATUS_PARTIAL) {
+                    token.mPage = this;
+                    mProgressiveToken = token;
+                } else {
+                    token.mPage = null;
+                    mProgressiveToken = null;
+                }
+                return status;
+            }
+        }
+
+        /**
+         * Render tiles of the page scaled by {@code zoom} into the slots of one atlas bitmap. The
+         * scaled page is split into a grid of {@code tileSize} squares, tile i is given by its
+         * column {@code tiles[2 * i]} and row {@code tiles[2 * i + 1]} and is drawn into atlas slot
+         * i, slots counting left to right, top to bottom. Tiles on the right and bottom edge of
+         * the page only cover part of their slot. The zoom is quantized to steps of 1/1024.
+         *
+         * @param atlas RGBA_8888 or RGB_565 bitmap, its size should be a multiple of tileSize
+         * @param renderFlags combination of the RENDER_FLAG_* options, the dither pattern is
+         *                    anchored to the page so neighbouring tiles line up
+         * @param token       optional token, once it is cancelled the remaining tiles are skipped
+         * @param cache       optional cache, tiles found there are copied without rendering and
+         *                    without waiting for the render lock, rendered tiles are added to it
+         * @return for every requested tile whether it has been rendered, null on failure
+         * @throws IllegalArgumentException if the atlas has fewer slots than tiles are requested
+         */
+        @Nullable
+        public boolean[] renderTiles(@NonNull Bitmap atlas, int tileSize, float zoom, @NonNull int[] tiles, long backgroundColor, boolean renderAnnot, int renderFlags, @Nullable RenderToken token, @Nullable TileCache cache) {
+            checkRenderFlags(renderFlags);
+            if (tileSize <= 0) {
+                throw new IllegalArgumentException("Tile size must be positive");
+            }
+            if ((atlas.getWidth() / tileSize) * (atlas.getHeight() / tileSize) < tiles.length / 2) {
+                throw new IllegalArgumentException("Atlas holds fewer slots than tiles requested");
+            }
+            boolean[] completed = new boolean[tiles.length / 2];
+            if (cache != null && cache.blitTiles(mDocumentId, index, atlas, tileSize, zoom, tiles, backgroundColor, renderAnnot, renderFlags, completed)) {
+                return completed;
+            }
+            synchronized (lock) {
+                abortProgressiveRender();
+                try {
+                    if (cache != null) {
+                        synchronized (cache) {
+                            cache.throwIfClosed();
+                            if (!nativeRenderPageTiles(mNativePtr, atlas, tileSize, zoom, tiles, backgroundColor, renderAnnot, renderFlags, token != null ? token.mNativePtr : 0, cache.mNativePtr, mDocumentId, index, completed)) {
+                                return null;
+                            }
+                        }
+                    } else if (!nativeRenderPageTiles(mNativePtr, atlas, tileSize, zoom, tiles, backgroundColor, renderAnnot, renderFlags, token != null ? token.mNativePtr : 0, 0, mDocumentId, index, completed)) {
+                        return null;
+                    }
+                } catch (Exception e) {
+                    Log.e(TAG, "Exception throw from native");
+                    e.printStackTrace();
+                    return null;
+                }
+            }
+            return completed;
+        }
+
+        // A blocking render replaces the render context of an unfinished progressive render
+        private void abortProgressiveRender() {
+            if (mProgressiveToken != null) {
+                mProgressiveToken.abort();
+            }
+        }
+
         public void render(@NonNull Surface surface, int startX, int startY, int drawSizeX, int drawSizeY, boolean renderAnnot) {
             synchronized (lock) {
+                abortProgressiveRender();
                 try {
                     nativeRenderPage(mNativePtr, surface, startX, startY, drawSizeX, drawSizeY, renderAnnot);
                 } catch (Exception e) {
@@ -516,6 +1973,7 @@ public class PdfDocument implements Closeable {
         private void doClose() {
             if (mNativePtr != 0) {
                 synchronized (lock) {
+                    abortProgressiveRender();
                     nativeClosePage(mNativePtr);
                 }
                 mNativePtr = 0;
@@ -40,8 +40,59 @@ LOCAL_MODULE := jniPdfium
 LOCAL_CFLAGS += -DHAVE_PTHREADS
 LOCAL_C_INCLUDES += $(LOCAL_PATH)/include
 LOCAL_SHARED_LIBRARIES += aospPdfium
-LOCAL_LDLIBS += -llog -landroid -ljnigraphics
-
-LOCAL_SRC_FILES := $(LOCAL_PATH)/src/PdfUtils.cpp $(LOCAL_PATH)/src/mainJNILib.cpp
+LOCAL_LDLIBS += -ldl -llog -landroid -ljnigraphics -lz
+
+LOCAL_SRC_FILES := $(LOCAL_PATH)/src/FileSource.cpp \
+                   $(LOCAL_PATH)/src/ImageEncoder.cpp \
+                   $(LOCAL_PATH)/src/MappedRender.cpp \
+                   $(LOCAL_PATH)/src/PageRender.cpp \
+                   $(LOCAL_PATH)/src/PdfUtils.cpp \
+                   $(LOCAL_PATH)/src/PixelConvert.cpp \
+                   $(LOCAL_PATH)/src/RenderPyramid.cpp \
+                   $(LOCAL_PATH)/src/RenderQueue.cpp \
+                   $(LOCAL_PATH)/src/RenderWorkers.cpp \
+                   $(LOCAL_PATH)/src/ScratchPool.cpp \
+                   $(LOCAL_PATH)/src/StreamSource.cpp \
+                   $(LOCAL_PATH)/src/TileCache.cpp \
+                   $(LOCAL_PATH)/src/mainJNILib.cpp
+
+#NEON kernels, on armeabi-v7a they are only used when cpufeatures reports NEON
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+LOCAL_SRC_FILES += $(LOCAL_PATH)/src/PixelConvertNeon.cpp.neon
+endif
+ifeq ($(TARGET_ARCH_ABI),arm64-v8a)
+LOCAL_SRC_FILES += $(LOCAL_PATH)/src/PixelConvertNeon.cpp
+endif
+
+LOCAL_STATIC_LIBRARIES += cpufeatures
 
 include $(BUILD_SHARED_LIBRARY)
+
+#Render worker helper, started by RenderWorkerPool. Named like a library so it is packaged into
+#the native library directory, the one place an app may execute files from
+include $(CLEAR_VARS)
+LOCAL_MODULE := libpdfiumworker.so
+
+LOCAL_CFLAGS += -DHAVE_PTHREADS
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/include
+LOCAL_SHARED_LIBRARIES += aospPdfium
+
+LOCAL_SRC_FILES := $(LOCAL_PATH)/src/FileSource.cpp \
+                   $(LOCAL_PATH)/src/PageRender.cpp \
+                   $(LOCAL_PATH)/src/PixelConvert.cpp \
+                   $(LOCAL_PATH)/src/RenderWorkerMain.cpp \
+                   $(LOCAL_PATH)/src/RenderWorkers.cpp \
+                   $(LOCAL_PATH)/src/ScratchPool.cpp
+
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+LOCAL_SRC_FILES += $(LOCAL_PATH)/src/PixelConvertNeon.cpp.neon
+endif
+ifeq ($(TARGET_ARCH_ABI),arm64-v8a)
+LOCAL_SRC_FILES += $(LOCAL_PATH)/src/PixelConvertNeon.cpp
+endif
+
+LOCAL_STATIC_LIBRARIES += cpufeatures
+
+include $(BUILD_EXECUTABLE)
+
+$(call import-module,android/cpufeatures)
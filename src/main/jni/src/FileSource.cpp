@@ -0,0 +1,299 @@
+#include "FileSource.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/vfs.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef FUSE_SUPER_MAGIC
+#define FUSE_SUPER_MAGIC 0x65735546
+#endif
+
+using namespace android;
+
+namespace tools {
+
+    // Aligned blocks the read path caches, 2 MB per document
+    static const size_t CACHE_BLOCK_SIZE = 64 * 1024;
+    static const size_t CACHE_BLOCK_COUNT = 32;
+    // Consecutive blocks read before the following ones are read ahead, and how many
+    static const int SEQUENTIAL_THRESHOLD = 2;
+    static const int64_t READAHEAD_BLOCKS = 4;
+
+    bool readFully(int fd, int64_t position, unsigned char *outBuffer, size_t size) {
+        while (size > 0) {
+            ssize_t count = pread64(fd, outBuffer, size, (off64_t) position);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return false;
+            }
+            // Short reads happen on FUSE and network file systems
+            outBuffer += count;
+            position += count;
+            size -= (size_t) count;
+        }
+        return true;
+    }
+
+    FileSource::FileSource(int fd, int64_t offset, int64_t length)
+            : mFd(fd), mOffset(offset), mLength(length), mMapping(nullptr), mMappingSize(0),
+              mData(nullptr), mLastIndex(-1),
+              mSequentialCount(0), mReadaheadFirst(0), mReadaheadEnd(0),
+              mReadaheadStarted(false), mStopping(false) {
+        memset(&mStats, 0, sizeof(mStats));
+    }
+
+    FileSource::~FileSource() {
+        if (mReadaheadStarted) {
+            {
+                AutoMutex lock(mLock);
+                mStopping = true;
+                mReadaheadWanted.signal();
+            }
+            pthread_join(mReadaheadThread, nullptr);
+        }
+        for (std::list<CacheBlock *>::iterator block = mBlocks.begin();
+             block != mBlocks.end(); ++block) {
+            free((*block)->data);
+            delete *block;
+        }
+        if (mMapping != nullptr) {
+            munmap(mMapping, mMappingSize);
+        }
+    }
+
+    static void *mapFileRange(int fd, size_t size, uint64_t offset) {
+#if defined(__LP64__)
+        return mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, (off_t) offset);
+#else
+        // mmap64 needs API 21, mmap2 takes the offset in 4096 byte units on 32 bit ABIs
+        return (void *) syscall(__NR_mmap2, nullptr, size, PROT_READ, MAP_SHARED, fd,
+                                (unsigned long) (offset >> 12));
+#endif
+    }
+
+    void FileSource::open(int fileAccess) {
+        struct stat fileState;
+        if (fileAccess != FILE_ACCESS_MAPPED || mOffset < 0 || mLength <= 0 ||
+            fstat(mFd, &fileState) != 0 || !S_ISREG(fileState.st_mode)) {
+            return;
+        }
+        // FUSE files, e.g. shared storage from Android 11 on, map fine but every page fault
+        // is a round trip to the FUSE daemon. Cache blocks need far fewer of them.
+        struct statfs fileSystem;
+        if (fstatfs(mFd, &fileSystem) == 0 && fileSystem.f_type == FUSE_SUPER_MAGIC) {
+            return;
+        }
+        // Mappings start at a page boundary
+        int64_t pageSize = (int64_t) sysconf(_SC_PAGESIZE);
+        int64_t mappingOffset = mOffset - mOffset % pageSize;
+        uint64_t mappingSize = (uint64_t) (mOffset - mappingOffset + mLength);
+        if (mappingSize > SIZE_MAX) {
+            return;
+        }
+        // Fails for descriptors without mmap support and, in 32 bit processes, for files
+        // larger than the free address space. Those are read instead.
+        void *mapping = mapFileRange(mFd, (size_t) mappingSize, (uint64_t) mappingOffset);
+        if (mapping == MAP_FAILED) {
+            return;
+        }
+        mMapping = mapping;
+        mMappingSize = (size_t) mappingSize;
+        mData = (const unsigned char *) mapping + (mOffset - mappingOffset);
+        mStats.mapped = true;
+    }
+
+    void FileSource::getFileAccess(FPDF_FILEACCESS *access) {
+        access->m_FileLen = static_cast<unsigned long>(mLength);
+        access->m_GetBlock = &getBlock;
+        access->m_Param = this;
+    }
+
+    FileSourceStats FileSource::getStats() {
+        AutoMutex lock(mLock);
+        return mStats;
+    }
+
+    int FileSource::getBlock(void *param, unsigned long position, unsigned char *outBuffer,
+                             unsigned long size) {
+        auto source = reinterpret_cast<FileSource *>(param);
+        if ((int64_t) position + (int64_t) size > source->mLength) {
+            return 0;
+        }
+        if (source->mData != nullptr) {
+            source->mStats.reads++;
+            source->mStats.bytesRead += size;
+            memcpy(outBuffer, source->mData + position, size);
+            return 1;
+        }
+        return source->readCached((int64_t) position, outBuffer, (size_t) size) ? 1 : 0;
+    }
+
+    void *FileSource::readaheadMain(void *param) {
+        auto source = reinterpret_cast<FileSource *>(param);
+        AutoMutex lock(source->mLock);
+        while (!source->mStopping) {
+            if (source->mReadaheadFirst >= source->mReadaheadEnd) {
+                source->mReadaheadWanted.wait(source->mLock);
+                continue;
+            }
+            int64_t index = source->mReadaheadFirst++;
+            if (source->mBlockIndex.count(index) != 0) {
+                continue;
+            }
+            CacheBlock *block = source->claimBlock(index);
+            if (block == nullptr) {
+                continue;
+            }
+            source->mStats.readaheadBlocks++;
+            source->loadBlock(block);
+        }
+        return nullptr;
+    }
+
+    bool FileSource::readCached(int64_t position, unsigned char *outBuffer, size_t size) {
+        AutoMutex lock(mLock);
+        mStats.reads++;
+        mStats.bytesRead += size;
+        // Large streams, e.g. images, would only push everything else out of the cache
+        if (size > CACHE_BLOCK_SIZE * CACHE_BLOCK_COUNT / 2) {
+            mStats.syscalls++;
+            mLock.unlock();
+            bool read = readFully(mFd, mOffset + position, outBuffer, size);
+            mLock.lock();
+            return read;
+        }
+        while (size > 0) {
+            int64_t index = position / (int64_t) CACHE_BLOCK_SIZE;
+            size_t offset = (size_t) (position % (int64_t) CACHE_BLOCK_SIZE);
+            CacheBlock *block = findBlock(index);
+            if (block == nullptr || offset >= block->size) {
+                return false;
+            }
+            size_t count = std::min(size, block->size - offset);
+            memcpy(outBuffer, block->data + offset, count);
+            outBuffer += count;
+            position += (int64_t) count;
+            size -= count;
+
+            if (index == mLastIndex + 1) {
+                mSequentialCount++;
+            } else if (index != mLastIndex) {
+                mSequentialCount = 0;
+            }
+            mLastIndex = index;
+            if (mSequentialCount >= SEQUENTIAL_THRESHOLD) {
+                scheduleReadahead(index);
+            }
+        }
+        return true;
+    }
+
+    FileSource::CacheBlock *FileSource::findBlock(int64_t index) {
+        std::unordered_map<int64_t, std::list<CacheBlock *>::iterator>::iterator found =
+                mBlockIndex.find(index);
+        if (found != mBlockIndex.end()) {
+            CacheBlock *block = *found->second;
+            while (block->loading) {
+                mBlockLoaded.wait(mLock);
+            }
+            // The block may have been dropped while waiting, look it up again
+            found = mBlockIndex.find(index);
+            if (found != mBlockIndex.end() && *found->second == block && !block->failed) {
+                mBlocks.splice(mBlocks.begin(), mBlocks, found->second);
+                mStats.cacheHits++;
+                return block;
+            }
+        }
+        CacheBlock *block = claimBlock(index);
+        if (block == nullptr) {
+            return nullptr;
+        }
+        mStats.cacheMisses++;
+        loadBlock(block);
+        return block->failed ? nullptr : block;
+    }
+
+    FileSource::CacheBlock *FileSource::claimBlock(int64_t index) {
+        CacheBlock *block = nullptr;
+        if (mBlocks.size() < CACHE_BLOCK_COUNT) {
+            auto data = (unsigned char *) malloc(CACHE_BLOCK_SIZE);
+            if (data == nullptr) {
+                return nullptr;
+            }
+            block = new CacheBlock();
+            block->data = data;
+            mBlocks.push_front(block);
+        } else {
+            // Least recently used block which is not being read
+            std::list<CacheBlock *>::iterator victim = mBlocks.end();
+            while (victim != mBlocks.begin()) {
+                --victim;
+                if (!(*victim)->loading) {
+                    break;
+                }
+            }
+            if ((*victim)->loading) {
+                return nullptr;
+            }
+            block = *victim;
+            mBlockIndex.erase(block->index);
+            mBlocks.splice(mBlocks.begin(), mBlocks, victim);
+        }
+        block->index = index;
+        block->size = 0;
+        block->loading = true;
+        block->failed = false;
+        mBlockIndex[index] = mBlocks.begin();
+        return block;
+    }
+
+    void FileSource::loadBlock(CacheBlock *block) {
+        int64_t position = block->index * (int64_t) CACHE_BLOCK_SIZE;
+        size_t size = (size_t) std::min((int64_t) CACHE_BLOCK_SIZE, mLength - position);
+        mStats.syscalls++;
+        mLock.unlock();
+        bool read = size > 0 && readFully(mFd, mOffset + position, block->data, size);
+        mLock.lock();
+        block->size = read ? size : 0;
+        block->failed = !read;
+        block->loading = false;
+        if (!read) {
+            // Not kept, the next read tries again
+            mBlockIndex.erase(block->index);
+            block->index = -1;
+            mBlocks.remove(block);
+            mBlocks.push_back(block);
+        }
+        mBlockLoaded.broadcast();
+    }
+
+    void FileSource::scheduleReadahead(int64_t index) {
+        int64_t blockCount = (mLength + (int64_t) CACHE_BLOCK_SIZE - 1) /
+                             (int64_t) CACHE_BLOCK_SIZE;
+        int64_t end = std::min(index + 1 + READAHEAD_BLOCKS, blockCount);
+        if (index + 1 >= end) {
+            return;
+        }
+        // Blocks of the window which are cached already are skipped by the thread
+        mReadaheadFirst = index + 1;
+        mReadaheadEnd = end;
+        if (!mReadaheadStarted) {
+            if (pthread_create(&mReadaheadThread, nullptr, &readaheadMain, this) != 0) {
+                mReadaheadFirst = mReadaheadEnd;
+                return;
+            }
+            mReadaheadStarted = true;
+        }
+        mReadaheadWanted.signal();
+    }
+
+}
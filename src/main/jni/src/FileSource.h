@@ -0,0 +1,120 @@
+#ifndef FILE_SOURCE_H_
+#define FILE_SOURCE_H_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <unordered_map>
+
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+
+#include <fpdfview.h>
+
+namespace tools {
+
+    // Mirrored by PdfDocument.FILE_ACCESS_*
+    enum {
+        FILE_ACCESS_MAPPED = 0,
+        FILE_ACCESS_READ = 1
+    };
+
+    struct FileSourceStats {
+        bool mapped;
+        // Blocks pdfium asked for and their total size
+        int64_t reads;
+        int64_t bytesRead;
+        int64_t syscalls;
+        // Cache blocks found, read on demand and read ahead
+        int64_t cacheHits;
+        int64_t cacheMisses;
+        int64_t readaheadBlocks;
+    };
+
+    // pread until size bytes are read, retrying interrupted and short reads
+    bool readFully(int fd, int64_t position, unsigned char *outBuffer, size_t size);
+
+    // The bytes of one document for pdfium. A regular file is mapped once and every block is
+    // copied out of the mapping. The file must not shrink while it is mapped, reading a
+    // truncated mapping raises SIGBUS.
+    //
+    // Anything which cannot be mapped, e.g. a pipe or a socket, and files on FUSE storage are
+    // read in aligned cache blocks kept in a small LRU, so the many small reads of one xref
+    // table or content stream cost one syscall. Once reads move on block by block the
+    // following blocks are read ahead on a background thread.
+    class FileSource {
+    public:
+        // The document is length bytes from offset on, e.g. an uncompressed entry of an archive.
+        // The descriptor is not owned and must stay open while the source is in use.
+        FileSource(int fd, int64_t offset, int64_t length);
+
+        // Waits for a running readahead
+        ~FileSource();
+
+        // Map the file if it can be and is not on FUSE, otherwise blocks are read
+        void open(int fileAccess);
+
+        // Loader for FPDF_LoadCustomDocument, it reads through this source
+        void getFileAccess(FPDF_FILEACCESS *access);
+
+        FileSourceStats getStats();
+
+    private:
+        struct CacheBlock {
+            int64_t index;
+            unsigned char *data;
+            // Valid bytes, less than a block at the end of the file
+            size_t size;
+            // Being read without the lock held, wait for mBlockLoaded
+            bool loading;
+            bool failed;
+        };
+
+        static int getBlock(void *param, unsigned long position, unsigned char *outBuffer,
+                            unsigned long size);
+
+        static void *readaheadMain(void *param);
+
+        bool readCached(int64_t position, unsigned char *outBuffer, size_t size);
+
+        // Called holding mLock, returns the block ready to copy from or nullptr on error
+        CacheBlock *findBlock(int64_t index);
+
+        // Called holding mLock, returns a block marked loading or nullptr if all are loading
+        CacheBlock *claimBlock(int64_t index);
+
+        // Called holding mLock, reads the block with mLock released
+        void loadBlock(CacheBlock *block);
+
+        // Called holding mLock
+        void scheduleReadahead(int64_t index);
+
+        int mFd;
+        int64_t mOffset;
+        int64_t mLength;
+        // Mapped from the page containing the offset on, the document starts at mData
+        void *mMapping;
+        size_t mMappingSize;
+        const unsigned char *mData;
+
+        android::Mutex mLock;
+        android::Condition mBlockLoaded;
+        android::Condition mReadaheadWanted;
+        // Most recently used first
+        std::list<CacheBlock *> mBlocks;
+        std::unordered_map<int64_t, std::list<CacheBlock *>::iterator> mBlockIndex;
+        int64_t mLastIndex;
+        int mSequentialCount;
+        // Blocks the readahead thread reads next, from first up to end
+        int64_t mReadaheadFirst;
+        int64_t mReadaheadEnd;
+        bool mReadaheadStarted;
+        bool mStopping;
+        pthread_t mReadaheadThread;
+        FileSourceStats mStats;
+    };
+
+}
+#endif /* FILE_SOURCE_H_ */
@@ -0,0 +1,694 @@
+#include "ImageEncoder.h"
+#include "PageRender.h"
+#include "PixelConvert.h"
+#include "ScratchPool.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace tools {
+
+    // Rendered rows per band, JPEG bands are rounded to whole rows of 16x16 blocks
+    static const size_t ENCODE_BAND_BYTES = 1024 * 1024;
+    // Buffered output, also the size of each PNG IDAT chunk
+    static const size_t OUTPUT_BUFFER_BYTES = 64 * 1024;
+
+    // Buffered writes to a file descriptor, the first failure sticks
+    class FdOutput {
+    public:
+        explicit FdOutput(int fd) : mFd(fd), mFailed(false) {
+            mBuffer.reserve(OUTPUT_BUFFER_BYTES);
+        }
+
+        void write(const void *data, size_t size) {
+            if (mBuffer.size() + size > OUTPUT_BUFFER_BYTES) {
+                flush();
+            }
+            if (size >= OUTPUT_BUFFER_BYTES) {
+                writeFully((const uint8_t *) data, size);
+            } else {
+                mBuffer.insert(mBuffer.end(), (const uint8_t *) data, (const uint8_t *) data + size);
+            }
+        }
+
+        void put(uint8_t value) {
+            if (mBuffer.size() == OUTPUT_BUFFER_BYTES) {
+                flush();
+            }
+            mBuffer.push_back(value);
+        }
+
+        void putBigEndian16(uint32_t value) {
+            put((uint8_t) (value >> 8));
+            put((uint8_t) value);
+        }
+
+        void putBigEndian32(uint32_t value) {
+            putBigEndian16(value >> 16);
+            putBigEndian16(value & 0xFFFF);
+        }
+
+        bool flush() {
+            writeFully(mBuffer.data(), mBuffer.size());
+            mBuffer.clear();
+            return !mFailed;
+        }
+
+        bool failed() const {
+            return mFailed;
+        }
+
+    private:
+        void writeFully(const uint8_t *data, size_t size) {
+            while (!mFailed && size > 0) {
+                ssize_t written = ::write(mFd, data, size);
+                if (written < 0) {
+                    mFailed = errno != EINTR;
+                } else {
+                    data += written;
+                    size -= (size_t) written;
+                }
+            }
+        }
+
+        int mFd;
+        bool mFailed;
+        std::vector<uint8_t> mBuffer;
+    };
+
+    struct EncodeSource {
+        FPDF_PAGE page;
+        int width;
+        int height;
+        int startX;
+        int startY;
+        int drawSizeHor;
+        int drawSizeVer;
+        uint32_t backgroundColor;
+        bool renderAnnot;
+        int renderFlags;
+    };
+
+    // Rows top to top + band.height. Outside of the page the band is white, or transparent
+    // for RGBA.
+    static bool renderBand(const EncodeSource &source, const RenderTarget &band, int top) {
+        memset(band.pixels, band.format == PIXEL_FORMAT_RGBA_8888 ? 0 : 0xFF,
+               (size_t) band.height * band.stride);
+        return renderPage(source.page, band, source.startX, source.startY - top,
+                          source.drawSizeHor, source.drawSizeVer, source.backgroundColor,
+                          source.renderAnnot, source.renderFlags);
+    }
+
+    // PNG
+
+    static void writePngChunk(FdOutput &out, const char *type, const uint8_t *data, size_t size) {
+        out.putBigEndian32((uint32_t) size);
+        out.write(type, 4);
+        out.write(data, size);
+        uLong crc = crc32(0, (const Bytef *) type, 4);
+        if (size > 0) {
+            crc = crc32(crc, data, (uInt) size);
+        }
+        out.putBigEndian32((uint32_t) crc);
+    }
+
+    // Feeds input to deflate, each filled output buffer becomes an IDAT chunk
+    static bool deflateToChunks(z_stream *stream, FdOutput &out, uint8_t *chunk,
+                                const uint8_t *input, size_t size, int flush) {
+        stream->next_in = (Bytef *) input;
+        stream->avail_in = (uInt) size;
+        for (;;) {
+            int result = deflate(stream, flush);
+            if (result == Z_STREAM_ERROR) {
+                return false;
+            }
+            bool full = stream->avail_out == 0;
+            if (full || result == Z_STREAM_END) {
+                size_t chunkSize = OUTPUT_BUFFER_BYTES - stream->avail_out;
+                if (chunkSize > 0) {
+                    writePngChunk(out, "IDAT", chunk, chunkSize);
+                }
+                stream->next_out = chunk;
+                stream->avail_out = (uInt) OUTPUT_BUFFER_BYTES;
+            }
+            if (out.failed()) {
+                return false;
+            }
+            if (flush == Z_FINISH ? result == Z_STREAM_END : stream->avail_in == 0 && !full) {
+                return true;
+            }
+        }
+    }
+
+    static inline uint8_t paethPredictor(int left, int up, int upLeft) {
+        int estimate = left + up - upLeft;
+        int toLeft = abs(estimate - left);
+        int toUp = abs(estimate - up);
+        int toUpLeft = abs(estimate - upLeft);
+        if (toLeft <= toUp && toLeft <= toUpLeft) {
+            return (uint8_t) left;
+        }
+        return (uint8_t) (toUp <= toUpLeft ? up : upLeft);
+    }
+
+    // Filters the row with each PNG filter and returns the one with the smallest sum of
+    // absolute values, the heuristic libpng uses. best and trial hold the filter type byte
+    // followed by the row, either one is returned.
+    static const uint8_t *filterPngRow(const uint8_t *row, const uint8_t *previous, int rowBytes,
+                                       int pixelBytes, uint8_t *best, uint8_t *trial) {
+        uint32_t bestSum = UINT32_MAX;
+        for (int filter = 0; filter <= 4; filter++) {
+            uint8_t *out = trial + 1;
+            uint32_t sum = 0;
+            for (int i = 0; i < rowBytes; i++) {
+                int left = i >= pixelBytes ? row[i - pixelBytes] : 0;
+                int upLeft = i >= pixelBytes ? previous[i - pixelBytes] : 0;
+                uint8_t predicted;
+                switch (filter) {
+                    case 1:
+                        predicted = (uint8_t) left;
+                        break;
+                    case 2:
+                        predicted = previous[i];
+                        break;
+                    case 3:
+                        predicted = (uint8_t) ((left + previous[i]) >> 1);
+                        break;
+                    case 4:
+                        predicted = paethPredictor(left, previous[i], upLeft);
+                        break;
+                    default:
+                        predicted = 0;
+                        break;
+                }
+                out[i] = (uint8_t) (row[i] - predicted);
+                sum += out[i] < 128 ? out[i] : 256 - out[i];
+            }
+            if (sum < bestSum) {
+                bestSum = sum;
+                trial[0] = (uint8_t) filter;
+                std::swap(best, trial);
+            }
+        }
+        return best;
+    }
+
+    static bool encodePng(const EncodeSource &source, FdOutput &out) {
+        bool alpha = (source.renderFlags & RENDER_FLAG_TRANSPARENT) != 0;
+        int format = alpha ? PIXEL_FORMAT_RGBA_8888 : PIXEL_FORMAT_RGB_888;
+        int pixelBytes = bytesPerPixel(format);
+        if ((uint64_t) source.width * pixelBytes > INT32_MAX - 4) {
+            return false;
+        }
+        int rowBytes = source.width * pixelBytes;
+        int stride = (rowBytes + 3) & ~3;
+        int bandRows = (int) std::max<size_t>(1, ENCODE_BAND_BYTES / stride);
+        bandRows = std::min(bandRows, source.height);
+
+        static const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        out.write(signature, sizeof(signature));
+        uint8_t header[13];
+        uint32_t width = (uint32_t) source.width;
+        uint32_t height = (uint32_t) source.height;
+        for (int i = 0; i < 4; i++) {
+            header[i] = (uint8_t) (width >> (24 - i * 8));
+            header[4 + i] = (uint8_t) (height >> (24 - i * 8));
+        }
+        header[8] = 8;
+        // Truecolor, with alpha for RGBA
+        header[9] = (uint8_t) (alpha ? 6 : 2);
+        header[10] = 0;
+        header[11] = 0;
+        header[12] = 0;
+        writePngChunk(out, "IHDR", header, sizeof(header));
+
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        // libpng defaults for filtered rows
+        if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15, 8, Z_FILTERED) != Z_OK) {
+            return false;
+        }
+        std::vector<uint8_t> chunk(OUTPUT_BUFFER_BYTES);
+        std::vector<uint8_t> filtered(2 * ((size_t) rowBytes + 1));
+        // The row above the first one is zero
+        std::vector<uint8_t> previous((size_t) rowBytes, 0);
+        stream.next_out = chunk.data();
+        stream.avail_out = (uInt) OUTPUT_BUFFER_BYTES;
+
+        size_t capacity;
+        void *pixels = acquireScratch((size_t) bandRows * stride, &capacity);
+        bool encoded = pixels != nullptr;
+        for (int top = 0; encoded && top < source.height; top += bandRows) {
+            RenderTarget band = {pixels, source.width, std::min(bandRows, source.height - top),
+                                 stride, format};
+            if (!renderBand(source, band, top)) {
+                encoded = false;
+                break;
+            }
+            if (alpha) {
+                // PNG alpha is straight
+                unpremultiply(pixels, stride, pixels, stride, band.width, band.height);
+            }
+            const uint8_t *above = previous.data();
+            for (int y = 0; encoded && y < band.height; y++) {
+                const uint8_t *row = (const uint8_t *) pixels + (size_t) y * stride;
+                const uint8_t *filteredRow = filterPngRow(row, above, rowBytes, pixelBytes,
+                                                          filtered.data(),
+                                                          filtered.data() + rowBytes + 1);
+                encoded = deflateToChunks(&stream, out, chunk.data(), filteredRow,
+                                          (size_t) rowBytes + 1, Z_NO_FLUSH);
+                above = row;
+            }
+            memcpy(previous.data(), above, (size_t) rowBytes);
+        }
+        if (pixels != nullptr) {
+            releaseScratch(pixels, capacity);
+        }
+        encoded = encoded && deflateToChunks(&stream, out, chunk.data(), nullptr, 0, Z_FINISH);
+        deflateEnd(&stream);
+        if (!encoded) {
+            return false;
+        }
+        writePngChunk(out, "IEND", nullptr, 0);
+        return true;
+    }
+
+    // JPEG
+
+    static const uint8_t kZigzag[64] = {
+            0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+            12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+            35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+            58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+    // Example tables of the JPEG standard, Annex K
+    static const uint8_t kLumaQuant[64] = {
+            16, 11, 10, 16, 24, 40, 51, 61,
+            12, 12, 14, 19, 26, 58, 60, 55,
+            14, 13, 16, 24, 40, 57, 69, 56,
+            14, 17, 22, 29, 51, 87, 80, 62,
+            18, 22, 37, 56, 68, 109, 103, 77,
+            24, 35, 55, 64, 81, 104, 113, 92,
+            49, 64, 78, 87, 103, 121, 120, 101,
+            72, 92, 95, 98, 112, 100, 103, 99};
+
+    static const uint8_t kChromaQuant[64] = {
+            17, 18, 24, 47, 99, 99, 99, 99,
+            18, 21, 26, 66, 99, 99, 99, 99,
+            24, 26, 56, 99, 99, 99, 99, 99,
+            47, 66, 99, 99, 99, 99, 99, 99,
+            99, 99, 99, 99, 99, 99, 99, 99,
+            99, 99, 99, 99, 99, 99, 99, 99,
+            99, 99, 99, 99, 99, 99, 99, 99,
+            99, 99, 99, 99, 99, 99, 99, 99};
+
+    static const uint8_t kLumaDcBits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+    static const uint8_t kChromaDcBits[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+    static const uint8_t kDcValues[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+    static const uint8_t kLumaAcBits[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D};
+    static const uint8_t kLumaAcValues[162] = {
+            0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51,
+            0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1,
+            0x15, 0x52, 0xD1, 0xF0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18,
+            0x19, 0x1A, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
+            0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57,
+            0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x73, 0x74, 0x75,
+            0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x92,
+            0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+            0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+            0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8,
+            0xD9, 0xDA, 0xE1, 0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2,
+            0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA};
+
+    static const uint8_t kChromaAcBits[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+    static const uint8_t kChromaAcValues[162] = {
+            0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07,
+            0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09,
+            0x23, 0x33, 0x52, 0xF0, 0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25,
+            0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38,
+            0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x53, 0x54, 0x55, 0x56,
+            0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x73, 0x74,
+            0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+            0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+            0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA,
+            0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6,
+            0xD7, 0xD8, 0xD9, 0xDA, 0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2,
+            0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA};
+
+    // Scale factors of the AAN DCT outputs, cos(k * pi / 16) * sqrt(2) for k > 0
+    static const float kAanScale[8] = {1.0f, 1.387039845f, 1.306562965f, 1.175875602f, 1.0f,
+                                       0.785694958f, 0.541196100f, 0.275899379f};
+
+    struct HuffmanCode {
+        uint16_t code;
+        uint8_t length;
+    };
+
+    struct HuffmanTable {
+        const uint8_t *bits;
+        const uint8_t *values;
+        int valueCount;
+        HuffmanCode codes[256];
+    };
+
+    static void buildHuffmanTable(const uint8_t *bits, const uint8_t *values, int valueCount,
+                                  HuffmanTable *table) {
+        table->bits = bits;
+        table->values = values;
+        table->valueCount = valueCount;
+        memset(table->codes, 0, sizeof(table->codes));
+        int code = 0;
+        int index = 0;
+        for (int length = 1; length <= 16; length++) {
+            for (int i = 0; i < bits[length - 1]; i++) {
+                table->codes[values[index]].code = (uint16_t) code++;
+                table->codes[values[index]].length = (uint8_t) length;
+                index++;
+            }
+            code <<= 1;
+        }
+    }
+
+    // Entropy coded bits, a 0xFF byte is followed by a stuffed 0
+    class JpegBitWriter {
+    public:
+        explicit JpegBitWriter(FdOutput &out) : mOut(out), mBits(0), mCount(0) {
+        }
+
+        void write(uint32_t bits, int length) {
+            mBits = (mBits << length) | bits;
+            mCount += length;
+            while (mCount >= 8) {
+                uint8_t value = (uint8_t) (mBits >> (mCount - 8));
+                mOut.put(value);
+                if (value == 0xFF) {
+                    mOut.put(0);
+                }
+                mCount -= 8;
+            }
+            mBits &= (1u << mCount) - 1;
+        }
+
+        void write(const HuffmanCode &code) {
+            write(code.code, code.length);
+        }
+
+        // Pads the last byte with 1 bits
+        void flush() {
+            if (mCount > 0) {
+                write((1u << (8 - mCount)) - 1, 8 - mCount);
+            }
+        }
+
+    private:
+        FdOutput &mOut;
+        uint32_t mBits;
+        int mCount;
+    };
+
+    // In place float AAN forward DCT of rows and then columns, outputs are scaled by kAanScale
+    static void forwardDct(float *block) {
+        for (int pass = 0; pass < 2; pass++) {
+            int step = pass == 0 ? 1 : 8;
+            int next = pass == 0 ? 8 : 1;
+            for (int line = 0; line < 8; line++) {
+                float *d = block + line * next;
+                float tmp0 = d[0] + d[7 * step];
+                float tmp7 = d[0] - d[7 * step];
+                float tmp1 = d[step] + d[6 * step];
+                float tmp6 = d[step] - d[6 * step];
+                float tmp2 = d[2 * step] + d[5 * step];
+                float tmp5 = d[2 * step] - d[5 * step];
+                float tmp3 = d[3 * step] + d[4 * step];
+                float tmp4 = d[3 * step] - d[4 * step];
+
+                float tmp10 = tmp0 + tmp3;
+                float tmp13 = tmp0 - tmp3;
+                float tmp11 = tmp1 + tmp2;
+                float tmp12 = tmp1 - tmp2;
+                d[0] = tmp10 + tmp11;
+                d[4 * step] = tmp10 - tmp11;
+                float z1 = (tmp12 + tmp13) * 0.707106781f;
+                d[2 * step] = tmp13 + z1;
+                d[6 * step] = tmp13 - z1;
+
+                tmp10 = tmp4 + tmp5;
+                tmp11 = tmp5 + tmp6;
+                tmp12 = tmp6 + tmp7;
+                float z5 = (tmp10 - tmp12) * 0.382683433f;
+                float z2 = 0.541196100f * tmp10 + z5;
+                float z4 = 1.306562965f * tmp12 + z5;
+                float z3 = tmp11 * 0.707106781f;
+                float z11 = tmp7 + z3;
+                float z13 = tmp7 - z3;
+                d[5 * step] = z13 + z2;
+                d[3 * step] = z13 - z2;
+                d[step] = z11 + z4;
+                d[7 * step] = z11 - z4;
+            }
+        }
+    }
+
+    static inline int bitLength(int value) {
+        int length = 0;
+        for (value = abs(value); value != 0; value >>= 1) {
+            length++;
+        }
+        return length;
+    }
+
+    // Returns the DC value for the prediction of the next block of the component
+    static int encodeBlock(JpegBitWriter &writer, float *block, const float *divisors,
+                           int previousDc, const HuffmanTable &dc, const HuffmanTable &ac) {
+        forwardDct(block);
+        int quantized[64];
+        for (int k = 0; k < 64; k++) {
+            float value = block[kZigzag[k]] * divisors[kZigzag[k]];
+            quantized[k] = (int) (value < 0 ? value - 0.5f : value + 0.5f);
+        }
+
+        int difference = quantized[0] - previousDc;
+        int length = bitLength(difference);
+        writer.write(dc.codes[length]);
+        if (length > 0) {
+            writer.write((uint32_t) (difference < 0 ? difference - 1 : difference) &
+                         ((1u << length) - 1), length);
+        }
+
+        int last = 63;
+        while (last > 0 && quantized[last] == 0) {
+            last--;
+        }
+        int run = 0;
+        for (int k = 1; k <= last; k++) {
+            int value = quantized[k];
+            if (value == 0) {
+                run++;
+                continue;
+            }
+            while (run >= 16) {
+                writer.write(ac.codes[0xF0]);
+                run -= 16;
+            }
+            length = bitLength(value);
+            writer.write(ac.codes[(run << 4) | length]);
+            writer.write((uint32_t) (value < 0 ? value - 1 : value) & ((1u << length) - 1),
+                         length);
+            run = 0;
+        }
+        if (last < 63) {
+            writer.write(ac.codes[0x00]);
+        }
+        return quantized[0];
+    }
+
+    // IJG quality scaling. Tables are written in zigzag order, the divisors fold in the DCT
+    // scale factors and stay in natural order.
+    static void scaleQuantTable(const uint8_t *base, int quality, uint8_t *zigzagTable,
+                                float *divisors) {
+        int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+        uint8_t natural[64];
+        for (int i = 0; i < 64; i++) {
+            natural[i] = (uint8_t) std::min(255, std::max(1, (base[i] * scale + 50) / 100));
+        }
+        for (int k = 0; k < 64; k++) {
+            zigzagTable[k] = natural[kZigzag[k]];
+        }
+        for (int row = 0; row < 8; row++) {
+            for (int column = 0; column < 8; column++) {
+                int i = row * 8 + column;
+                divisors[i] = 1.0f / (natural[i] * kAanScale[row] * kAanScale[column] * 8.0f);
+            }
+        }
+    }
+
+    static void writeJpegHuffmanTable(FdOutput &out, int tableClass, int id,
+                                      const HuffmanTable &table) {
+        out.put((uint8_t) (tableClass << 4 | id));
+        out.write(table.bits, 16);
+        out.write(table.values, (size_t) table.valueCount);
+    }
+
+    static void writeJpegHeaders(FdOutput &out, int width, int height,
+                                 const uint8_t *lumaQuant, const uint8_t *chromaQuant,
+                                 const HuffmanTable *tables) {
+        static const uint8_t jfif[] = {0xFF, 0xD8, 0xFF, 0xE0, 0, 16, 'J', 'F', 'I', 'F', 0, 1, 1,
+                                       0, 0, 1, 0, 1, 0, 0};
+        out.write(jfif, sizeof(jfif));
+
+        out.putBigEndian16(0xFFDB);
+        out.putBigEndian16(2 + 2 * 65);
+        out.put(0);
+        out.write(lumaQuant, 64);
+        out.put(1);
+        out.write(chromaQuant, 64);
+
+        // Baseline frame, Y sampled 2x2, Cb and Cr 1x1
+        static const uint8_t components[] = {3, 1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1};
+        out.putBigEndian16(0xFFC0);
+        out.putBigEndian16(2 + 5 + sizeof(components));
+        out.put(8);
+        out.putBigEndian16((uint32_t) height);
+        out.putBigEndian16((uint32_t) width);
+        out.write(components, sizeof(components));
+
+        out.putBigEndian16(0xFFC4);
+        out.putBigEndian16(2 + 4 * 17 + 2 * 12 + 2 * 162);
+        writeJpegHuffmanTable(out, 0, 0, tables[0]);
+        writeJpegHuffmanTable(out, 1, 0, tables[1]);
+        writeJpegHuffmanTable(out, 0, 1, tables[2]);
+        writeJpegHuffmanTable(out, 1, 1, tables[3]);
+
+        static const uint8_t scan[] = {0xFF, 0xDA, 0, 12, 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0};
+        out.write(scan, sizeof(scan));
+    }
+
+    static bool encodeJpeg(const EncodeSource &source, int quality, FdOutput &out) {
+        // Frame sizes are 16 bit
+        if (source.width > 0xFFFF || source.height > 0xFFFF) {
+            return false;
+        }
+        quality = std::min(100, std::max(1, quality));
+        uint8_t lumaQuant[64];
+        uint8_t chromaQuant[64];
+        float lumaDivisors[64];
+        float chromaDivisors[64];
+        scaleQuantTable(kLumaQuant, quality, lumaQuant, lumaDivisors);
+        scaleQuantTable(kChromaQuant, quality, chromaQuant, chromaDivisors);
+        // Luma DC, luma AC, chroma DC, chroma AC
+        std::vector<HuffmanTable> tables(4);
+        buildHuffmanTable(kLumaDcBits, kDcValues, sizeof(kDcValues), &tables[0]);
+        buildHuffmanTable(kLumaAcBits, kLumaAcValues, sizeof(kLumaAcValues), &tables[1]);
+        buildHuffmanTable(kChromaDcBits, kDcValues, sizeof(kDcValues), &tables[2]);
+        buildHuffmanTable(kChromaAcBits, kChromaAcValues, sizeof(kChromaAcValues), &tables[3]);
+        writeJpegHeaders(out, source.width, source.height, lumaQuant, chromaQuant,
+                         tables.data());
+
+        int stride = (source.width * 3 + 3) & ~3;
+        int bandRows = (int) std::max<size_t>(16, (ENCODE_BAND_BYTES / stride) & ~(size_t) 15);
+        bandRows = std::min(bandRows, (source.height + 15) & ~15);
+        size_t capacity;
+        void *pixels = acquireScratch((size_t) bandRows * stride, &capacity);
+        if (pixels == nullptr) {
+            return false;
+        }
+
+        JpegBitWriter writer(out);
+        int previousY = 0;
+        int previousCb = 0;
+        int previousCr = 0;
+        bool encoded = true;
+        float y[256];
+        float cb[256];
+        float cr[256];
+        float block[64];
+        for (int top = 0; encoded && top < source.height; top += bandRows) {
+            RenderTarget band = {pixels, source.width, std::min(bandRows, source.height - top),
+                                 stride, PIXEL_FORMAT_RGB_888};
+            if (!renderBand(source, band, top)) {
+                encoded = false;
+                break;
+            }
+            for (int mcuTop = 0; mcuTop < band.height; mcuTop += 16) {
+                for (int mcuLeft = 0; mcuLeft < source.width; mcuLeft += 16) {
+                    // Edge pixels repeat past the image
+                    for (int row = 0; row < 16; row++) {
+                        int sourceRow = std::min(mcuTop + row, band.height - 1);
+                        const uint8_t *rgb = (const uint8_t *) pixels + (size_t) sourceRow * stride;
+                        for (int column = 0; column < 16; column++) {
+                            const uint8_t *pixel = rgb + std::min(mcuLeft + column,
+                                                                  source.width - 1) * 3;
+                            float red = pixel[0];
+                            float green = pixel[1];
+                            float blue = pixel[2];
+                            int i = row * 16 + column;
+                            y[i] = 0.299f * red + 0.587f * green + 0.114f * blue - 128.0f;
+                            cb[i] = -0.168736f * red - 0.331264f * green + 0.5f * blue;
+                            cr[i] = 0.5f * red - 0.418688f * green - 0.081312f * blue;
+                        }
+                    }
+                    for (int blockIndex = 0; blockIndex < 4; blockIndex++) {
+                        const float *origin = y + (blockIndex >> 1) * 128 + (blockIndex & 1) * 8;
+                        for (int row = 0; row < 8; row++) {
+                            memcpy(block + row * 8, origin + row * 16, 8 * sizeof(float));
+                        }
+                        previousY = encodeBlock(writer, block, lumaDivisors, previousY, tables[0],
+                                                tables[1]);
+                    }
+                    for (int plane = 0; plane < 2; plane++) {
+                        const float *chroma = plane == 0 ? cb : cr;
+                        for (int row = 0; row < 8; row++) {
+                            for (int column = 0; column < 8; column++) {
+                                const float *quad = chroma + row * 32 + column * 2;
+                                block[row * 8 + column] =
+                                        (quad[0] + quad[1] + quad[16] + quad[17]) * 0.25f;
+                            }
+                        }
+                        int &previous = plane == 0 ? previousCb : previousCr;
+                        previous = encodeBlock(writer, block, chromaDivisors, previous, tables[2],
+                                               tables[3]);
+                    }
+                }
+            }
+            encoded = !out.failed();
+        }
+        releaseScratch(pixels, capacity);
+        if (!encoded) {
+            return false;
+        }
+        writer.flush();
+        out.putBigEndian16(0xFFD9);
+        return true;
+    }
+
+    bool encodePage(FPDF_PAGE page, int fd, int imageFormat, int quality, int width, int height,
+                    int startX, int startY, int drawSizeHor, int drawSizeVer,
+                    uint32_t backgroundColor, bool renderAnnot, int renderFlags) {
+        if (page == nullptr || fd < 0 || width <= 0 || height <= 0) {
+            return false;
+        }
+        EncodeSource source = {page, width, height, startX, startY, drawSizeHor, drawSizeVer,
+                               backgroundColor, renderAnnot, renderFlags};
+        FdOutput out(fd);
+        bool encoded;
+        switch (imageFormat) {
+            case IMAGE_FORMAT_PNG:
+                encoded = encodePng(source, out);
+                break;
+            case IMAGE_FORMAT_JPEG:
+                encoded = encodeJpeg(source, quality, out);
+                break;
+            default:
+                return false;
+        }
+        return out.flush() && encoded;
+    }
+
+}
@@ -0,0 +1,25 @@
+#ifndef IMAGE_ENCODER_H_
+#define IMAGE_ENCODER_H_
+
+#include <stdint.h>
+
+#include <fpdfview.h>
+
+namespace tools {
+
+    // Mirrored by PdfDocument.PdfPage.IMAGE_FORMAT_*
+    enum {
+        IMAGE_FORMAT_PNG = 1,
+        // Baseline JPEG with 4:2:0 chroma subsampling
+        IMAGE_FORMAT_JPEG = 2
+    };
+
+    // Render the page in bands and write each band to fd as soon as it is encoded, memory use
+    // depends on the width only. PNG is RGB, or RGBA with RENDER_FLAG_TRANSPARENT. quality from
+    // 1 to 100 applies to JPEG only. False on failure, fd may then hold part of the image.
+    bool encodePage(FPDF_PAGE page, int fd, int imageFormat, int quality, int width, int height,
+                    int startX, int startY, int drawSizeHor, int drawSizeVer,
+                    uint32_t backgroundColor, bool renderAnnot, int renderFlags);
+
+}
+#endif /* IMAGE_ENCODER_H_ */
@@ -0,0 +1,140 @@
+#include "MappedRender.h"
+#include "PageRender.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/statfs.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <string>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+namespace tools {
+
+    // Rows mapped at once, small enough for the address space of 32 bit processes
+    static const size_t MAPPED_BAND_BYTES = 16 * 1024 * 1024;
+
+    static int createRenderFile(const char *tempDir) {
+        int fd;
+#ifdef __NR_memfd_create
+        fd = (int) syscall(__NR_memfd_create, "pdfium-render", MFD_CLOEXEC);
+        if (fd >= 0) {
+            return fd;
+        }
+#endif
+        if (tempDir == nullptr) {
+            return -1;
+        }
+        std::string path(tempDir);
+        path += "/pdfium-render-XXXXXX";
+        fd = mkstemp(&path[0]);
+        if (fd >= 0) {
+            // Only the descriptor keeps the file alive
+            unlink(path.c_str());
+        }
+        return fd;
+    }
+
+    // Running out of space while writing to a mapping raises SIGBUS instead of an error, so
+    // the free space is checked up front. posix_fallocate needs API 21.
+    static bool reserveRenderFile(int fd, uint64_t size) {
+        struct statfs stats;
+        // memfd lives on an internal mount without a size limit, which reports no blocks
+        if (fstatfs(fd, &stats) == 0 && stats.f_blocks != 0 &&
+            (uint64_t) stats.f_bavail * stats.f_bsize < size) {
+            return false;
+        }
+        return ftruncate64(fd, (off64_t) size) == 0;
+    }
+
+    static void *mapRenderBand(int fd, size_t size, uint64_t offset) {
+#if defined(__LP64__)
+        return mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, (off_t) offset);
+#else
+        // mmap64 needs API 21, mmap2 takes the offset in 4096 byte units on 32 bit ABIs
+        return (void *) syscall(__NR_mmap2, nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                                (unsigned long) (offset >> 12));
+#endif
+    }
+
+    static bool renderBands(FPDF_PAGE page, int fd, const MappedRenderHeader &header,
+                            int startX, int startY, int drawSizeHor, int drawSizeVer,
+                            uint32_t backgroundColor, bool renderAnnot, int renderFlags) {
+        size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+        int height = (int) header.height;
+        // Multiples of 4 rows keep the dither pattern continuous across bands
+        int bandRows = (int) std::max<size_t>(4, (MAPPED_BAND_BYTES / header.stride) & ~3u);
+        for (int top = 0; top < height; top += bandRows) {
+            int rows = std::min(bandRows, height - top);
+            uint64_t offset = header.dataOffset + (uint64_t) top * header.stride;
+            uint64_t mapOffset = offset & ~(uint64_t) (pageSize - 1);
+            size_t skip = (size_t) (offset - mapOffset);
+            size_t mapSize = skip + (size_t) rows * header.stride;
+            void *mapped = mapRenderBand(fd, mapSize, mapOffset);
+            if (mapped == MAP_FAILED) {
+                return false;
+            }
+            RenderTarget band = {(char *) mapped + skip, (int) header.width, rows,
+                                 (int) header.stride, (int) header.format};
+            bool rendered = renderPage(page, band, startX, startY - top, drawSizeHor,
+                                       drawSizeVer, backgroundColor, renderAnnot, renderFlags);
+            munmap(mapped, mapSize);
+            if (!rendered) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int renderPageToFile(FPDF_PAGE page, const char *tempDir, int width, int height, int format,
+                         int startX, int startY, int drawSizeHor, int drawSizeVer,
+                         uint32_t backgroundColor, bool renderAnnot, int renderFlags,
+                         MappedRenderHeader *outHeader) {
+        int pixelBytes = bytesPerPixel(format);
+        if (page == nullptr || width <= 0 || height <= 0 || pixelBytes == 0) {
+            return -1;
+        }
+        MappedRenderHeader header;
+        header.magic = 0;
+        header.version = MAPPED_RENDER_VERSION;
+        header.width = (uint32_t) width;
+        header.height = (uint32_t) height;
+        // Rows 4 byte aligned as in pdfium bitmaps
+        uint64_t stride = ((uint64_t) width * pixelBytes + 3) & ~(uint64_t) 3;
+        if (stride > INT32_MAX) {
+            return -1;
+        }
+        header.stride = (uint32_t) stride;
+        header.format = (uint32_t) format;
+        size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+        header.dataOffset = (sizeof(MappedRenderHeader) + pageSize - 1) / pageSize * pageSize;
+        header.dataSize = stride * height;
+
+        int fd = createRenderFile(tempDir);
+        if (fd < 0) {
+            return -1;
+        }
+        if (!reserveRenderFile(fd, header.dataOffset + header.dataSize) ||
+            !renderBands(page, fd, header, startX, startY, drawSizeHor, drawSizeVer,
+                         backgroundColor, renderAnnot, renderFlags)) {
+            close(fd);
+            return -1;
+        }
+        // The magic goes in last, a file without it never finished rendering
+        header.magic = MAPPED_RENDER_MAGIC;
+        if (pwrite(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header)) {
+            close(fd);
+            return -1;
+        }
+        if (outHeader != nullptr) {
+            *outHeader = header;
+        }
+        return fd;
+    }
+
+}
@@ -0,0 +1,40 @@
+#ifndef MAPPED_RENDER_H_
+#define MAPPED_RENDER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <fpdfview.h>
+
+namespace tools {
+
+    // 'PDFR' at the start of a complete mapped render
+    static const uint32_t MAPPED_RENDER_MAGIC = 0x52464450;
+    static const uint32_t MAPPED_RENDER_VERSION = 1;
+
+    // Layout of a mapped render file, native endian. The rows follow at dataOffset, which is a
+    // multiple of the system page size so readers can map bands of rows on their own.
+    struct MappedRenderHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        // Bytes between the starts of two rows
+        uint32_t stride;
+        // One of PIXEL_FORMAT_*
+        uint32_t format;
+        uint64_t dataOffset;
+        uint64_t dataSize;
+    };
+
+    // Render pages too large for the heap or a bitmap into a file, one band of rows mapped at
+    // a time, so the kernel writes back or swaps out finished rows as memory gets short. The
+    // file is an anonymous memfd where the kernel supports it, otherwise an unlinked temp file
+    // in tempDir. Returns the file descriptor owned by the caller, -1 on failure.
+    int renderPageToFile(FPDF_PAGE page, const char *tempDir, int width, int height, int format,
+                         int startX, int startY, int drawSizeHor, int drawSizeVer,
+                         uint32_t backgroundColor, bool renderAnnot, int renderFlags,
+                         MappedRenderHeader *outHeader);
+
+}
+#endif /* MAPPED_RENDER_H_ */
@@ -0,0 +1,339 @@
+#include "PageRender.h"
+#include "PixelConvert.h"
+#include "ScratchPool.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <fpdf_edit.h>
+
+namespace tools {
+
+    // RGB_565 output is rendered into a 24 bit buffer of this many bytes at a time and converted
+    // straight into the target, so its temporary memory does not grow with the page size.
+    static const size_t RENDER_BAND_BYTES = 256 * 1024;
+
+    // FPDFBitmap_FillRect takes ARGB and writes it in BGRA order, reversed targets want RGBA
+    static inline uint32_t argbToAbgr(uint32_t color) {
+        return (color & 0xFF00FF00) | ((color & 0xFF) << 16) | ((color >> 16) & 0xFF);
+    }
+
+    int bytesPerPixel(int format) {
+        switch (format) {
+            case PIXEL_FORMAT_RGBA_8888:
+            case PIXEL_FORMAT_BGRA_8888:
+                return 4;
+            case PIXEL_FORMAT_RGB_888:
+            case PIXEL_FORMAT_BGR_888:
+                return 3;
+            case PIXEL_FORMAT_RGB_565:
+                return 2;
+            case PIXEL_FORMAT_GRAY_8:
+                return 1;
+            default:
+                return 0;
+        }
+    }
+
+    size_t targetSize(const RenderTarget &target) {
+        int pixelBytes = bytesPerPixel(target.format);
+        if (pixelBytes == 0 || target.pixels == nullptr || target.width <= 0 ||
+            target.height <= 0 || target.stride < target.width * pixelBytes) {
+            return 0;
+        }
+        return (size_t) target.stride * (target.height - 1) + (size_t) target.width * pixelBytes;
+    }
+
+    int pdfiumRenderFlags(bool renderAnnot, int renderFlags) {
+        int flags = FPDF_REVERSE_BYTE_ORDER;
+        if (renderFlags & RENDER_FLAG_DRAFT) {
+            flags |= FPDF_RENDER_NO_SMOOTHTEXT | FPDF_RENDER_NO_SMOOTHIMAGE |
+                     FPDF_RENDER_NO_SMOOTHPATH | FPDF_RENDER_LIMITEDIMAGECACHE;
+        } else if (renderFlags & RENDER_FLAG_PRINT) {
+            flags |= FPDF_PRINTING;
+        } else {
+            flags |= FPDF_LCD_TEXT;
+        }
+        if (renderAnnot) {
+            flags |= FPDF_ANNOT;
+        }
+        return flags;
+    }
+
+    bool convertPixels(const RenderTarget &source, const RenderTarget &dest, int renderFlags,
+                       int originX, int originY) {
+        if (targetSize(dest) == 0 || source.pixels == nullptr) {
+            return false;
+        }
+        const void *src = source.pixels;
+        void *dst = dest.pixels;
+        int width = dest.width;
+        int height = dest.height;
+        bool dither = (renderFlags & RENDER_FLAG_DITHER) != 0;
+        if (source.format == dest.format) {
+            size_t rowBytes = (size_t) width * bytesPerPixel(dest.format);
+            for (int y = 0; y < height; y++) {
+                memcpy((char *) dst + (size_t) y * dest.stride,
+                       (const char *) src + (size_t) y * source.stride, rowBytes);
+            }
+            return true;
+        }
+        switch (source.format << 8 | dest.format) {
+            case PIXEL_FORMAT_RGBA_8888 << 8 | PIXEL_FORMAT_BGRA_8888:
+            case PIXEL_FORMAT_BGRA_8888 << 8 | PIXEL_FORMAT_RGBA_8888:
+                swapRedBlue(src, source.stride, dst, dest.stride, width, height);
+                return true;
+            case PIXEL_FORMAT_BGRA_8888 << 8 | PIXEL_FORMAT_RGB_565:
+                if (dither) {
+                    bgraTo565Dither(src, source.stride, dst, dest.stride, width, height,
+                                    originX, originY);
+                } else {
+                    bgraTo565(src, source.stride, dst, dest.stride, width, height);
+                }
+                return true;
+            case PIXEL_FORMAT_RGB_888 << 8 | PIXEL_FORMAT_RGB_565:
+                if (dither) {
+                    rgb24To565Dither(src, source.stride, dst, dest.stride, width, height,
+                                     originX, originY);
+                } else {
+                    rgb24To565(src, source.stride, dst, dest.stride, width, height);
+                }
+                return true;
+            case PIXEL_FORMAT_BGRA_8888 << 8 | PIXEL_FORMAT_GRAY_8:
+                bgraToGray8(src, source.stride, dst, dest.stride, width, height);
+                return true;
+            // Dropping alpha while swapping red and blue
+            case PIXEL_FORMAT_BGRA_8888 << 8 | PIXEL_FORMAT_RGB_888:
+            case PIXEL_FORMAT_RGBA_8888 << 8 | PIXEL_FORMAT_BGR_888:
+                bgraToRgb24(src, source.stride, dst, dest.stride, width, height);
+                return true;
+            // Dropping alpha and keeping the order
+            case PIXEL_FORMAT_RGBA_8888 << 8 | PIXEL_FORMAT_RGB_888:
+            case PIXEL_FORMAT_BGRA_8888 << 8 | PIXEL_FORMAT_BGR_888:
+                rgbaToRgb24(src, source.stride, dst, dest.stride, width, height);
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void pageArea(const RenderTarget &target, int startX, int startY, int drawSizeHor,
+                  int drawSizeVer, int *left, int *top, int *width, int *height) {
+        *left = std::max(0, startX);
+        *top = std::max(0, startY);
+        *width = std::min(target.width, startX + drawSizeHor) - *left;
+        *height = std::min(target.height, startY + drawSizeVer) - *top;
+    }
+
+    static bool renderPageBands565(FPDF_PAGE page, const RenderTarget &target, int startX,
+                                   int startY, int drawSizeHor, int drawSizeVer,
+                                   uint32_t backgroundColor, int flags, int renderFlags) {
+        int canvasHorSize = target.width;
+        int canvasVerSize = target.height;
+        int bandStride = canvasHorSize * 3;
+        int bandRows = std::max(1, std::min(canvasVerSize,
+                                            (int) (RENDER_BAND_BYTES / bandStride)));
+        size_t bandCapacity;
+        void *band = acquireScratch((size_t) bandRows * bandStride, &bandCapacity);
+        if (band == nullptr) {
+            return false;
+        }
+
+        int fillLeft, fillTop, fillWidth, fillHeight;
+        pageArea(target, startX, startY, drawSizeHor, drawSizeVer, &fillLeft, &fillTop,
+                 &fillWidth, &fillHeight);
+        if (fillWidth <= 0 || fillHeight <= 0) {
+            backgroundColor = 0;
+        }
+
+        for (int bandTop = 0; bandTop < canvasVerSize; bandTop += bandRows) {
+            int rows = std::min(bandRows, canvasVerSize - bandTop);
+            FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx(canvasHorSize, rows, FPDFBitmap_BGR,
+                                                        band, bandStride);
+            bool filled = backgroundColor != 0 && fillLeft == 0 && fillWidth >= canvasHorSize &&
+                          fillTop <= bandTop && fillTop + fillHeight >= bandTop + rows;
+            if (!filled) {
+                // Do not leave pixels of the previous band outside of the fill area
+                memset(band, 0, (size_t) rows * bandStride);
+            }
+            if (backgroundColor != 0) {
+                FPDFBitmap_FillRect(pdfBitmap, fillLeft, fillTop - bandTop, fillWidth,
+                                    fillHeight, argbToAbgr(backgroundColor));
+            }
+            FPDF_RenderPageBitmap(pdfBitmap, page, startX, startY - bandTop, drawSizeHor,
+                                  drawSizeVer, 0, flags);
+            FPDFBitmap_Destroy(pdfBitmap);
+
+            RenderTarget source = {band, canvasHorSize, rows, bandStride, PIXEL_FORMAT_RGB_888};
+            RenderTarget dest = {(char *) target.pixels + (size_t) bandTop * target.stride,
+                                 canvasHorSize, rows, target.stride, PIXEL_FORMAT_RGB_565};
+            // The pattern is anchored to the page, so strips rendered by scrollPage and the
+            // pixels it moves line up with a full render
+            convertPixels(source, dest, renderFlags, -startX, bandTop - startY);
+        }
+        releaseScratch(band, bandCapacity);
+        return true;
+    }
+
+    bool renderPage(FPDF_PAGE page, const RenderTarget &target, int startX, int startY,
+                    int drawSizeHor, int drawSizeVer, uint32_t backgroundColor, bool renderAnnot,
+                    int renderFlags) {
+        if (page == nullptr || targetSize(target) == 0) {
+            return false;
+        }
+        int flags = pdfiumRenderFlags(renderAnnot, renderFlags);
+        if (target.format == PIXEL_FORMAT_RGB_565) {
+            return renderPageBands565(page, target, startX, startY, drawSizeHor, drawSizeVer,
+                                      backgroundColor, flags, renderFlags);
+        }
+
+        int format;
+        uint32_t fillColor = backgroundColor;
+        bool hasAlpha = target.format == PIXEL_FORMAT_RGBA_8888 ||
+                        target.format == PIXEL_FORMAT_BGRA_8888;
+        bool transparent = hasAlpha && (renderFlags & RENDER_FLAG_TRANSPARENT) != 0;
+        switch (target.format) {
+            case PIXEL_FORMAT_RGBA_8888:
+            case PIXEL_FORMAT_BGRA_8888:
+                // Over an opaque background a page without transparency never changes alpha,
+                // pdfium then composites without an alpha channel, which is cheaper
+                format = !transparent && (backgroundColor >> 24) == 0xFF &&
+                         !FPDFPage_HasTransparency(page) ? FPDFBitmap_BGRx : FPDFBitmap_BGRA;
+                if (target.format == PIXEL_FORMAT_RGBA_8888) {
+                    fillColor = argbToAbgr(backgroundColor);
+                } else {
+                    flags &= ~FPDF_REVERSE_BYTE_ORDER;
+                }
+                break;
+            case PIXEL_FORMAT_RGB_888:
+                format = FPDFBitmap_BGR;
+                fillColor = argbToAbgr(backgroundColor);
+                break;
+            case PIXEL_FORMAT_BGR_888:
+                format = FPDFBitmap_BGR;
+                flags &= ~FPDF_REVERSE_BYTE_ORDER;
+                break;
+            default:
+                // Sub-pixel text needs color channels, so gray output uses plain anti-aliasing
+                format = FPDFBitmap_Gray;
+                flags = (flags & ~FPDF_LCD_TEXT) | FPDF_GRAYSCALE;
+                break;
+        }
+
+        FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx(target.width, target.height, format,
+                                                    target.pixels, target.stride);
+        if (pdfBitmap == nullptr) {
+            return false;
+        }
+
+        int fillLeft, fillTop, fillWidth, fillHeight;
+        pageArea(target, startX, startY, drawSizeHor, drawSizeVer, &fillLeft, &fillTop,
+                 &fillWidth, &fillHeight);
+        bool hasArea = fillWidth > 0 && fillHeight > 0;
+        char *areaOrigin = (char *) target.pixels + (size_t) fillTop * target.stride +
+                           (size_t) fillLeft * 4;
+        if (transparent) {
+            // pdfium blends onto the existing pixels, so the page area starts out clear. Sub-pixel
+            // text needs an opaque backdrop.
+            flags &= ~FPDF_LCD_TEXT;
+            for (int y = 0; hasArea && y < fillHeight; y++) {
+                memset(areaOrigin + (size_t) y * target.stride, 0, (size_t) fillWidth * 4);
+            }
+        } else if (backgroundColor != 0 && hasArea) {
+            FPDFBitmap_FillRect(pdfBitmap, fillLeft, fillTop, fillWidth, fillHeight, fillColor);
+        }
+
+        FPDF_RenderPageBitmap(pdfBitmap, page, startX, startY, drawSizeHor, drawSizeVer, 0,
+                              flags);
+        FPDFBitmap_Destroy(pdfBitmap);
+        if (transparent && hasArea) {
+            // pdfium writes straight alpha, bitmaps and compositors expect it premultiplied
+            premultiply(areaOrigin, target.stride, areaOrigin, target.stride, fillWidth,
+                        fillHeight);
+        }
+        return true;
+    }
+
+    static void clearTarget(const RenderTarget &target) {
+        size_t rowBytes = (size_t) target.width * bytesPerPixel(target.format);
+        for (int y = 0; y < target.height; y++) {
+            memset((char *) target.pixels + (size_t) y * target.stride, 0, rowBytes);
+        }
+    }
+
+    bool renderTile(FPDF_PAGE page, const RenderTarget &tile, int tileLeft, int tileTop,
+                    int pageSizeHor, int pageSizeVer, uint32_t backgroundColor, bool renderAnnot,
+                    int renderFlags) {
+        if (page == nullptr || targetSize(tile) == 0) {
+            return false;
+        }
+        // pdfium blends onto the pixels already there, in an atlas those of an earlier tile
+        if ((backgroundColor >> 24) != 0xFF) {
+            clearTarget(tile);
+        }
+        return renderPage(page, tile, -tileLeft, -tileTop, pageSizeHor, pageSizeVer,
+                          backgroundColor, renderAnnot, renderFlags);
+    }
+
+    // Clear and render one exposed strip, page offsets stay relative to the whole target
+    static bool renderStrip(FPDF_PAGE page, const RenderTarget &target, int left, int top,
+                            int width, int height, int startX, int startY, int drawSizeHor,
+                            int drawSizeVer, uint32_t backgroundColor, bool renderAnnot,
+                            int renderFlags) {
+        int pixelBytes = bytesPerPixel(target.format);
+        RenderTarget strip = {(char *) target.pixels + (size_t) top * target.stride +
+                              (size_t) left * pixelBytes, width, height, target.stride,
+                              target.format};
+        clearTarget(strip);
+        return renderPage(page, strip, startX - left, startY - top, drawSizeHor, drawSizeVer,
+                          backgroundColor, renderAnnot, renderFlags);
+    }
+
+    bool scrollPage(FPDF_PAGE page, const RenderTarget &target, int deltaX, int deltaY,
+                    int startX, int startY, int drawSizeHor, int drawSizeVer,
+                    uint32_t backgroundColor, bool renderAnnot, int renderFlags) {
+        if (page == nullptr || targetSize(target) == 0) {
+            return false;
+        }
+        int width = target.width;
+        int height = target.height;
+        if (std::abs(deltaX) >= width || std::abs(deltaY) >= height) {
+            return renderStrip(page, target, 0, 0, width, height, startX, startY, drawSizeHor,
+                               drawSizeVer, backgroundColor, renderAnnot, renderFlags);
+        }
+
+        // Pixel (x, y) of the new frame is pixel (x - deltaX, y - deltaY) of the previous one.
+        // Rows are moved in the order which never overwrites a row that is still to be read.
+        int pixelBytes = bytesPerPixel(target.format);
+        int keptWidth = width - std::abs(deltaX);
+        int keptHeight = height - std::abs(deltaY);
+        int sourceLeft = std::max(0, -deltaX);
+        int destLeft = std::max(0, deltaX);
+        auto *pixels = (char *) target.pixels;
+        for (int i = 0; i < keptHeight; i++) {
+            int destRow = deltaY > 0 ? height - 1 - i : i;
+            int sourceRow = destRow - deltaY;
+            memmove(pixels + (size_t) destRow * target.stride + (size_t) destLeft * pixelBytes,
+                    pixels + (size_t) sourceRow * target.stride +
+                    (size_t) sourceLeft * pixelBytes,
+                    (size_t) keptWidth * pixelBytes);
+        }
+
+        // Exposed rows over the full width, then exposed columns beside the kept rows
+        bool rendered = true;
+        if (deltaY != 0) {
+            rendered &= renderStrip(page, target, 0, deltaY > 0 ? 0 : keptHeight, width,
+                                    std::abs(deltaY), startX, startY, drawSizeHor, drawSizeVer,
+                                    backgroundColor, renderAnnot, renderFlags);
+        }
+        if (deltaX != 0) {
+            rendered &= renderStrip(page, target, deltaX > 0 ? 0 : keptWidth,
+                                    std::max(0, deltaY), std::abs(deltaX), keptHeight, startX,
+                                    startY, drawSizeHor, drawSizeVer, backgroundColor,
+                                    renderAnnot, renderFlags);
+        }
+        return rendered;
+    }
+
+}
@@ -0,0 +1,88 @@
+#ifndef PAGE_RENDER_H_
+#define PAGE_RENDER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <fpdfview.h>
+
+namespace tools {
+
+    // Render options, mirrored by PdfDocument.PdfPage.RENDER_FLAG_*
+    enum {
+        // Ordered dither instead of truncation when reducing to RGB_565
+        RENDER_FLAG_DITHER = 0x1,
+        // Fast preview quality, no anti-aliasing and a small image cache. PdfDocument rejects
+        // it together with RENDER_FLAG_PRINT.
+        RENDER_FLAG_DRAFT = 0x2,
+        // Print quality, renders as pdfium does for printing
+        RENDER_FLAG_PRINT = 0x4,
+        // No background fill, targets with alpha receive the page on a transparent backdrop
+        // with premultiplied alpha, for callers which composite over their own background
+        RENDER_FLAG_TRANSPARENT = 0x8
+    };
+
+    // Pixel layouts of a render target, mirrored by PdfDocument.PdfPage.PIXEL_FORMAT_*. The
+    // name gives the order of the bytes in memory, RGB_565 is a native endian 16 bit value.
+    enum {
+        PIXEL_FORMAT_RGBA_8888 = 1,
+        PIXEL_FORMAT_BGRA_8888 = 2,
+        PIXEL_FORMAT_RGB_888 = 3,
+        PIXEL_FORMAT_BGR_888 = 4,
+        PIXEL_FORMAT_RGB_565 = 5,
+        PIXEL_FORMAT_GRAY_8 = 6
+    };
+
+    // Caller owned pixels a page is rendered into, independent of Bitmap, Surface and JNI
+    struct RenderTarget {
+        void *pixels;
+        int width;
+        int height;
+        int stride;
+        int format;
+    };
+
+    // 0 for an unknown format
+    int bytesPerPixel(int format);
+
+    // Bytes between the first and the past the end pixel, 0 if the target is not valid
+    size_t targetSize(const RenderTarget &target);
+
+    int pdfiumRenderFlags(bool renderAnnot, int renderFlags);
+
+    // The part of the target covered by the page, width or height is 0 or less if none is
+    void pageArea(const RenderTarget &target, int startX, int startY, int drawSizeHor,
+                  int drawSizeVer, int *left, int *top, int *width, int *height);
+
+    // Copy pixels of the size of dest into another format with the fastest kernel for the pair.
+    // Straight alpha is kept as it is. originX/originY are the page position of the first
+    // pixel and place the RENDER_FLAG_DITHER pattern. False if there is no conversion between
+    // the two.
+    bool convertPixels(const RenderTarget &source, const RenderTarget &dest, int renderFlags,
+                       int originX, int originY);
+
+    // Render the page area between startX/startY and drawSizeHor/drawSizeVer into the target.
+    // Every format except RGB_565 is rendered by pdfium in place, RGB_565 goes through a small
+    // band buffer. backgroundColor is ARGB, 0 leaves the target as it is outside of the page.
+    // With RENDER_FLAG_TRANSPARENT the page area of RGBA and BGRA targets is cleared instead.
+    bool renderPage(FPDF_PAGE page, const RenderTarget &target, int startX, int startY,
+                    int drawSizeHor, int drawSizeVer, uint32_t backgroundColor, bool renderAnnot,
+                    int renderFlags);
+
+    // Render the tile at tileLeft/tileTop of a page of pageSizeHor x pageSizeVer pixels. The
+    // tile never keeps pixels it held before, unless the background is opaque it starts out
+    // cleared, so a reused atlas slot and the cached copy of it hold only this tile.
+    bool renderTile(FPDF_PAGE page, const RenderTarget &tile, int tileLeft, int tileTop,
+                    int pageSizeHor, int pageSizeVer, uint32_t backgroundColor, bool renderAnnot,
+                    int renderFlags);
+
+    // Render the target after the page moved by deltaX/deltaY pixels since the previous frame,
+    // startX/startY are the new offsets. The still visible pixels are moved and only the
+    // exposed strips are cleared and rendered, the rest of the target must hold the previous
+    // frame rendered with the same size and options.
+    bool scrollPage(FPDF_PAGE page, const RenderTarget &target, int deltaX, int deltaY,
+                    int startX, int startY, int drawSizeHor, int drawSizeVer,
+                    uint32_t backgroundColor, bool renderAnnot, int renderFlags);
+
+}
+#endif /* PAGE_RENDER_H_ */
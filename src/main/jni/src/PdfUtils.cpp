@@ -23,17 +23,6 @@
 namespace tools {
     static int sUnmatchedPdfiumInitRequestCount = 0;
 
-    int getBlock(void *param, unsigned long position, unsigned char *outBuffer,
-                 unsigned long size) {
-        const int fd = reinterpret_cast<intptr_t>(param);
-        const int readCount = pread(fd, outBuffer, size, position);
-        if (readCount < 0) {
-            LOGE("Cannot read from file descriptor. Error:%d", errno);
-            return 0;
-        }
-        return 1;
-    }
-
 // Check if the last pdfium command failed and if so, forward the error to java via an exception. If
 // this function returns true an exception is pending.
     bool forwardPdfiumError(JNIEnv *env) {
@@ -22,9 +22,6 @@
 
 
 namespace tools {
-    int getBlock(void *param, unsigned long position, unsigned char *outBuffer,
-                 unsigned long size);
-
     bool forwardPdfiumError(JNIEnv *env);
 
 #define HANDLE_PDFIUM_ERROR_STATE(env)                         \
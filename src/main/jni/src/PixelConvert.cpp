@@ -0,0 +1,625 @@
+#include "PixelConvert.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <tmmintrin.h>
+#endif
+
+#if defined(__ANDROID__) && (defined(__arm__) || defined(__i386__) || defined(__x86_64__))
+#include <cpu-features.h>
+#define HAVE_CPU_FEATURES
+#endif
+
+namespace tools {
+
+    static inline uint16_t packRgb565(uint8_t red, uint8_t green, uint8_t blue) {
+        return (uint16_t) (((red >> 3) << 11) | ((green >> 2) << 5) | (blue >> 3));
+    }
+
+    // Bayer matrix 0..15 scaled to 0..7 and 0..3
+    const uint8_t kDitherRedBlue[4][20] = {
+            {0, 4, 1, 5, 0, 4, 1, 5, 0, 4, 1, 5, 0, 4, 1, 5, 0, 4, 1, 5},
+            {6, 2, 7, 3, 6, 2, 7, 3, 6, 2, 7, 3, 6, 2, 7, 3, 6, 2, 7, 3},
+            {1, 5, 0, 4, 1, 5, 0, 4, 1, 5, 0, 4, 1, 5, 0, 4, 1, 5, 0, 4},
+            {7, 3, 6, 2, 7, 3, 6, 2, 7, 3, 6, 2, 7, 3, 6, 2, 7, 3, 6, 2}};
+    const uint8_t kDitherGreen[4][20] = {
+            {0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2},
+            {3, 1, 3, 1, 3, 1, 3, 1, 3, 1, 3, 1, 3, 1, 3, 1, 3, 1, 3, 1},
+            {0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2, 0, 2},
+            {3, 1, 3, 1, 3, 1, 3, 1, 3, 1, 3, 1, 3, 1, 3, 1, 3, 1, 3, 1}};
+
+    static inline uint8_t addSaturated(uint8_t value, uint8_t offset) {
+        return (uint8_t) (value + offset > 255 ? 255 : value + offset);
+    }
+
+    void rgb24To565Row_scalar(const uint8_t *source, uint16_t *dest, int width) {
+        for (int x = 0; x < width; x++) {
+            dest[x] = packRgb565(source[0], source[1], source[2]);
+            source += 3;
+        }
+    }
+
+    void rgb24To565DitherRow_scalar(const uint8_t *source, uint16_t *dest, int width, int x,
+                                    int y) {
+        const uint8_t *redBlue = kDitherRedBlue[y & 3];
+        const uint8_t *green = kDitherGreen[y & 3];
+        for (int i = 0; i < width; i++) {
+            int phase = (x + i) & 3;
+            dest[i] = packRgb565(addSaturated(source[0], redBlue[phase]),
+                                 addSaturated(source[1], green[phase]),
+                                 addSaturated(source[2], redBlue[phase]));
+            source += 3;
+        }
+    }
+
+    void swapRedBlueRow_scalar(const uint8_t *source, uint8_t *dest, int width) {
+        for (int x = 0; x < width; x++) {
+            uint8_t first = source[0];
+            dest[0] = source[2];
+            dest[1] = source[1];
+            dest[2] = first;
+            dest[3] = source[3];
+            source += 4;
+            dest += 4;
+        }
+    }
+
+    void bgraTo565Row_scalar(const uint8_t *source, uint16_t *dest, int width) {
+        for (int x = 0; x < width; x++) {
+            dest[x] = packRgb565(source[2], source[1], source[0]);
+            source += 4;
+        }
+    }
+
+    void bgraTo565DitherRow_scalar(const uint8_t *source, uint16_t *dest, int width, int x, int y) {
+        const uint8_t *redBlue = kDitherRedBlue[y & 3];
+        const uint8_t *green = kDitherGreen[y & 3];
+        for (int i = 0; i < width; i++) {
+            int phase = (x + i) & 3;
+            dest[i] = packRgb565(addSaturated(source[2], redBlue[phase]),
+                                 addSaturated(source[1], green[phase]),
+                                 addSaturated(source[0], redBlue[phase]));
+            source += 4;
+        }
+    }
+
+    // 7 bit BT.601 weights, small enough for signed 8 bit vector multipliers
+    enum {
+        LUMA_RED = 38,
+        LUMA_GREEN = 75,
+        LUMA_BLUE = 15
+    };
+
+    void bgraToGray8Row_scalar(const uint8_t *source, uint8_t *dest, int width) {
+        for (int x = 0; x < width; x++) {
+            dest[x] = (uint8_t) ((source[2] * LUMA_RED + source[1] * LUMA_GREEN +
+                                  source[0] * LUMA_BLUE + 64) >> 7);
+            source += 4;
+        }
+    }
+
+    // value * alpha / 255 rounded, exact for all 8 bit inputs without a division
+    static inline uint8_t multiplyAlpha(uint8_t value, uint8_t alpha) {
+        uint32_t product = value * alpha + 128;
+        return (uint8_t) ((product + (product >> 8)) >> 8);
+    }
+
+    void premultiplyRow_scalar(const uint8_t *source, uint8_t *dest, int width) {
+        for (int x = 0; x < width; x++) {
+            uint8_t alpha = source[3];
+            dest[0] = multiplyAlpha(source[0], alpha);
+            dest[1] = multiplyAlpha(source[1], alpha);
+            dest[2] = multiplyAlpha(source[2], alpha);
+            dest[3] = alpha;
+            source += 4;
+            dest += 4;
+        }
+    }
+
+    // 255 / alpha in 16.16 fixed point
+    struct UnpremultiplyTable {
+        uint32_t scale[256];
+
+        UnpremultiplyTable() {
+            scale[0] = 0;
+            for (uint32_t alpha = 1; alpha < 256; alpha++) {
+                scale[alpha] = (255u * 65536u + alpha / 2) / alpha;
+            }
+        }
+    };
+
+    static const UnpremultiplyTable kUnpremultiply;
+
+    static inline uint8_t divideAlpha(uint8_t value, uint32_t scale) {
+        uint32_t result = (value * scale + 32768) >> 16;
+        return (uint8_t) (result > 255 ? 255 : result);
+    }
+
+    void unpremultiplyRow_scalar(const uint8_t *source, uint8_t *dest, int width) {
+        for (int x = 0; x < width; x++) {
+            uint8_t alpha = source[3];
+            uint32_t scale = kUnpremultiply.scale[alpha];
+            dest[0] = divideAlpha(source[0], scale);
+            dest[1] = divideAlpha(source[1], scale);
+            dest[2] = divideAlpha(source[2], scale);
+            dest[3] = alpha;
+            source += 4;
+            dest += 4;
+        }
+    }
+
+    void bgraToRgb24Row_scalar(const uint8_t *source, uint8_t *dest, int width) {
+        for (int x = 0; x < width; x++) {
+            dest[0] = source[2];
+            dest[1] = source[1];
+            dest[2] = source[0];
+            source += 4;
+            dest += 3;
+        }
+    }
+
+    void rgbaToRgb24Row_scalar(const uint8_t *source, uint8_t *dest, int width) {
+        for (int x = 0; x < width; x++) {
+            dest[0] = source[0];
+            dest[1] = source[1];
+            dest[2] = source[2];
+            source += 4;
+            dest += 3;
+        }
+    }
+
+    static inline uint8_t average(uint8_t a, uint8_t b) {
+        return (uint8_t) ((a + b + 1) >> 1);
+    }
+
+    void downsample2xRow_scalar(const uint8_t *top, const uint8_t *bottom, uint8_t *dest,
+                                int destWidth) {
+        for (int x = 0; x < destWidth; x++) {
+            for (int channel = 0; channel < 4; channel++) {
+                dest[channel] = average(average(top[channel], bottom[channel]),
+                                        average(top[channel + 4], bottom[channel + 4]));
+            }
+            top += 8;
+            bottom += 8;
+            dest += 4;
+        }
+    }
+
+#if defined(__i386__) || defined(__x86_64__)
+
+    // Shuffle masks gathering one channel of 16 packed RGB pixels out of three 16 byte loads,
+    // -1 clears the lane so the three partial results can be or-ed together.
+    static const int8_t kShuffleRed[3][16] = {
+            {0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+            {-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1},
+            {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13}};
+    static const int8_t kShuffleGreen[3][16] = {
+            {1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+            {-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1},
+            {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14}};
+    static const int8_t kShuffleBlue[3][16] = {
+            {2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+            {-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1},
+            {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15}};
+
+    __attribute__((target("ssse3")))
+    static inline __m128i gatherChannel(__m128i a, __m128i b, __m128i c,
+                                        const int8_t (*mask)[16]) {
+        __m128i channel = _mm_shuffle_epi8(a, _mm_loadu_si128((const __m128i *) mask[0]));
+        channel = _mm_or_si128(channel,
+                               _mm_shuffle_epi8(b, _mm_loadu_si128((const __m128i *) mask[1])));
+        return _mm_or_si128(channel,
+                            _mm_shuffle_epi8(c, _mm_loadu_si128((const __m128i *) mask[2])));
+    }
+
+    __attribute__((target("ssse3")))
+    static inline __m128i pack565(__m128i red, __m128i green, __m128i blue) {
+        const __m128i zero = _mm_setzero_si128();
+        // Placing a channel in the high byte of a 16 bit lane shifts it left by 8 for free
+        __m128i r = _mm_and_si128(_mm_unpacklo_epi8(zero, red), _mm_set1_epi16((short) 0xF800));
+        __m128i g = _mm_srli_epi16(
+                _mm_and_si128(_mm_unpacklo_epi8(zero, green), _mm_set1_epi16((short) 0xFC00)), 5);
+        __m128i b = _mm_srli_epi16(_mm_unpacklo_epi8(zero, blue), 11);
+        return _mm_or_si128(_mm_or_si128(r, g), b);
+    }
+
+    __attribute__((target("ssse3")))
+    void rgb24To565Row_ssse3(const uint8_t *source, uint16_t *dest, int width) {
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            __m128i a = _mm_loadu_si128((const __m128i *) source);
+            __m128i b = _mm_loadu_si128((const __m128i *) (source + 16));
+            __m128i c = _mm_loadu_si128((const __m128i *) (source + 32));
+            __m128i red = gatherChannel(a, b, c, kShuffleRed);
+            __m128i green = gatherChannel(a, b, c, kShuffleGreen);
+            __m128i blue = gatherChannel(a, b, c, kShuffleBlue);
+            _mm_storeu_si128((__m128i *) (dest + x), pack565(red, green, blue));
+            _mm_storeu_si128((__m128i *) (dest + x + 8),
+                             pack565(_mm_srli_si128(red, 8), _mm_srli_si128(green, 8),
+                                     _mm_srli_si128(blue, 8)));
+            source += 48;
+        }
+        rgb24To565Row_scalar(source, dest + x, width - x);
+    }
+
+    __attribute__((target("ssse3")))
+    void rgb24To565DitherRow_ssse3(const uint8_t *source, uint16_t *dest, int width,
+                                   int originX, int y) {
+        const __m128i redBlueOffset = _mm_loadu_si128(
+                (const __m128i *) (kDitherRedBlue[y & 3] + (originX & 3)));
+        const __m128i greenOffset = _mm_loadu_si128(
+                (const __m128i *) (kDitherGreen[y & 3] + (originX & 3)));
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            __m128i a = _mm_loadu_si128((const __m128i *) source);
+            __m128i b = _mm_loadu_si128((const __m128i *) (source + 16));
+            __m128i c = _mm_loadu_si128((const __m128i *) (source + 32));
+            __m128i red = _mm_adds_epu8(gatherChannel(a, b, c, kShuffleRed), redBlueOffset);
+            __m128i green = _mm_adds_epu8(gatherChannel(a, b, c, kShuffleGreen), greenOffset);
+            __m128i blue = _mm_adds_epu8(gatherChannel(a, b, c, kShuffleBlue), redBlueOffset);
+            _mm_storeu_si128((__m128i *) (dest + x), pack565(red, green, blue));
+            _mm_storeu_si128((__m128i *) (dest + x + 8),
+                             pack565(_mm_srli_si128(red, 8), _mm_srli_si128(green, 8),
+                                     _mm_srli_si128(blue, 8)));
+            source += 48;
+        }
+        rgb24To565DitherRow_scalar(source, dest + x, width - x, originX + x, y);
+    }
+
+    static const int8_t kShuffleSwapRedBlue[16] = {2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13,
+                                                   12, 15};
+    // Low half of every 32 bit lane into the low 8 bytes
+    static const int8_t kShufflePack32To16[16] = {0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1,
+                                                  -1, -1, -1};
+    // Alpha of the two pixels in the low (or high) 8 bytes, widened to every 16 bit lane
+    static const int8_t kShuffleAlphaLow[16] = {3, -1, 3, -1, 3, -1, 3, -1, 7, -1, 7, -1, 7, -1,
+                                                7, -1};
+    static const int8_t kShuffleAlphaHigh[16] = {11, -1, 11, -1, 11, -1, 11, -1, 15, -1, 15, -1,
+                                                 15, -1, 15, -1};
+    // Four pixels packed to 12 bytes in R, G, B order
+    static const int8_t kShuffleBgraToRgb24[16] = {2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1,
+                                                   -1, -1, -1};
+    static const int8_t kShuffleRgbaToRgb24[16] = {0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1,
+                                                   -1, -1, -1};
+    static const int8_t kLumaWeights[16] = {LUMA_BLUE, LUMA_GREEN, LUMA_RED, 0, LUMA_BLUE,
+                                            LUMA_GREEN, LUMA_RED, 0, LUMA_BLUE, LUMA_GREEN,
+                                            LUMA_RED, 0, LUMA_BLUE, LUMA_GREEN, LUMA_RED, 0};
+
+    __attribute__((target("ssse3")))
+    void swapRedBlueRow_ssse3(const uint8_t *source, uint8_t *dest, int width) {
+        const __m128i mask = _mm_loadu_si128((const __m128i *) kShuffleSwapRedBlue);
+        int x = 0;
+        for (; x + 4 <= width; x += 4) {
+            __m128i pixels = _mm_loadu_si128((const __m128i *) (source + x * 4));
+            _mm_storeu_si128((__m128i *) (dest + x * 4), _mm_shuffle_epi8(pixels, mask));
+        }
+        swapRedBlueRow_scalar(source + x * 4, dest + x * 4, width - x);
+    }
+
+    // Four BGRA pixels to RGB_565 in the low 8 bytes
+    __attribute__((target("ssse3")))
+    static inline __m128i packBgra565(__m128i pixels, __m128i packMask) {
+        __m128i red = _mm_and_si128(_mm_srli_epi32(pixels, 8), _mm_set1_epi32(0xF800));
+        __m128i green = _mm_and_si128(_mm_srli_epi32(pixels, 5), _mm_set1_epi32(0x07E0));
+        __m128i blue = _mm_and_si128(_mm_srli_epi32(pixels, 3), _mm_set1_epi32(0x001F));
+        return _mm_shuffle_epi8(_mm_or_si128(_mm_or_si128(red, green), blue), packMask);
+    }
+
+    __attribute__((target("ssse3")))
+    void bgraTo565Row_ssse3(const uint8_t *source, uint16_t *dest, int width) {
+        const __m128i packMask = _mm_loadu_si128((const __m128i *) kShufflePack32To16);
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            __m128i low = packBgra565(_mm_loadu_si128((const __m128i *) (source + x * 4)),
+                                      packMask);
+            __m128i high = packBgra565(_mm_loadu_si128((const __m128i *) (source + x * 4 + 16)),
+                                       packMask);
+            _mm_storeu_si128((__m128i *) (dest + x), _mm_unpacklo_epi64(low, high));
+        }
+        bgraTo565Row_scalar(source + x * 4, dest + x, width - x);
+    }
+
+    __attribute__((target("ssse3")))
+    void bgraTo565DitherRow_ssse3(const uint8_t *source, uint16_t *dest, int width,
+                                  int originX, int y) {
+        const __m128i packMask = _mm_loadu_si128((const __m128i *) kShufflePack32To16);
+        // The pattern repeats every four pixels, one vector of offsets covers four BGRA pixels
+        uint8_t offsets[16];
+        for (int i = 0; i < 4; i++) {
+            int phase = (originX + i) & 3;
+            offsets[i * 4] = kDitherRedBlue[y & 3][phase];
+            offsets[i * 4 + 1] = kDitherGreen[y & 3][phase];
+            offsets[i * 4 + 2] = kDitherRedBlue[y & 3][phase];
+            offsets[i * 4 + 3] = 0;
+        }
+        const __m128i offset = _mm_loadu_si128((const __m128i *) offsets);
+        int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            __m128i low = _mm_adds_epu8(_mm_loadu_si128((const __m128i *) (source + x * 4)),
+                                        offset);
+            __m128i high = _mm_adds_epu8(
+                    _mm_loadu_si128((const __m128i *) (source + x * 4 + 16)), offset);
+            _mm_storeu_si128((__m128i *) (dest + x),
+                             _mm_unpacklo_epi64(packBgra565(low, packMask),
+                                                packBgra565(high, packMask)));
+        }
+        bgraTo565DitherRow_scalar(source + x * 4, dest + x, width - x, originX + x, y);
+    }
+
+    __attribute__((target("ssse3")))
+    void bgraToGray8Row_ssse3(const uint8_t *source, uint8_t *dest, int width) {
+        const __m128i weights = _mm_loadu_si128((const __m128i *) kLumaWeights);
+        const __m128i rounding = _mm_set1_epi16(64);
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            const uint8_t *pixels = source + x * 4;
+            // Pairs of weighted channels, B + G and R + A, then one sum per pixel
+            __m128i a = _mm_maddubs_epi16(_mm_loadu_si128((const __m128i *) pixels), weights);
+            __m128i b = _mm_maddubs_epi16(_mm_loadu_si128((const __m128i *) (pixels + 16)),
+                                          weights);
+            __m128i c = _mm_maddubs_epi16(_mm_loadu_si128((const __m128i *) (pixels + 32)),
+                                          weights);
+            __m128i d = _mm_maddubs_epi16(_mm_loadu_si128((const __m128i *) (pixels + 48)),
+                                          weights);
+            __m128i low = _mm_srli_epi16(_mm_add_epi16(_mm_hadd_epi16(a, b), rounding), 7);
+            __m128i high = _mm_srli_epi16(_mm_add_epi16(_mm_hadd_epi16(c, d), rounding), 7);
+            _mm_storeu_si128((__m128i *) (dest + x), _mm_packus_epi16(low, high));
+        }
+        bgraToGray8Row_scalar(source + x * 4, dest + x, width - x);
+    }
+
+    __attribute__((target("ssse3")))
+    static inline __m128i multiplyAlphaLanes(__m128i values, __m128i alpha) {
+        __m128i product = _mm_add_epi16(_mm_mullo_epi16(values, alpha), _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+    }
+
+    __attribute__((target("ssse3")))
+    void premultiplyRow_ssse3(const uint8_t *source, uint8_t *dest, int width) {
+        const __m128i alphaLow = _mm_loadu_si128((const __m128i *) kShuffleAlphaLow);
+        const __m128i alphaHigh = _mm_loadu_si128((const __m128i *) kShuffleAlphaHigh);
+        const __m128i alphaMask = _mm_set1_epi32((int) 0xFF000000);
+        const __m128i zero = _mm_setzero_si128();
+        int x = 0;
+        for (; x + 4 <= width; x += 4) {
+            __m128i pixels = _mm_loadu_si128((const __m128i *) (source + x * 4));
+            __m128i low = multiplyAlphaLanes(_mm_unpacklo_epi8(pixels, zero),
+                                        _mm_shuffle_epi8(pixels, alphaLow));
+            __m128i high = multiplyAlphaLanes(_mm_unpackhi_epi8(pixels, zero),
+                                         _mm_shuffle_epi8(pixels, alphaHigh));
+            __m128i color = _mm_andnot_si128(alphaMask, _mm_packus_epi16(low, high));
+            _mm_storeu_si128((__m128i *) (dest + x * 4),
+                             _mm_or_si128(color, _mm_and_si128(pixels, alphaMask)));
+        }
+        premultiplyRow_scalar(source + x * 4, dest + x * 4, width - x);
+    }
+
+    // Sixteen pixels to 48 bytes, each load is shuffled to 12 bytes and the four are stitched
+    __attribute__((target("ssse3")))
+    static inline void packRgb24(const uint8_t *source, uint8_t *dest, __m128i mask) {
+        __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) source), mask);
+        __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (source + 16)), mask);
+        __m128i c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (source + 32)), mask);
+        __m128i d = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (source + 48)), mask);
+        _mm_storeu_si128((__m128i *) dest, _mm_or_si128(a, _mm_slli_si128(b, 12)));
+        _mm_storeu_si128((__m128i *) (dest + 16),
+                         _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+        _mm_storeu_si128((__m128i *) (dest + 32),
+                         _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+    }
+
+    __attribute__((target("ssse3")))
+    void bgraToRgb24Row_ssse3(const uint8_t *source, uint8_t *dest, int width) {
+        const __m128i mask = _mm_loadu_si128((const __m128i *) kShuffleBgraToRgb24);
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            packRgb24(source + x * 4, dest + x * 3, mask);
+        }
+        bgraToRgb24Row_scalar(source + x * 4, dest + x * 3, width - x);
+    }
+
+    __attribute__((target("ssse3")))
+    void rgbaToRgb24Row_ssse3(const uint8_t *source, uint8_t *dest, int width) {
+        const __m128i mask = _mm_loadu_si128((const __m128i *) kShuffleRgbaToRgb24);
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            packRgb24(source + x * 4, dest + x * 3, mask);
+        }
+        rgbaToRgb24Row_scalar(source + x * 4, dest + x * 3, width - x);
+    }
+
+    __attribute__((target("ssse3")))
+    void downsample2xRow_ssse3(const uint8_t *top, const uint8_t *bottom, uint8_t *dest,
+                               int destWidth) {
+        int x = 0;
+        for (; x + 4 <= destWidth; x += 4) {
+            const uint8_t *topPixels = top + x * 8;
+            const uint8_t *bottomPixels = bottom + x * 8;
+            __m128i left = _mm_avg_epu8(_mm_loadu_si128((const __m128i *) topPixels),
+                                        _mm_loadu_si128((const __m128i *) bottomPixels));
+            __m128i right = _mm_avg_epu8(_mm_loadu_si128((const __m128i *) (topPixels + 16)),
+                                         _mm_loadu_si128((const __m128i *) (bottomPixels + 16)));
+            // Separate even and odd pixels of the eight, then average the pairs
+            __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(left), _mm_castsi128_ps(right),
+                                         _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(left), _mm_castsi128_ps(right),
+                                        _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_si128((__m128i *) (dest + x * 4),
+                             _mm_avg_epu8(_mm_castps_si128(even), _mm_castps_si128(odd)));
+        }
+        downsample2xRow_scalar(top + x * 8, bottom + x * 8, dest + x * 4, destWidth - x);
+    }
+
+#endif
+
+#if defined(__aarch64__)
+#define SELECT_KERNEL(name) return &name##_neon;
+#elif defined(__arm__) && defined(HAVE_CPU_FEATURES)
+#define SELECT_KERNEL(name)                                              \
+        if (android_getCpuFeatures() & ANDROID_CPU_ARM_FEATURE_NEON) {   \
+            return &name##_neon;                                         \
+        }                                                                \
+        return &name##_scalar;
+#elif (defined(__i386__) || defined(__x86_64__)) && defined(HAVE_CPU_FEATURES)
+#define SELECT_KERNEL(name)                                              \
+        if (android_getCpuFeatures() & ANDROID_CPU_X86_FEATURE_SSSE3) {  \
+            return &name##_ssse3;                                        \
+        }                                                                \
+        return &name##_scalar;
+#elif defined(__i386__) || defined(__x86_64__)
+#define SELECT_KERNEL(name)                                              \
+        if (__builtin_cpu_supports("ssse3")) {                           \
+            return &name##_ssse3;                                        \
+        }                                                                \
+        return &name##_scalar;
+#else
+#define SELECT_KERNEL(name) return &name##_scalar;
+#endif
+
+    static Rgb24To565Row selectRgb24To565Row() {
+        SELECT_KERNEL(rgb24To565Row)
+    }
+
+    static Rgb24To565DitherRow selectRgb24To565DitherRow() {
+        SELECT_KERNEL(rgb24To565DitherRow)
+    }
+
+    static Pixel32Row selectSwapRedBlueRow() {
+        SELECT_KERNEL(swapRedBlueRow)
+    }
+
+    static Rgb24To565Row selectBgraTo565Row() {
+        SELECT_KERNEL(bgraTo565Row)
+    }
+
+    static Rgb24To565DitherRow selectBgraTo565DitherRow() {
+        SELECT_KERNEL(bgraTo565DitherRow)
+    }
+
+    static Pixel32Row selectBgraToGray8Row() {
+        SELECT_KERNEL(bgraToGray8Row)
+    }
+
+    static Pixel32Row selectPremultiplyRow() {
+        SELECT_KERNEL(premultiplyRow)
+    }
+
+    static Pixel32Row selectBgraToRgb24Row() {
+        SELECT_KERNEL(bgraToRgb24Row)
+    }
+
+    static Pixel32Row selectRgbaToRgb24Row() {
+        SELECT_KERNEL(rgbaToRgb24Row)
+    }
+
+    static Downsample2xRow selectDownsample2xRow() {
+        SELECT_KERNEL(downsample2xRow)
+    }
+
+    static void convertRows(Pixel32Row convertRow, const void *source, int sourceStride,
+                            void *dest, int destStride, int width, int height) {
+        auto *src = (const uint8_t *) source;
+        auto *dst = (uint8_t *) dest;
+        for (int y = 0; y < height; y++) {
+            convertRow(src, dst, width);
+            src += sourceStride;
+            dst += destStride;
+        }
+    }
+
+    void rgb24To565(const void *source, int sourceStride, void *dest, int destStride, int width,
+                    int height) {
+        static const Rgb24To565Row convertRow = selectRgb24To565Row();
+        auto *src = (const uint8_t *) source;
+        auto *dst = (uint8_t *) dest;
+        for (int y = 0; y < height; y++) {
+            convertRow(src, (uint16_t *) dst, width);
+            src += sourceStride;
+            dst += destStride;
+        }
+    }
+
+    void rgb24To565Dither(const void *source, int sourceStride, void *dest, int destStride,
+                          int width, int height, int originX, int originY) {
+        static const Rgb24To565DitherRow convertRow = selectRgb24To565DitherRow();
+        auto *src = (const uint8_t *) source;
+        auto *dst = (uint8_t *) dest;
+        for (int y = 0; y < height; y++) {
+            convertRow(src, (uint16_t *) dst, width, originX, originY + y);
+            src += sourceStride;
+            dst += destStride;
+        }
+    }
+
+    void swapRedBlue(const void *source, int sourceStride, void *dest, int destStride, int width,
+                     int height) {
+        static const Pixel32Row convertRow = selectSwapRedBlueRow();
+        convertRows(convertRow, source, sourceStride, dest, destStride, width, height);
+    }
+
+    void bgraTo565(const void *source, int sourceStride, void *dest, int destStride, int width,
+                   int height) {
+        static const Rgb24To565Row convertRow = selectBgraTo565Row();
+        auto *src = (const uint8_t *) source;
+        auto *dst = (uint8_t *) dest;
+        for (int y = 0; y < height; y++) {
+            convertRow(src, (uint16_t *) dst, width);
+            src += sourceStride;
+            dst += destStride;
+        }
+    }
+
+    void bgraTo565Dither(const void *source, int sourceStride, void *dest, int destStride,
+                         int width, int height, int originX, int originY) {
+        static const Rgb24To565DitherRow convertRow = selectBgraTo565DitherRow();
+        auto *src = (const uint8_t *) source;
+        auto *dst = (uint8_t *) dest;
+        for (int y = 0; y < height; y++) {
+            convertRow(src, (uint16_t *) dst, width, originX, originY + y);
+            src += sourceStride;
+            dst += destStride;
+        }
+    }
+
+    void bgraToGray8(const void *source, int sourceStride, void *dest, int destStride, int width,
+                     int height) {
+        static const Pixel32Row convertRow = selectBgraToGray8Row();
+        convertRows(convertRow, source, sourceStride, dest, destStride, width, height);
+    }
+
+    void premultiply(const void *source, int sourceStride, void *dest, int destStride, int width,
+                     int height) {
+        static const Pixel32Row convertRow = selectPremultiplyRow();
+        convertRows(convertRow, source, sourceStride, dest, destStride, width, height);
+    }
+
+    void unpremultiply(const void *source, int sourceStride, void *dest, int destStride,
+                       int width, int height) {
+        convertRows(&unpremultiplyRow_scalar, source, sourceStride, dest, destStride, width,
+                    height);
+    }
+
+    void bgraToRgb24(const void *source, int sourceStride, void *dest, int destStride, int width,
+                     int height) {
+        static const Pixel32Row convertRow = selectBgraToRgb24Row();
+        convertRows(convertRow, source, sourceStride, dest, destStride, width, height);
+    }
+
+    void rgbaToRgb24(const void *source, int sourceStride, void *dest, int destStride, int width,
+                     int height) {
+        static const Pixel32Row convertRow = selectRgbaToRgb24Row();
+        convertRows(convertRow, source, sourceStride, dest, destStride, width, height);
+    }
+
+    void downsample2x(const void *source, int sourceStride, void *dest, int destStride,
+                      int destWidth, int destHeight) {
+        static const Downsample2xRow downsampleRow = selectDownsample2xRow();
+        auto *src = (const uint8_t *) source;
+        auto *dst = (uint8_t *) dest;
+        for (int y = 0; y < destHeight; y++) {
+            downsampleRow(src, src + sourceStride, dst, destWidth);
+            src += sourceStride * 2;
+            dst += destStride;
+        }
+    }
+
+}
@@ -0,0 +1,147 @@
+#ifndef PIXEL_CONVERT_H_
+#define PIXEL_CONVERT_H_
+
+#include <stdint.h>
+
+namespace tools {
+
+    // Pixel conversions for render outputs. Every kernel converts one row; the vector variants
+    // are picked once per process from the features of the running CPU.
+
+    // Three bytes per pixel in R, G, B memory order, as pdfium writes FPDFBitmap_BGR with
+    // FPDF_REVERSE_BYTE_ORDER.
+    typedef void (*Rgb24To565Row)(const uint8_t *source, uint16_t *dest, int width);
+
+    // Same as Rgb24To565Row with a 4x4 ordered (Bayer) dither instead of truncation. x and y are
+    // the position of the first pixel on the page and select the phase of the pattern, so
+    // pixels rendered apart from each other still line up to one pattern.
+    typedef void (*Rgb24To565DitherRow)(const uint8_t *source, uint16_t *dest, int width, int x,
+                                        int y);
+
+    // Four bytes per source pixel with alpha last, BGRA is the native pdfium order. The 565
+    // kernels of BGRA sources share the Rgb24To565Row and Rgb24To565DitherRow signatures.
+    typedef void (*Pixel32Row)(const uint8_t *source, uint8_t *dest, int width);
+
+    void rgb24To565Row_scalar(const uint8_t *source, uint16_t *dest, int width);
+
+    void rgb24To565DitherRow_scalar(const uint8_t *source, uint16_t *dest, int width, int x, int y);
+
+    // BGRA <-> RGBA, source and dest may be the same
+    void swapRedBlueRow_scalar(const uint8_t *source, uint8_t *dest, int width);
+
+    void bgraTo565Row_scalar(const uint8_t *source, uint16_t *dest, int width);
+
+    void bgraTo565DitherRow_scalar(const uint8_t *source, uint16_t *dest, int width, int x, int y);
+
+    // Luma (R * 38 + G * 75 + B * 15) / 128, rounded
+    void bgraToGray8Row_scalar(const uint8_t *source, uint8_t *dest, int width);
+
+    // Straight to premultiplied alpha and back, for either byte order
+    void premultiplyRow_scalar(const uint8_t *source, uint8_t *dest, int width);
+
+    void unpremultiplyRow_scalar(const uint8_t *source, uint8_t *dest, int width);
+
+    // Drop alpha and pack to three bytes in R, G, B memory order
+    void bgraToRgb24Row_scalar(const uint8_t *source, uint8_t *dest, int width);
+
+    void rgbaToRgb24Row_scalar(const uint8_t *source, uint8_t *dest, int width);
+
+    // Halve four byte pixels in both directions, each dest pixel is the box average of two
+    // columns of the top and the bottom row. Columns are averaged first, then the pair, both
+    // rounding up as the vector averaging instructions do.
+    typedef void (*Downsample2xRow)(const uint8_t *top, const uint8_t *bottom, uint8_t *dest,
+                                    int destWidth);
+
+    void downsample2xRow_scalar(const uint8_t *top, const uint8_t *bottom, uint8_t *dest,
+                                int destWidth);
+
+#if defined(__i386__) || defined(__x86_64__)
+    void rgb24To565Row_ssse3(const uint8_t *source, uint16_t *dest, int width);
+
+    void rgb24To565DitherRow_ssse3(const uint8_t *source, uint16_t *dest, int width, int x, int y);
+
+    void swapRedBlueRow_ssse3(const uint8_t *source, uint8_t *dest, int width);
+
+    void bgraTo565Row_ssse3(const uint8_t *source, uint16_t *dest, int width);
+
+    void bgraTo565DitherRow_ssse3(const uint8_t *source, uint16_t *dest, int width, int x, int y);
+
+    void bgraToGray8Row_ssse3(const uint8_t *source, uint8_t *dest, int width);
+
+    void premultiplyRow_ssse3(const uint8_t *source, uint8_t *dest, int width);
+
+    void bgraToRgb24Row_ssse3(const uint8_t *source, uint8_t *dest, int width);
+
+    void rgbaToRgb24Row_ssse3(const uint8_t *source, uint8_t *dest, int width);
+
+    void downsample2xRow_ssse3(const uint8_t *top, const uint8_t *bottom, uint8_t *dest,
+                               int destWidth);
+#endif
+
+#if defined(__arm__) || defined(__aarch64__)
+    void rgb24To565Row_neon(const uint8_t *source, uint16_t *dest, int width);
+
+    void rgb24To565DitherRow_neon(const uint8_t *source, uint16_t *dest, int width, int x, int y);
+
+    void swapRedBlueRow_neon(const uint8_t *source, uint8_t *dest, int width);
+
+    void bgraTo565Row_neon(const uint8_t *source, uint16_t *dest, int width);
+
+    void bgraTo565DitherRow_neon(const uint8_t *source, uint16_t *dest, int width, int x, int y);
+
+    void bgraToGray8Row_neon(const uint8_t *source, uint8_t *dest, int width);
+
+    void premultiplyRow_neon(const uint8_t *source, uint8_t *dest, int width);
+
+    void bgraToRgb24Row_neon(const uint8_t *source, uint8_t *dest, int width);
+
+    void rgbaToRgb24Row_neon(const uint8_t *source, uint8_t *dest, int width);
+
+    void downsample2xRow_neon(const uint8_t *top, const uint8_t *bottom, uint8_t *dest,
+                              int destWidth);
+#endif
+
+    // Threshold offsets of the 4x4 Bayer matrix for the 3 dropped bits of red and blue and the
+    // 2 dropped bits of green, repeated to 20 pixels so a vector register can be loaded from
+    // any of the four phases of a row.
+    extern const uint8_t kDitherRedBlue[4][20];
+    extern const uint8_t kDitherGreen[4][20];
+
+    void rgb24To565(const void *source, int sourceStride, void *dest, int destStride, int width,
+                    int height);
+
+    // originX/originY are the page position of the first source pixel
+    void rgb24To565Dither(const void *source, int sourceStride, void *dest, int destStride,
+                          int width, int height, int originX, int originY);
+
+    void swapRedBlue(const void *source, int sourceStride, void *dest, int destStride, int width,
+                     int height);
+
+    void bgraTo565(const void *source, int sourceStride, void *dest, int destStride, int width,
+                   int height);
+
+    void bgraTo565Dither(const void *source, int sourceStride, void *dest, int destStride,
+                         int width, int height, int originX, int originY);
+
+    void bgraToGray8(const void *source, int sourceStride, void *dest, int destStride, int width,
+                     int height);
+
+    void premultiply(const void *source, int sourceStride, void *dest, int destStride, int width,
+                     int height);
+
+    // Divides per pixel through a reciprocal table and has no vector variant
+    void unpremultiply(const void *source, int sourceStride, void *dest, int destStride,
+                       int width, int height);
+
+    void bgraToRgb24(const void *source, int sourceStride, void *dest, int destStride, int width,
+                     int height);
+
+    void rgbaToRgb24(const void *source, int sourceStride, void *dest, int destStride, int width,
+                     int height);
+
+    // destWidth and destHeight are the halved sizes, an odd last source row or column is dropped
+    void downsample2x(const void *source, int sourceStride, void *dest, int destStride,
+                      int destWidth, int destHeight);
+
+}
+#endif /* PIXEL_CONVERT_H_ */
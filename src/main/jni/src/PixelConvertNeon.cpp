@@ -0,0 +1,196 @@
+// NEON kernels of PixelConvert. On armeabi-v7a this file is built with NEON enabled and its
+// kernels are only called after a runtime check, on arm64-v8a NEON is always available.
+
+#include "PixelConvert.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+
+namespace tools {
+
+    void rgb24To565Row_neon(const uint8_t *source, uint16_t *dest, int width) {
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            uint8x16x3_t rgb = vld3q_u8(source);
+            // Shift-right-and-insert keeps the upper bits already packed
+            uint16x8_t low = vshll_n_u8(vget_low_u8(rgb.val[0]), 8);
+            low = vsriq_n_u16(low, vshll_n_u8(vget_low_u8(rgb.val[1]), 8), 5);
+            low = vsriq_n_u16(low, vshll_n_u8(vget_low_u8(rgb.val[2]), 8), 11);
+            uint16x8_t high = vshll_n_u8(vget_high_u8(rgb.val[0]), 8);
+            high = vsriq_n_u16(high, vshll_n_u8(vget_high_u8(rgb.val[1]), 8), 5);
+            high = vsriq_n_u16(high, vshll_n_u8(vget_high_u8(rgb.val[2]), 8), 11);
+            vst1q_u16(dest + x, low);
+            vst1q_u16(dest + x + 8, high);
+            source += 48;
+        }
+        rgb24To565Row_scalar(source, dest + x, width - x);
+    }
+
+    void rgb24To565DitherRow_neon(const uint8_t *source, uint16_t *dest, int width,
+                                  int originX, int y) {
+        const uint8x16_t redBlueOffset = vld1q_u8(kDitherRedBlue[y & 3] + (originX & 3));
+        const uint8x16_t greenOffset = vld1q_u8(kDitherGreen[y & 3] + (originX & 3));
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            uint8x16x3_t rgb = vld3q_u8(source);
+            uint8x16_t red = vqaddq_u8(rgb.val[0], redBlueOffset);
+            uint8x16_t green = vqaddq_u8(rgb.val[1], greenOffset);
+            uint8x16_t blue = vqaddq_u8(rgb.val[2], redBlueOffset);
+            uint16x8_t low = vshll_n_u8(vget_low_u8(red), 8);
+            low = vsriq_n_u16(low, vshll_n_u8(vget_low_u8(green), 8), 5);
+            low = vsriq_n_u16(low, vshll_n_u8(vget_low_u8(blue), 8), 11);
+            uint16x8_t high = vshll_n_u8(vget_high_u8(red), 8);
+            high = vsriq_n_u16(high, vshll_n_u8(vget_high_u8(green), 8), 5);
+            high = vsriq_n_u16(high, vshll_n_u8(vget_high_u8(blue), 8), 11);
+            vst1q_u16(dest + x, low);
+            vst1q_u16(dest + x + 8, high);
+            source += 48;
+        }
+        rgb24To565DitherRow_scalar(source, dest + x, width - x, originX + x, y);
+    }
+
+    static inline uint16x8_t pack565(uint8x8_t red, uint8x8_t green, uint8x8_t blue) {
+        uint16x8_t packed = vshll_n_u8(red, 8);
+        packed = vsriq_n_u16(packed, vshll_n_u8(green, 8), 5);
+        return vsriq_n_u16(packed, vshll_n_u8(blue, 8), 11);
+    }
+
+    void swapRedBlueRow_neon(const uint8_t *source, uint8_t *dest, int width) {
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            uint8x16x4_t pixels = vld4q_u8(source + x * 4);
+            uint8x16_t first = pixels.val[0];
+            pixels.val[0] = pixels.val[2];
+            pixels.val[2] = first;
+            vst4q_u8(dest + x * 4, pixels);
+        }
+        swapRedBlueRow_scalar(source + x * 4, dest + x * 4, width - x);
+    }
+
+    void bgraTo565Row_neon(const uint8_t *source, uint16_t *dest, int width) {
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            uint8x16x4_t bgra = vld4q_u8(source + x * 4);
+            vst1q_u16(dest + x, pack565(vget_low_u8(bgra.val[2]), vget_low_u8(bgra.val[1]),
+                                        vget_low_u8(bgra.val[0])));
+            vst1q_u16(dest + x + 8, pack565(vget_high_u8(bgra.val[2]),
+                                            vget_high_u8(bgra.val[1]),
+                                            vget_high_u8(bgra.val[0])));
+        }
+        bgraTo565Row_scalar(source + x * 4, dest + x, width - x);
+    }
+
+    void bgraTo565DitherRow_neon(const uint8_t *source, uint16_t *dest, int width,
+                                 int originX, int y) {
+        const uint8x16_t redBlueOffset = vld1q_u8(kDitherRedBlue[y & 3] + (originX & 3));
+        const uint8x16_t greenOffset = vld1q_u8(kDitherGreen[y & 3] + (originX & 3));
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            uint8x16x4_t bgra = vld4q_u8(source + x * 4);
+            uint8x16_t red = vqaddq_u8(bgra.val[2], redBlueOffset);
+            uint8x16_t green = vqaddq_u8(bgra.val[1], greenOffset);
+            uint8x16_t blue = vqaddq_u8(bgra.val[0], redBlueOffset);
+            vst1q_u16(dest + x, pack565(vget_low_u8(red), vget_low_u8(green),
+                                        vget_low_u8(blue)));
+            vst1q_u16(dest + x + 8, pack565(vget_high_u8(red), vget_high_u8(green),
+                                            vget_high_u8(blue)));
+        }
+        bgraTo565DitherRow_scalar(source + x * 4, dest + x, width - x, originX + x, y);
+    }
+
+    // Same 7 bit weights as the scalar kernel, the rounding narrow adds 64 before the shift
+    static inline uint8x8_t luma(uint8x8_t red, uint8x8_t green, uint8x8_t blue) {
+        uint16x8_t sum = vmull_u8(red, vdup_n_u8(38));
+        sum = vmlal_u8(sum, green, vdup_n_u8(75));
+        sum = vmlal_u8(sum, blue, vdup_n_u8(15));
+        return vrshrn_n_u16(sum, 7);
+    }
+
+    void bgraToGray8Row_neon(const uint8_t *source, uint8_t *dest, int width) {
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            uint8x16x4_t bgra = vld4q_u8(source + x * 4);
+            uint8x8_t low = luma(vget_low_u8(bgra.val[2]), vget_low_u8(bgra.val[1]),
+                                 vget_low_u8(bgra.val[0]));
+            uint8x8_t high = luma(vget_high_u8(bgra.val[2]), vget_high_u8(bgra.val[1]),
+                                  vget_high_u8(bgra.val[0]));
+            vst1q_u8(dest + x, vcombine_u8(low, high));
+        }
+        bgraToGray8Row_scalar(source + x * 4, dest + x, width - x);
+    }
+
+    // (product + 128 + ((product + 128) >> 8)) >> 8, as the scalar kernel
+    static inline uint8x8_t multiplyAlpha(uint8x8_t value, uint8x8_t alpha) {
+        uint16x8_t product = vmull_u8(value, alpha);
+        return vraddhn_u16(product, vrshrq_n_u16(product, 8));
+    }
+
+    static inline uint8x16_t multiplyAlpha(uint8x16_t value, uint8x16_t alpha) {
+        return vcombine_u8(multiplyAlpha(vget_low_u8(value), vget_low_u8(alpha)),
+                           multiplyAlpha(vget_high_u8(value), vget_high_u8(alpha)));
+    }
+
+    void premultiplyRow_neon(const uint8_t *source, uint8_t *dest, int width) {
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            uint8x16x4_t pixels = vld4q_u8(source + x * 4);
+            pixels.val[0] = multiplyAlpha(pixels.val[0], pixels.val[3]);
+            pixels.val[1] = multiplyAlpha(pixels.val[1], pixels.val[3]);
+            pixels.val[2] = multiplyAlpha(pixels.val[2], pixels.val[3]);
+            vst4q_u8(dest + x * 4, pixels);
+        }
+        premultiplyRow_scalar(source + x * 4, dest + x * 4, width - x);
+    }
+
+    void bgraToRgb24Row_neon(const uint8_t *source, uint8_t *dest, int width) {
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            uint8x16x4_t bgra = vld4q_u8(source + x * 4);
+            uint8x16x3_t rgb;
+            rgb.val[0] = bgra.val[2];
+            rgb.val[1] = bgra.val[1];
+            rgb.val[2] = bgra.val[0];
+            vst3q_u8(dest + x * 3, rgb);
+        }
+        bgraToRgb24Row_scalar(source + x * 4, dest + x * 3, width - x);
+    }
+
+    void rgbaToRgb24Row_neon(const uint8_t *source, uint8_t *dest, int width) {
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            uint8x16x4_t rgba = vld4q_u8(source + x * 4);
+            uint8x16x3_t rgb;
+            rgb.val[0] = rgba.val[0];
+            rgb.val[1] = rgba.val[1];
+            rgb.val[2] = rgba.val[2];
+            vst3q_u8(dest + x * 3, rgb);
+        }
+        rgbaToRgb24Row_scalar(source + x * 4, dest + x * 3, width - x);
+    }
+
+    void downsample2xRow_neon(const uint8_t *top, const uint8_t *bottom, uint8_t *dest,
+                              int destWidth) {
+        int x = 0;
+        for (; x + 16 <= destWidth; x += 16) {
+            const uint8_t *topPixels = top + x * 8;
+            const uint8_t *bottomPixels = bottom + x * 8;
+            uint8x16x4_t topLeft = vld4q_u8(topPixels);
+            uint8x16x4_t topRight = vld4q_u8(topPixels + 64);
+            uint8x16x4_t bottomLeft = vld4q_u8(bottomPixels);
+            uint8x16x4_t bottomRight = vld4q_u8(bottomPixels + 64);
+            uint8x16x4_t result;
+            for (int channel = 0; channel < 4; channel++) {
+                uint8x16_t left = vrhaddq_u8(topLeft.val[channel], bottomLeft.val[channel]);
+                uint8x16_t right = vrhaddq_u8(topRight.val[channel], bottomRight.val[channel]);
+                // Even and odd pixels of the 32, then average the pairs
+                uint8x16x2_t pairs = vuzpq_u8(left, right);
+                result.val[channel] = vrhaddq_u8(pairs.val[0], pairs.val[1]);
+            }
+            vst4q_u8(dest + x * 4, result);
+        }
+        downsample2xRow_scalar(top + x * 8, bottom + x * 8, dest + x * 4, destWidth - x);
+    }
+
+}
+
+#endif
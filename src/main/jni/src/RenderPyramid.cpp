@@ -0,0 +1,126 @@
+#include "RenderPyramid.h"
+#include "PageRender.h"
+#include "PixelConvert.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace android;
+
+namespace tools {
+
+    // Levels stop once their larger side would drop below this size
+    static const int MIN_LEVEL_SIZE = 32;
+
+    RenderPyramid::RenderPyramid(size_t budgetBytes) : mBudget(budgetBytes), mSize(0) {
+    }
+
+    int RenderPyramid::build(FPDF_PAGE page, float scale, uint32_t backgroundColor,
+                             bool renderAnnot, int renderFlags) {
+        if (page == nullptr || scale <= 0) {
+            return 0;
+        }
+        size_t budget;
+        {
+            AutoMutex lock(mLock);
+            budget = mBudget;
+        }
+        double pageWidth = FPDF_GetPageWidth(page);
+        double pageHeight = FPDF_GetPageHeight(page);
+        int width = (int) (pageWidth * scale + 0.5);
+        int height = (int) (pageHeight * scale + 0.5);
+        // The coarser levels add at most a third to the finest one
+        while (width > 1 && height > 1 && (size_t) width * height * 4 * 4 / 3 > budget) {
+            scale /= 2;
+            width = (int) (pageWidth * scale + 0.5);
+            height = (int) (pageHeight * scale + 0.5);
+        }
+        if (width <= 0 || height <= 0 || (size_t) width * height * 4 > budget) {
+            return 0;
+        }
+
+        // Built without holding the lock, readers keep the previous levels meanwhile
+        std::vector<Level> levels(1);
+        Level &finest = levels[0];
+        finest.width = width;
+        finest.height = height;
+        finest.scale = scale;
+        finest.pixels.resize((size_t) width * height * 4);
+        RenderTarget target = {finest.pixels.data(), width, height, width * 4,
+                               PIXEL_FORMAT_RGBA_8888};
+        if (!renderPage(page, target, 0, 0, width, height, backgroundColor, renderAnnot,
+                        renderFlags)) {
+            return 0;
+        }
+        size_t size = finest.pixels.size();
+        while (std::max(levels.back().width, levels.back().height) / 2 >= MIN_LEVEL_SIZE &&
+               std::min(levels.back().width, levels.back().height) / 2 >= 1) {
+            levels.push_back(Level());
+            const Level &finer = levels[levels.size() - 2];
+            Level &level = levels.back();
+            level.width = finer.width / 2;
+            level.height = finer.height / 2;
+            level.scale = finer.scale / 2;
+            level.pixels.resize((size_t) level.width * level.height * 4);
+            downsample2x(finer.pixels.data(), finer.width * 4, level.pixels.data(),
+                         level.width * 4, level.width, level.height);
+            size += level.pixels.size();
+        }
+
+        AutoMutex lock(mLock);
+        mLevels.swap(levels);
+        mSize = size;
+        return (int) mLevels.size();
+    }
+
+    int RenderPyramid::findLevel(float scale) {
+        AutoMutex lock(mLock);
+        for (int level = (int) mLevels.size() - 1; level > 0; level--) {
+            if (mLevels[level].scale >= scale) {
+                return level;
+            }
+        }
+        return mLevels.empty() ? -1 : 0;
+    }
+
+    bool RenderPyramid::getLevel(int level, int *width, int *height, float *scale) {
+        AutoMutex lock(mLock);
+        if (level < 0 || level >= (int) mLevels.size()) {
+            return false;
+        }
+        *width = mLevels[level].width;
+        *height = mLevels[level].height;
+        *scale = mLevels[level].scale;
+        return true;
+    }
+
+    bool RenderPyramid::copyLevel(int level, void *dest, int destStride) {
+        AutoMutex lock(mLock);
+        if (level < 0 || level >= (int) mLevels.size()) {
+            return false;
+        }
+        const Level &source = mLevels[level];
+        size_t rowBytes = (size_t) source.width * 4;
+        for (int y = 0; y < source.height; y++) {
+            memcpy((uint8_t *) dest + (size_t) y * destStride, &source.pixels[y * rowBytes],
+                   rowBytes);
+        }
+        return true;
+    }
+
+    void RenderPyramid::clear() {
+        AutoMutex lock(mLock);
+        mLevels.clear();
+        mSize = 0;
+    }
+
+    RenderPyramidStats RenderPyramid::getStats() {
+        AutoMutex lock(mLock);
+        RenderPyramidStats stats;
+        stats.levelCount = (int64_t) mLevels.size();
+        stats.sizeBytes = (int64_t) mSize;
+        stats.budgetBytes = (int64_t) mBudget;
+        return stats;
+    }
+
+}
@@ -0,0 +1,60 @@
+#ifndef RENDER_PYRAMID_H_
+#define RENDER_PYRAMID_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <utils/Mutex.h>
+#include <fpdfview.h>
+
+namespace tools {
+
+    struct RenderPyramidStats {
+        int64_t levelCount;
+        int64_t sizeBytes;
+        int64_t budgetBytes;
+    };
+
+    // Renders of one page at power of two scales, RGBA_8888. Only the finest level is rendered
+    // by pdfium, every coarser level is box-downsampled from the one above it. Reading levels
+    // never calls into pdfium, so it may run without holding the render lock.
+    class RenderPyramid {
+    public:
+        explicit RenderPyramid(size_t budgetBytes);
+
+        // Replace the levels with a render of the page at scale. The scale is halved until the
+        // whole pyramid fits the budget. Returns the number of levels, 0 on failure.
+        int build(FPDF_PAGE page, float scale, uint32_t backgroundColor, bool renderAnnot,
+                  int renderFlags);
+
+        // The coarsest level at least as sharp as scale, the finest level if none is, -1 if the
+        // pyramid is empty
+        int findLevel(float scale);
+
+        bool getLevel(int level, int *width, int *height, float *scale);
+
+        // dest must hold the full level
+        bool copyLevel(int level, void *dest, int destStride);
+
+        void clear();
+
+        RenderPyramidStats getStats();
+
+    private:
+        struct Level {
+            int width;
+            int height;
+            float scale;
+            std::vector<uint8_t> pixels;
+        };
+
+        android::Mutex mLock;
+        std::vector<Level> mLevels;
+        size_t mBudget;
+        size_t mSize;
+    };
+
+}
+#endif /* RENDER_PYRAMID_H_ */
@@ -0,0 +1,134 @@
+#include "RenderQueue.h"
+
+using namespace android;
+
+namespace tools {
+
+    static int clampPriority(int priority) {
+        if (priority < RENDER_PRIORITY_VISIBLE) {
+            return RENDER_PRIORITY_VISIBLE;
+        }
+        if (priority > RENDER_PRIORITY_BACKGROUND) {
+            return RENDER_PRIORITY_BACKGROUND;
+        }
+        return priority;
+    }
+
+    RenderQueue::RenderQueue() : mNextId(1), mNextSequence(0), mClosed(false) {
+        mStats.queued = 0;
+        mStats.submitted = 0;
+        mStats.coalesced = 0;
+        mStats.cancelled = 0;
+        mStats.taken = 0;
+    }
+
+    int64_t RenderQueue::submit(const RenderKey &key, int priority, int64_t group,
+                                bool *coalesced) {
+        AutoMutex lock(mLock);
+        priority = clampPriority(priority);
+        mStats.submitted++;
+
+        std::map<RenderKey, int64_t>::iterator existing = mKeys.find(key);
+        if (existing != mKeys.end()) {
+            int64_t id = existing->second;
+            Job &job = mJobs[id];
+            Order order = {job.priority, job.sequence, id};
+            mOrder.erase(order);
+
+            // A repeated request is as recent as the latest one of it
+            if (priority < job.priority) {
+                job.priority = priority;
+            }
+            job.group = group;
+            job.sequence = mNextSequence++;
+            Order updated = {job.priority, job.sequence, id};
+            mOrder.insert(updated);
+
+            mStats.coalesced++;
+            if (coalesced != NULL) {
+                *coalesced = true;
+            }
+            return id;
+        }
+
+        int64_t id = mNextId++;
+        Job job = {key, priority, group, mNextSequence++};
+        mJobs[id] = job;
+        mKeys[key] = id;
+        Order order = {job.priority, job.sequence, id};
+        mOrder.insert(order);
+
+        if (coalesced != NULL) {
+            *coalesced = false;
+        }
+        mAvailable.signal();
+        return id;
+    }
+
+    int64_t RenderQueue::take() {
+        AutoMutex lock(mLock);
+        while (!mClosed && mOrder.empty()) {
+            mAvailable.wait(mLock);
+        }
+        if (mClosed) {
+            return -1;
+        }
+
+        int64_t id = mOrder.begin()->id;
+        remove(mJobs.find(id));
+        mStats.taken++;
+        return id;
+    }
+
+    bool RenderQueue::cancel(int64_t id) {
+        AutoMutex lock(mLock);
+        std::map<int64_t, Job>::iterator job = mJobs.find(id);
+        if (job == mJobs.end()) {
+            return false;
+        }
+        remove(job);
+        mStats.cancelled++;
+        return true;
+    }
+
+    int RenderQueue::cancelGroup(int64_t group) {
+        AutoMutex lock(mLock);
+        int count = 0;
+        std::map<int64_t, Job>::iterator job = mJobs.begin();
+        while (job != mJobs.end()) {
+            std::map<int64_t, Job>::iterator next = job;
+            ++next;
+            if (job->second.group == group) {
+                remove(job);
+                count++;
+            }
+            job = next;
+        }
+        mStats.cancelled += count;
+        return count;
+    }
+
+    void RenderQueue::close() {
+        AutoMutex lock(mLock);
+        mClosed = true;
+        mJobs.clear();
+        mKeys.clear();
+        mOrder.clear();
+        mAvailable.broadcast();
+    }
+
+    RenderQueueStats RenderQueue::getStats() {
+        AutoMutex lock(mLock);
+        RenderQueueStats stats = mStats;
+        stats.queued = (int64_t) mJobs.size();
+        return stats;
+    }
+
+    void RenderQueue::remove(std::map<int64_t, Job>::iterator job) {
+        Order order = {job->second.priority, job->second.sequence, job->first};
+        mOrder.erase(order);
+        mKeys.erase(job->second.key);
+        mJobs.erase(job);
+    }
+
+}
@@ -0,0 +1,111 @@
+#ifndef RENDER_QUEUE_H_
+#define RENDER_QUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <set>
+
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+
+namespace tools {
+
+    // Mirrored by PdfDocument.RenderScheduler.PRIORITY_*, lower values run first
+    enum {
+        RENDER_PRIORITY_VISIBLE = 0,
+        RENDER_PRIORITY_NEAR_VISIBLE = 1,
+        RENDER_PRIORITY_PREFETCH = 2,
+        RENDER_PRIORITY_BACKGROUND = 3
+    };
+
+    // What a job renders, requests for the same key are coalesced into one job
+    struct RenderKey {
+        int64_t documentId;
+        int pageIndex;
+        // Tile, zoom or any other distinction of the caller
+        int64_t tag;
+
+        bool operator<(const RenderKey &other) const {
+            if (documentId != other.documentId) {
+                return documentId < other.documentId;
+            }
+            if (pageIndex != other.pageIndex) {
+                return pageIndex < other.pageIndex;
+            }
+            return tag < other.tag;
+        }
+    };
+
+    struct RenderQueueStats {
+        int64_t queued;
+        int64_t submitted;
+        int64_t coalesced;
+        int64_t cancelled;
+        int64_t taken;
+    };
+
+    // Render jobs waiting for the single thread which may call into pdfium. The most urgent
+    // priority is taken first and within a priority the most recent request, pages scrolled
+    // past are then the first ones left behind. Jobs carry ids only, the caller keeps the work.
+    class RenderQueue {
+    public:
+        RenderQueue();
+
+        // Queue a job and return its id. A job for the same key that is still queued is
+        // reused: it keeps its id, takes the more urgent priority and moves to the new group.
+        int64_t submit(const RenderKey &key, int priority, int64_t group, bool *coalesced);
+
+        // Block until a job is queued and remove it, -1 once the queue is closed
+        int64_t take();
+
+        // Remove a queued job, false if it was taken or cancelled already
+        bool cancel(int64_t id);
+
+        // Remove every queued job of the group, e.g. of a viewport which is no longer shown.
+        // Returns the number of removed jobs.
+        int cancelGroup(int64_t group);
+
+        // Wake up and stop take() callers, jobs still queued are dropped
+        void close();
+
+        RenderQueueStats getStats();
+
+    private:
+        struct Job {
+            RenderKey key;
+            int priority;
+            int64_t group;
+            int64_t sequence;
+        };
+
+        // Priority first, then the most recent sequence
+        struct Order {
+            int priority;
+            int64_t sequence;
+            int64_t id;
+
+            bool operator<(const Order &other) const {
+                if (priority != other.priority) {
+                    return priority < other.priority;
+                }
+                return sequence > other.sequence;
+            }
+        };
+
+        void remove(std::map<int64_t, Job>::iterator job);
+
+        android::Mutex mLock;
+        android::Condition mAvailable;
+        std::map<int64_t, Job> mJobs;
+        std::map<RenderKey, int64_t> mKeys;
+        std::set<Order> mOrder;
+        int64_t mNextId;
+        int64_t mNextSequence;
+        bool mClosed;
+        RenderQueueStats mStats;
+    };
+
+}
+#endif /* RENDER_QUEUE_H_ */
@@ -0,0 +1,65 @@
+// Helper executable of RenderWorkerPool. The pool forks and executes it right away, so each
+// worker starts as a fresh process instead of a copy of the app with its threads, locks and
+// open files.
+//
+//   libpdfiumworker.so <socket fd>
+
+#include "RenderWorkers.h"
+
+#include <dirent.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <vector>
+
+#include <fpdfview.h>
+
+// Descriptors the app left without close-on-exec, e.g. its binder driver. Everything except
+// the standard streams and the socket is closed.
+static void closeInheritedFiles(int socket) {
+    std::vector<int> inherited;
+    DIR *directory = opendir("/proc/self/fd");
+    if (directory != nullptr) {
+        while (struct dirent *entry = readdir(directory)) {
+            if (entry->d_name[0] >= '0' && entry->d_name[0] <= '9') {
+                inherited.push_back(atoi(entry->d_name));
+            }
+        }
+        int directoryFd = dirfd(directory);
+        for (int &fd : inherited) {
+            fd = fd == directoryFd ? -1 : fd;
+        }
+        closedir(directory);
+    } else {
+        struct rlimit limit;
+        int maxFd = getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY
+                    ? (int) limit.rlim_cur : 1024;
+        for (int fd = 0; fd < maxFd; fd++) {
+            inherited.push_back(fd);
+        }
+    }
+    for (int fd : inherited) {
+        if (fd > STDERR_FILENO && fd != socket) {
+            close(fd);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        return 2;
+    }
+    int socket = atoi(argv[1]);
+    closeInheritedFiles(socket);
+    // The signal mask of the forking thread survives exec
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigprocmask(SIG_SETMASK, &signals, nullptr);
+
+    FPDF_InitLibrary();
+    int status = tools::runRenderWorker(socket);
+    FPDF_DestroyLibrary();
+    return status;
+}
@@ -0,0 +1,593 @@
+#include "RenderWorkers.h"
+#include "FileSource.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef ASHMEM_SET_SIZE
+#define ASHMEM_SET_SIZE _IOW(0x77, 3, size_t)
+#endif
+
+using namespace android;
+
+namespace tools {
+
+    enum {
+        WORKER_OPEN = 1,
+        WORKER_RENDER = 2
+    };
+
+    // Fixed part of every request, WORKER_OPEN is followed by the password. The document file
+    // descriptor and new shared memory travel as SCM_RIGHTS.
+    struct WorkerRequest {
+        int32_t type;
+        int32_t pageIndex;
+        int32_t width;
+        int32_t height;
+        int32_t stride;
+        int32_t format;
+        int32_t startX;
+        int32_t startY;
+        int32_t drawSizeHor;
+        int32_t drawSizeVer;
+        uint32_t backgroundColor;
+        int32_t renderAnnot;
+        int32_t renderFlags;
+        // -1 for no password
+        int32_t passwordLength;
+        int64_t documentOffset;
+        int64_t documentLength;
+        // Size of the shared memory sent along, 0 to keep the current one
+        uint64_t memorySize;
+    };
+
+    struct WorkerReply {
+        int32_t succeeded;
+    };
+
+    static const int MAX_PASSWORD_BYTES = 4096;
+    // Shared memory grows in steps, so targets of similar size reuse it
+    static const size_t WORKER_MEMORY_STEP = 1024 * 1024;
+    // Where the helper finds its end of the socket, passed as its argument as well
+    static const int WORKER_SOCKET_FD = 3;
+    static const char LIBRARY_PATH_VARIABLE[] = "LD_LIBRARY_PATH=";
+
+    static int64_t monotonicNanos() {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (int64_t) now.tv_sec * 1000000000LL + now.tv_nsec;
+    }
+
+    static int createSharedMemory(size_t size) {
+        int fd;
+#ifdef __NR_memfd_create
+        fd = (int) syscall(__NR_memfd_create, "pdfium-worker", MFD_CLOEXEC);
+        if (fd >= 0) {
+            if (ftruncate(fd, (off_t) size) == 0) {
+                return fd;
+            }
+            close(fd);
+            return -1;
+        }
+#endif
+        // ashmem on kernels before memfd_create
+        fd = open("/dev/ashmem", O_RDWR | O_CLOEXEC);
+        if (fd >= 0 && ioctl(fd, ASHMEM_SET_SIZE, size) != 0) {
+            close(fd);
+            fd = -1;
+        }
+        return fd;
+    }
+
+    static bool sendMessage(int socket, const void *data, size_t size, int fd) {
+        struct iovec vector;
+        vector.iov_base = const_cast<void *>(data);
+        vector.iov_len = size;
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+        char control[CMSG_SPACE(sizeof(int))];
+        if (fd >= 0) {
+            memset(control, 0, sizeof(control));
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+            struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+            header->cmsg_level = SOL_SOCKET;
+            header->cmsg_type = SCM_RIGHTS;
+            header->cmsg_len = CMSG_LEN(sizeof(int));
+            memcpy(CMSG_DATA(header), &fd, sizeof(int));
+        }
+        ssize_t sent;
+        do {
+            // A dead peer fails the call instead of raising SIGPIPE
+            sent = sendmsg(socket, &message, MSG_NOSIGNAL);
+        } while (sent < 0 && errno == EINTR);
+        return sent == (ssize_t) size;
+    }
+
+    // Returns the message size, 0 once the peer is gone and -1 on errors. fd receives a passed
+    // file descriptor, -1 if there is none.
+    static ssize_t receiveMessage(int socket, void *data, size_t capacity, int *fd) {
+        struct iovec vector;
+        vector.iov_base = data;
+        vector.iov_len = capacity;
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+        char control[CMSG_SPACE(sizeof(int))];
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        ssize_t received;
+        do {
+            received = recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+        } while (received < 0 && errno == EINTR);
+        *fd = -1;
+        for (struct cmsghdr *header = CMSG_FIRSTHDR(&message); received >= 0 && header != nullptr;
+             header = CMSG_NXTHDR(&message, header)) {
+            if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+                memcpy(fd, CMSG_DATA(header), sizeof(int));
+            }
+        }
+        if ((message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0) {
+            if (*fd >= 0) {
+                close(*fd);
+                *fd = -1;
+            }
+            return -1;
+        }
+        return received;
+    }
+
+    static void copyArea(const void *source, void *dest, int stride, int pixelBytes, int left,
+                         int top, int width, int height) {
+        size_t offset = (size_t) top * stride + (size_t) left * pixelBytes;
+        for (int y = 0; y < height; y++) {
+            memcpy((char *) dest + offset, (const char *) source + offset,
+                   (size_t) width * pixelBytes);
+            offset += stride;
+        }
+    }
+
+    // Worker process side
+
+    struct WorkerState {
+        FPDF_DOCUMENT document;
+        FileSource *source;
+        int fd;
+        void *memory;
+        size_t memorySize;
+    };
+
+    static bool workerOpen(WorkerState &state, const WorkerRequest &request,
+                           const char *password, int fd) {
+        if (state.document != nullptr) {
+            FPDF_CloseDocument(state.document);
+            state.document = nullptr;
+        }
+        delete state.source;
+        state.source = nullptr;
+        if (state.fd >= 0) {
+            close(state.fd);
+        }
+        state.fd = fd;
+        if (fd < 0) {
+            return false;
+        }
+        state.source = new FileSource(fd, request.documentOffset, request.documentLength);
+        state.source->open(FILE_ACCESS_MAPPED);
+        FPDF_FILEACCESS loader;
+        state.source->getFileAccess(&loader);
+        state.document = FPDF_LoadCustomDocument(&loader, password);
+        return state.document != nullptr;
+    }
+
+    static bool workerRender(WorkerState &state, const WorkerRequest &request, int memoryFd) {
+        if (memoryFd >= 0) {
+            if (state.memory != nullptr) {
+                munmap(state.memory, state.memorySize);
+            }
+            state.memorySize = (size_t) request.memorySize;
+            state.memory = mmap(nullptr, state.memorySize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                                memoryFd, 0);
+            // The mapping keeps the memory alive
+            close(memoryFd);
+            if (state.memory == MAP_FAILED) {
+                state.memory = nullptr;
+                state.memorySize = 0;
+            }
+        }
+        RenderTarget target = {state.memory, request.width, request.height, request.stride,
+                               request.format};
+        size_t size = targetSize(target);
+        if (state.document == nullptr || state.memory == nullptr || size == 0 ||
+            size > state.memorySize) {
+            return false;
+        }
+        FPDF_PAGE page = FPDF_LoadPage(state.document, request.pageIndex);
+        if (page == nullptr) {
+            return false;
+        }
+        bool rendered = renderPage(page, target, request.startX, request.startY,
+                                   request.drawSizeHor, request.drawSizeVer,
+                                   request.backgroundColor, request.renderAnnot != 0,
+                                   request.renderFlags);
+        FPDF_ClosePage(page);
+        return rendered;
+    }
+
+    int runRenderWorker(int socket) {
+        WorkerState state;
+        memset(&state, 0, sizeof(state));
+        state.fd = -1;
+        // Tells the pool the helper started and initialized the library
+        WorkerReply ready = {1};
+        if (!sendMessage(socket, &ready, sizeof(ready), -1)) {
+            return 1;
+        }
+        std::vector<char> buffer(sizeof(WorkerRequest) + MAX_PASSWORD_BYTES + 1);
+        for (;;) {
+            int fd;
+            ssize_t size = receiveMessage(socket, buffer.data(), buffer.size() - 1, &fd);
+            if (size < (ssize_t) sizeof(WorkerRequest)) {
+                break;
+            }
+            WorkerRequest request;
+            memcpy(&request, buffer.data(), sizeof(request));
+            bool succeeded;
+            if (request.type == WORKER_OPEN) {
+                buffer[size] = 0;
+                succeeded = workerOpen(state, request, request.passwordLength >= 0
+                                              ? buffer.data() + sizeof(request) : nullptr, fd);
+            } else if (request.type == WORKER_RENDER) {
+                succeeded = workerRender(state, request, fd);
+            } else {
+                if (fd >= 0) {
+                    close(fd);
+                }
+                succeeded = false;
+            }
+            WorkerReply reply = {succeeded ? 1 : 0};
+            if (!sendMessage(socket, &reply, sizeof(reply), -1)) {
+                break;
+            }
+        }
+        if (state.document != nullptr) {
+            FPDF_CloseDocument(state.document);
+        }
+        delete state.source;
+        if (state.fd >= 0) {
+            close(state.fd);
+        }
+        if (state.memory != nullptr) {
+            munmap(state.memory, state.memorySize);
+        }
+        return 0;
+    }
+
+    // Pool side
+
+    RenderWorkerPool::RenderWorkerPool() {
+    }
+
+    RenderWorkerPool::~RenderWorkerPool() {
+        AutoMutex lock(mLock);
+        for (Worker &worker : mWorkers) {
+            stop(worker);
+        }
+    }
+
+    int RenderWorkerPool::start(const char *workerPath, int workerCount) {
+        AutoMutex lock(mLock);
+        // Another thread may hold the allocator or a pdfium lock at the moment of the fork and
+        // the child has no copy of that thread to release it. Everything exec needs is built
+        // here, the child only moves its socket into place and replaces itself.
+        std::string libraryPath(workerPath);
+        size_t slash = libraryPath.rfind('/');
+        libraryPath = std::string(LIBRARY_PATH_VARIABLE) +
+                      (slash != std::string::npos ? libraryPath.substr(0, slash) : ".");
+        const char *inheritedPath = getenv("LD_LIBRARY_PATH");
+        if (inheritedPath != nullptr && inheritedPath[0] != 0) {
+            libraryPath += ':';
+            libraryPath += inheritedPath;
+        }
+        std::vector<char *> environment;
+        environment.push_back(&libraryPath[0]);
+        for (char **variable = environ; *variable != nullptr; variable++) {
+            if (strncmp(*variable, LIBRARY_PATH_VARIABLE, strlen(LIBRARY_PATH_VARIABLE)) != 0) {
+                environment.push_back(*variable);
+            }
+        }
+        environment.push_back(nullptr);
+        char socketArgument[16];
+        snprintf(socketArgument, sizeof(socketArgument), "%d", WORKER_SOCKET_FD);
+        char *arguments[] = {const_cast<char *>(workerPath), socketArgument, nullptr};
+
+        size_t first = mWorkers.size();
+        for (int i = 0; i < workerCount; i++) {
+            int sockets[2];
+            if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) != 0) {
+                break;
+            }
+            pid_t pid = fork();
+            if (pid == 0) {
+                // All other descriptors of the pool are close-on-exec, the helper closes the
+                // ones the rest of the process left open. dup2 clears close-on-exec on the copy,
+                // a socket which already has the number keeps it.
+                int moved = sockets[1] == WORKER_SOCKET_FD
+                            ? fcntl(sockets[1], F_SETFD, 0)
+                            : dup2(sockets[1], WORKER_SOCKET_FD);
+                if (moved >= 0) {
+                    execve(workerPath, arguments, environment.data());
+                }
+                _exit(127);
+            }
+            close(sockets[1]);
+            if (pid < 0) {
+                close(sockets[0]);
+                break;
+            }
+            Worker worker;
+            memset(&worker, 0, sizeof(worker));
+            worker.pid = pid;
+            worker.socket = sockets[0];
+            worker.documentId = -1;
+            worker.memoryFd = -1;
+            worker.job = -1;
+            mWorkers.push_back(worker);
+        }
+        // A helper which could not be executed or initialized exits before it is ready
+        for (size_t i = first; i < mWorkers.size(); i++) {
+            WorkerReply ready;
+            int fd;
+            if (receiveMessage(mWorkers[i].socket, &ready, sizeof(ready), &fd) !=
+                sizeof(ready) || !ready.succeeded) {
+                stop(mWorkers[i]);
+            }
+        }
+        int running = 0;
+        for (const Worker &worker : mWorkers) {
+            running += worker.pid > 0 ? 1 : 0;
+        }
+        return running;
+    }
+
+    int RenderWorkerPool::getWorkerCount() {
+        AutoMutex lock(mLock);
+        int running = 0;
+        for (const Worker &worker : mWorkers) {
+            running += worker.pid > 0 ? 1 : 0;
+        }
+        return running;
+    }
+
+    void RenderWorkerPool::stop(Worker &worker) {
+        if (worker.pid > 0) {
+            close(worker.socket);
+            worker.socket = -1;
+            // Idle workers exit on EOF anyway, one stuck in a page has to be killed
+            kill(worker.pid, SIGKILL);
+            waitpid(worker.pid, nullptr, 0);
+            worker.pid = -1;
+        }
+        if (worker.memory != nullptr) {
+            munmap(worker.memory, worker.memorySize);
+            worker.memory = nullptr;
+            worker.memorySize = 0;
+        }
+        if (worker.memoryFd >= 0) {
+            close(worker.memoryFd);
+            worker.memoryFd = -1;
+        }
+        worker.documentId = -1;
+    }
+
+    bool RenderWorkerPool::openDocument(Worker &worker, const WorkerDocument &document) {
+        int passwordLength = document.password != nullptr ? (int) strlen(document.password) : -1;
+        if (document.fd < 0 || passwordLength > MAX_PASSWORD_BYTES) {
+            return false;
+        }
+        std::vector<char> message(sizeof(WorkerRequest) + std::max(0, passwordLength));
+        WorkerRequest request;
+        memset(&request, 0, sizeof(request));
+        request.type = WORKER_OPEN;
+        request.passwordLength = passwordLength;
+        request.documentOffset = document.offset;
+        request.documentLength = document.length;
+        memcpy(message.data(), &request, sizeof(request));
+        if (passwordLength > 0) {
+            memcpy(message.data() + sizeof(request), document.password, (size_t) passwordLength);
+        }
+        worker.documentId = -1;
+        WorkerReply reply;
+        int fd;
+        if (!sendMessage(worker.socket, message.data(), message.size(), document.fd) ||
+            receiveMessage(worker.socket, &reply, sizeof(reply), &fd) != sizeof(reply)) {
+            stop(worker);
+            return false;
+        }
+        if (reply.succeeded) {
+            worker.documentId = document.id;
+        }
+        return reply.succeeded != 0;
+    }
+
+    bool RenderWorkerPool::reserveMemory(Worker &worker, size_t size) {
+        if (size <= worker.memorySize) {
+            return true;
+        }
+        size = (size + WORKER_MEMORY_STEP - 1) / WORKER_MEMORY_STEP * WORKER_MEMORY_STEP;
+        int fd = createSharedMemory(size);
+        if (fd < 0) {
+            return false;
+        }
+        void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (memory == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        if (worker.memory != nullptr) {
+            munmap(worker.memory, worker.memorySize);
+        }
+        if (worker.memoryFd >= 0) {
+            close(worker.memoryFd);
+        }
+        worker.memory = memory;
+        worker.memorySize = size;
+        worker.memoryFd = fd;
+        return true;
+    }
+
+    bool RenderWorkerPool::dispatch(Worker &worker, const WorkerDocument &document,
+                                    const WorkerJob &job, uint32_t backgroundColor,
+                                    bool renderAnnot, int renderFlags) {
+        if (worker.documentId != document.id && !openDocument(worker, document)) {
+            return false;
+        }
+        size_t size = targetSize(job.target);
+        if (size == 0 || !reserveMemory(worker, size)) {
+            return false;
+        }
+        // Without an opaque background pdfium blends onto the pixels already there, the worker
+        // starts from a copy of them
+        if ((backgroundColor >> 24) != 0xFF) {
+            int left, top, width, height;
+            pageArea(job.target, job.startX, job.startY, job.drawSizeHor, job.drawSizeVer, &left,
+                     &top, &width, &height);
+            if (width > 0 && height > 0) {
+                copyArea(job.target.pixels, worker.memory, job.target.stride,
+                         bytesPerPixel(job.target.format), left, top, width, height);
+            }
+        }
+
+        WorkerRequest request;
+        memset(&request, 0, sizeof(request));
+        request.type = WORKER_RENDER;
+        request.pageIndex = job.pageIndex;
+        request.width = job.target.width;
+        request.height = job.target.height;
+        request.stride = job.target.stride;
+        request.format = job.target.format;
+        request.startX = job.startX;
+        request.startY = job.startY;
+        request.drawSizeHor = job.drawSizeHor;
+        request.drawSizeVer = job.drawSizeVer;
+        request.backgroundColor = backgroundColor;
+        request.renderAnnot = renderAnnot ? 1 : 0;
+        request.renderFlags = renderFlags;
+        request.passwordLength = -1;
+        request.memorySize = worker.memoryFd >= 0 ? worker.memorySize : 0;
+        if (!sendMessage(worker.socket, &request, sizeof(request), worker.memoryFd)) {
+            stop(worker);
+            return false;
+        }
+        // The worker maps it, the pool keeps its own mapping
+        if (worker.memoryFd >= 0) {
+            close(worker.memoryFd);
+            worker.memoryFd = -1;
+        }
+        return true;
+    }
+
+    bool RenderWorkerPool::collect(Worker &worker, WorkerJob &job) {
+        WorkerReply reply;
+        int fd;
+        if (receiveMessage(worker.socket, &reply, sizeof(reply), &fd) != sizeof(reply)) {
+            // Crashed, e.g. on a broken page
+            stop(worker);
+            return false;
+        }
+        if (!reply.succeeded) {
+            return false;
+        }
+        // Only the page area is written, except by the RGB_565 bands which cover the target
+        int left, top, width, height;
+        pageArea(job.target, job.startX, job.startY, job.drawSizeHor, job.drawSizeVer, &left,
+                 &top, &width, &height);
+        if (job.target.format == PIXEL_FORMAT_RGB_565) {
+            left = 0;
+            top = 0;
+            width = job.target.width;
+            height = job.target.height;
+        }
+        if (width > 0 && height > 0) {
+            copyArea(worker.memory, job.target.pixels, job.target.stride,
+                     bytesPerPixel(job.target.format), left, top, width, height);
+        }
+        return true;
+    }
+
+    void RenderWorkerPool::render(const WorkerDocument &document, WorkerJob *jobs, int jobCount,
+                                  uint32_t backgroundColor, bool renderAnnot, int renderFlags) {
+        AutoMutex lock(mLock);
+        for (int i = 0; i < jobCount; i++) {
+            jobs[i].rendered = false;
+            jobs[i].nanos = 0;
+        }
+        std::vector<struct pollfd> polls;
+        std::vector<Worker *> busy;
+        int next = 0;
+        for (;;) {
+            for (Worker &worker : mWorkers) {
+                while (worker.pid > 0 && worker.job < 0 && next < jobCount) {
+                    int index = next++;
+                    int64_t jobStart = monotonicNanos();
+                    if (dispatch(worker, document, jobs[index], backgroundColor, renderAnnot,
+                                 renderFlags)) {
+                        worker.job = index;
+                        worker.jobStart = jobStart;
+                    } else {
+                        jobs[index].nanos = monotonicNanos() - jobStart;
+                    }
+                }
+            }
+
+            polls.clear();
+            busy.clear();
+            for (Worker &worker : mWorkers) {
+                if (worker.job >= 0) {
+                    struct pollfd entry = {worker.socket, POLLIN, 0};
+                    polls.push_back(entry);
+                    busy.push_back(&worker);
+                }
+            }
+            // Done, or every worker is gone
+            if (polls.empty()) {
+                break;
+            }
+            if (poll(polls.data(), polls.size(), -1) < 0) {
+                continue;
+            }
+            for (size_t i = 0; i < polls.size(); i++) {
+                if (polls[i].revents == 0) {
+                    continue;
+                }
+                Worker &worker = *busy[i];
+                WorkerJob &job = jobs[worker.job];
+                job.rendered = collect(worker, job);
+                job.nanos = monotonicNanos() - worker.jobStart;
+                worker.job = -1;
+            }
+        }
+    }
+
+}
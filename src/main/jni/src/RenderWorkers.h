@@ -0,0 +1,99 @@
+#ifndef RENDER_WORKERS_H_
+#define RENDER_WORKERS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <vector>
+
+#include <utils/Mutex.h>
+
+#include "PageRender.h"
+
+namespace tools {
+
+    // Document the workers open on their own, identified by id so workers keep it open
+    // between calls
+    struct WorkerDocument {
+        int64_t id;
+        int fd;
+        // Range of the file holding the document
+        int64_t offset;
+        int64_t length;
+        const char *password;
+    };
+
+    struct WorkerJob {
+        int pageIndex;
+        RenderTarget target;
+        int startX;
+        int startY;
+        int drawSizeHor;
+        int drawSizeVer;
+        // Results
+        bool rendered;
+        int64_t nanos;
+    };
+
+    // Worker side of the pool, run by the helper executable once it has initialized the
+    // library. Serves requests on the socket until the pool closes it and returns the exit
+    // status of the helper.
+    int runRenderWorker(int socket);
+
+    // Helper processes which render pages in parallel. pdfium keeps global state and is not
+    // thread safe, processes give every worker its own instance of the library. Each worker
+    // opens the document on its own duplicate of the file descriptor and renders into shared
+    // memory, the pixels are copied into the targets afterwards.
+    class RenderWorkerPool {
+    public:
+        RenderWorkerPool();
+
+        // Stops and reaps the workers
+        ~RenderWorkerPool();
+
+        // Start the workers from the helper executable at workerPath, which finds the
+        // libraries it links next to it, and return how many are ready. The child only makes
+        // async-signal-safe calls between fork and exec, so other threads may be running and
+        // inside pdfium meanwhile.
+        int start(const char *workerPath, int workerCount);
+
+        // Workers still running, a crashed worker is not replaced
+        int getWorkerCount();
+
+        // Spread the jobs over the workers and block until all of them are done
+        void render(const WorkerDocument &document, WorkerJob *jobs, int jobCount,
+                    uint32_t backgroundColor, bool renderAnnot, int renderFlags);
+
+    private:
+        struct Worker {
+            pid_t pid;
+            int socket;
+            // Document open in the worker, -1 for none
+            int64_t documentId;
+            // Shared memory, memoryFd is open until it is sent along with the next job
+            int memoryFd;
+            void *memory;
+            size_t memorySize;
+            // Running job, -1 when idle
+            int job;
+            int64_t jobStart;
+        };
+
+        bool openDocument(Worker &worker, const WorkerDocument &document);
+
+        bool reserveMemory(Worker &worker, size_t size);
+
+        bool dispatch(Worker &worker, const WorkerDocument &document, const WorkerJob &job,
+                      uint32_t backgroundColor, bool renderAnnot, int renderFlags);
+
+        bool collect(Worker &worker, WorkerJob &job);
+
+        void stop(Worker &worker);
+
+        android::Mutex mLock;
+        std::vector<Worker> mWorkers;
+    };
+
+}
+#endif /* RENDER_WORKERS_H_ */
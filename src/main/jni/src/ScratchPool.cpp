@@ -0,0 +1,99 @@
+#include "ScratchPool.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include <utils/Mutex.h>
+
+using namespace android;
+
+namespace tools {
+
+    // Renders run one at a time under the document lock, a few idle buffers cover the callers
+    // which hold one across calls
+    static const size_t MAX_IDLE_BUFFERS = 4;
+
+    struct IdleBuffer {
+        void *data;
+        size_t capacity;
+    };
+
+    static Mutex sScratchLock;
+    static std::vector<IdleBuffer> sIdleBuffers;
+    static ScratchPoolStats sStats;
+
+    void *acquireScratch(size_t size, size_t *capacity) {
+        AutoMutex lock(sScratchLock);
+        sStats.acquires++;
+        int best = -1;
+        for (size_t i = 0; i < sIdleBuffers.size(); i++) {
+            if (sIdleBuffers[i].capacity >= size &&
+                (best < 0 || sIdleBuffers[i].capacity < sIdleBuffers[best].capacity)) {
+                best = (int) i;
+            }
+        }
+        void *data;
+        if (best >= 0) {
+            data = sIdleBuffers[best].data;
+            *capacity = sIdleBuffers[best].capacity;
+            sIdleBuffers.erase(sIdleBuffers.begin() + best);
+            sStats.idleBytes -= *capacity;
+        } else {
+            // Nothing fits, replace the largest idle buffer instead of keeping both
+            if (!sIdleBuffers.empty()) {
+                size_t largest = 0;
+                for (size_t i = 1; i < sIdleBuffers.size(); i++) {
+                    if (sIdleBuffers[i].capacity > sIdleBuffers[largest].capacity) {
+                        largest = i;
+                    }
+                }
+                free(sIdleBuffers[largest].data);
+                sStats.idleBytes -= sIdleBuffers[largest].capacity;
+                sIdleBuffers.erase(sIdleBuffers.begin() + largest);
+            }
+            data = malloc(size);
+            *capacity = data != nullptr ? size : 0;
+            sStats.allocations++;
+        }
+        sStats.usedBytes += *capacity;
+        if (sStats.usedBytes + sStats.idleBytes > sStats.highWaterBytes) {
+            sStats.highWaterBytes = sStats.usedBytes + sStats.idleBytes;
+        }
+        return data;
+    }
+
+    void releaseScratch(void *buffer, size_t capacity) {
+        if (buffer == nullptr) {
+            return;
+        }
+        AutoMutex lock(sScratchLock);
+        sStats.usedBytes -= capacity;
+        if (sIdleBuffers.size() >= MAX_IDLE_BUFFERS) {
+            free(buffer);
+            return;
+        }
+        IdleBuffer idle;
+        idle.data = buffer;
+        idle.capacity = capacity;
+        sIdleBuffers.push_back(idle);
+        sStats.idleBytes += capacity;
+    }
+
+    void trimScratch() {
+        AutoMutex lock(sScratchLock);
+        for (size_t i = 0; i < sIdleBuffers.size(); i++) {
+            free(sIdleBuffers[i].data);
+        }
+        sIdleBuffers.clear();
+        sStats.idleBytes = 0;
+        sStats.trims++;
+    }
+
+    ScratchPoolStats getScratchStats() {
+        AutoMutex lock(sScratchLock);
+        ScratchPoolStats stats = sStats;
+        stats.idleBuffers = (int64_t) sIdleBuffers.size();
+        return stats;
+    }
+
+}
@@ -0,0 +1,31 @@
+#ifndef SCRATCH_POOL_H_
+#define SCRATCH_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace tools {
+
+    struct ScratchPoolStats {
+        int64_t acquires;
+        int64_t allocations;
+        int64_t trims;
+        int64_t idleBuffers;
+        int64_t idleBytes;
+        int64_t usedBytes;
+        int64_t highWaterBytes;
+    };
+
+    // Process wide pool of temporary render buffers. Released buffers are kept for the next
+    // render and grow to the largest size requested, so steady rendering does not allocate.
+    void *acquireScratch(size_t size, size_t *capacity);
+
+    void releaseScratch(void *buffer, size_t capacity);
+
+    // Free every idle buffer, meant for low memory callbacks. Buffers in use are not affected.
+    void trimScratch();
+
+    ScratchPoolStats getScratchStats();
+
+}
+#endif /* SCRATCH_POOL_H_ */
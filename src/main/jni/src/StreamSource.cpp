@@ -0,0 +1,181 @@
+#include "StreamSource.h"
+#include "FileSource.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+using namespace android;
+
+namespace tools {
+
+    // Add start to end to disjoint ranges, merging it with the ranges it touches
+    static void addRange(std::map<int64_t, int64_t> &ranges, int64_t start, int64_t end) {
+        std::map<int64_t, int64_t>::iterator next = ranges.upper_bound(start);
+        if (next != ranges.begin()) {
+            std::map<int64_t, int64_t>::iterator previous = std::prev(next);
+            if (previous->second >= start) {
+                start = previous->first;
+                end = std::max(end, previous->second);
+                next = ranges.erase(previous);
+            }
+        }
+        while (next != ranges.end() && next->first <= end) {
+            end = std::max(end, next->second);
+            next = ranges.erase(next);
+        }
+        ranges[start] = end;
+    }
+
+    StreamSource::StreamSource(int fd, int64_t length)
+            : mFd(fd), mLength(length), mReferences(1), mAvail(nullptr), mDocument(nullptr),
+              mDocumentOpened(false) {
+        mFileAvail.version = 1;
+        mFileAvail.IsDataAvail = &isDataAvail;
+        mFileAvail.source = this;
+        mHints.version = 1;
+        mHints.AddSegment = &addSegment;
+        mHints.source = this;
+        mFileAccess.m_FileLen = static_cast<unsigned long>(length);
+        mFileAccess.m_GetBlock = &getBlock;
+        mFileAccess.m_Param = this;
+    }
+
+    StreamSource::~StreamSource() {
+        if (mAvail != nullptr) {
+            FPDFAvail_Destroy(mAvail);
+        }
+        if (mFd >= 0) {
+            close(mFd);
+        }
+    }
+
+    bool StreamSource::create() {
+        mAvail = FPDFAvail_Create(&mFileAvail, &mFileAccess);
+        return mAvail != nullptr;
+    }
+
+    void StreamSource::acquire() {
+        mReferences++;
+    }
+
+    void StreamSource::release() {
+        if (--mReferences == 0) {
+            delete this;
+        }
+    }
+
+    void StreamSource::addAvailableRange(int64_t offset, int64_t length) {
+        int64_t end = std::min(offset + length, mLength);
+        offset = std::max(offset, (int64_t) 0);
+        if (offset >= end) {
+            return;
+        }
+        AutoMutex lock(mLock);
+        addRange(mAvailable, offset, end);
+    }
+
+    std::vector<int64_t> StreamSource::getRequestedRanges() {
+        AutoMutex lock(mLock);
+        std::map<int64_t, int64_t> missing;
+        for (std::map<int64_t, int64_t>::iterator requested = mRequested.begin();
+             requested != mRequested.end(); ++requested) {
+            int64_t position = requested->first;
+            while (position < requested->second) {
+                std::map<int64_t, int64_t>::iterator next = mAvailable.upper_bound(position);
+                if (next != mAvailable.begin() && std::prev(next)->second > position) {
+                    position = std::prev(next)->second;
+                    continue;
+                }
+                int64_t end = next == mAvailable.end() ? requested->second
+                                                        : std::min(requested->second, next->first);
+                addRange(missing, position, end);
+                position = end;
+            }
+        }
+        // Ranges which arrived meanwhile are forgotten
+        mRequested.swap(missing);
+
+        std::vector<int64_t> ranges;
+        ranges.reserve(mRequested.size() * 2);
+        for (std::map<int64_t, int64_t>::iterator range = mRequested.begin();
+             range != mRequested.end(); ++range) {
+            ranges.push_back(range->first);
+            ranges.push_back(range->second - range->first);
+        }
+        return ranges;
+    }
+
+    int StreamSource::isDocumentAvailable() {
+        return FPDFAvail_IsDocAvail(mAvail, &mHints);
+    }
+
+    FPDF_DOCUMENT StreamSource::getDocument(const char *password) {
+        if (mDocumentOpened) {
+            return nullptr;
+        }
+        mDocument = FPDFAvail_GetDocument(mAvail, password);
+        mDocumentOpened = mDocument != nullptr;
+        return mDocument;
+    }
+
+    void StreamSource::detachDocument() {
+        mDocument = nullptr;
+    }
+
+    int StreamSource::isPageAvailable(int pageIndex) {
+        if (mDocument == nullptr) {
+            return PDF_DATA_ERROR;
+        }
+        return FPDFAvail_IsPageAvail(mAvail, pageIndex, &mHints);
+    }
+
+    int StreamSource::isLinearized() {
+        return FPDFAvail_IsLinearized(mAvail);
+    }
+
+    FPDF_BOOL StreamSource::isDataAvail(FX_FILEAVAIL *fileAvail, size_t offset, size_t size) {
+        StreamSource *source = static_cast<FileAvail *>(fileAvail)->source;
+        AutoMutex lock(source->mLock);
+        return source->isAvailable((int64_t) offset, (int64_t) size);
+    }
+
+    void StreamSource::addSegment(FX_DOWNLOADHINTS *hints, size_t offset, size_t size) {
+        StreamSource *source = static_cast<DownloadHints *>(hints)->source;
+        // Hints are not accurate, they may reach past the end of the file
+        int64_t start = std::min((int64_t) offset, source->mLength);
+        int64_t end = std::min((int64_t) offset + (int64_t) size, source->mLength);
+        if (start >= end) {
+            return;
+        }
+        AutoMutex lock(source->mLock);
+        addRange(source->mRequested, start, end);
+    }
+
+    int StreamSource::getBlock(void *param, unsigned long position, unsigned char *outBuffer,
+                               unsigned long size) {
+        auto source = reinterpret_cast<StreamSource *>(param);
+        {
+            AutoMutex lock(source->mLock);
+            // The file holds zeros where nothing has been written yet
+            if (!source->isAvailable((int64_t) position, (int64_t) size)) {
+                return 0;
+            }
+        }
+        return readFully(source->mFd, (int64_t) position, outBuffer, (size_t) size) ? 1 : 0;
+    }
+
+    bool StreamSource::isAvailable(int64_t offset, int64_t size) {
+        if (offset < 0 || offset + size > mLength) {
+            return false;
+        }
+        if (size == 0) {
+            return true;
+        }
+        std::map<int64_t, int64_t>::iterator next = mAvailable.upper_bound(offset);
+        return next != mAvailable.begin() && std::prev(next)->second >= offset + size;
+    }
+
+}
@@ -0,0 +1,96 @@
+#ifndef STREAM_SOURCE_H_
+#define STREAM_SOURCE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <vector>
+
+#include <utils/Mutex.h>
+
+#include <fpdf_dataavail.h>
+#include <fpdfview.h>
+
+namespace tools {
+
+    // A document which is still being downloaded into a file of its final length. The download
+    // reports every range it has written, pdfium only reads reported ranges and asks for the
+    // ones it needs next through download hints. Ranges may arrive in any order, e.g. from HTTP
+    // range requests for the hinted ranges.
+    //
+    // The source is shared by its loader and the document opened from it, and deleted when
+    // both have released it. Apart from addAvailableRange and getRequestedRanges every call
+    // must hold the render lock.
+    class StreamSource {
+    public:
+        // Takes ownership of the descriptor
+        StreamSource(int fd, int64_t length);
+
+        // Create the availability provider, false on error
+        bool create();
+
+        void acquire();
+
+        void release();
+
+        // The bytes from offset on have been written to the file
+        void addAvailableRange(int64_t offset, int64_t length);
+
+        // Offset and length pairs pdfium asked for which are not available yet
+        std::vector<int64_t> getRequestedRanges();
+
+        // One of PDF_DATA_*, hinted ranges are recorded
+        int isDocumentAvailable();
+
+        // Once the document is available, at most once
+        FPDF_DOCUMENT getDocument(const char *password);
+
+        // The document has been closed, pages cannot be checked anymore
+        void detachDocument();
+
+        // One of PDF_DATA_*, PDF_DATA_ERROR without an open document
+        int isPageAvailable(int pageIndex);
+
+        // One of PDF_LINEARIZED, PDF_NOT_LINEARIZED or PDF_LINEARIZATION_UNKNOWN
+        int isLinearized();
+
+    private:
+        struct FileAvail : FX_FILEAVAIL {
+            StreamSource *source;
+        };
+
+        struct DownloadHints : FX_DOWNLOADHINTS {
+            StreamSource *source;
+        };
+
+        ~StreamSource();
+
+        static FPDF_BOOL isDataAvail(FX_FILEAVAIL *fileAvail, size_t offset, size_t size);
+
+        static void addSegment(FX_DOWNLOADHINTS *hints, size_t offset, size_t size);
+
+        static int getBlock(void *param, unsigned long position, unsigned char *outBuffer,
+                            unsigned long size);
+
+        // Called holding mLock
+        bool isAvailable(int64_t offset, int64_t size);
+
+        int mFd;
+        int64_t mLength;
+        int mReferences;
+        FileAvail mFileAvail;
+        DownloadHints mHints;
+        FPDF_FILEACCESS mFileAccess;
+        FPDF_AVAIL mAvail;
+        FPDF_DOCUMENT mDocument;
+        bool mDocumentOpened;
+
+        android::Mutex mLock;
+        // Disjoint ranges from start to end, merged when they touch
+        std::map<int64_t, int64_t> mAvailable;
+        std::map<int64_t, int64_t> mRequested;
+    };
+
+}
+#endif /* STREAM_SOURCE_H_ */
@@ -0,0 +1,116 @@
+#include "TileCache.h"
+
+#include <cstring>
+
+using namespace android;
+
+namespace tools {
+
+    bool TileKey::operator==(const TileKey &other) const {
+        return document == other.document && page == other.page &&
+               zoomBucket == other.zoomBucket && column == other.column && row == other.row &&
+               tileSize == other.tileSize && format == other.format && flags == other.flags &&
+               background == other.background;
+    }
+
+    size_t TileKeyHash::operator()(const TileKey &key) const {
+        uint64_t hash = (uint64_t) key.document;
+        const int32_t fields[] = {key.page, key.zoomBucket, key.column, key.row, key.tileSize,
+                                  key.format, key.flags, (int32_t) key.background};
+        for (int32_t field : fields) {
+            hash = hash * 31 + (uint32_t) field;
+        }
+        return (size_t) (hash ^ (hash >> 32));
+    }
+
+    TileCache::TileCache(size_t budgetBytes)
+            : mBudget(budgetBytes), mSize(0), mHits(0), mMisses(0), mEvictions(0) {
+    }
+
+    bool TileCache::get(const TileKey &key, void *dest, int destStride) {
+        AutoMutex lock(mLock);
+        auto found = mIndex.find(key);
+        if (found == mIndex.end()) {
+            mMisses++;
+            return false;
+        }
+        mHits++;
+        mEntries.splice(mEntries.begin(), mEntries, found->second);
+        const Entry &entry = *found->second;
+        const uint8_t *source = entry.pixels.data();
+        auto *target = (uint8_t *) dest;
+        for (int y = 0; y < entry.height; y++) {
+            memcpy(target, source, (size_t) entry.rowBytes);
+            source += entry.rowBytes;
+            target += destStride;
+        }
+        return true;
+    }
+
+    void TileCache::put(const TileKey &key, const void *source, int sourceStride, int width,
+                        int height, int bytesPerPixel) {
+        size_t rowBytes = (size_t) width * bytesPerPixel;
+        size_t size = rowBytes * height;
+        AutoMutex lock(mLock);
+        if (size > mBudget) {
+            return;
+        }
+        auto found = mIndex.find(key);
+        if (found != mIndex.end()) {
+            mSize -= found->second->pixels.size();
+            mEntries.erase(found->second);
+            mIndex.erase(found);
+        }
+        mEntries.push_front(Entry());
+        Entry &entry = mEntries.front();
+        entry.key = key;
+        entry.width = width;
+        entry.height = height;
+        entry.rowBytes = (int) rowBytes;
+        entry.pixels.resize(size);
+        auto *src = (const uint8_t *) source;
+        for (int y = 0; y < height; y++) {
+            memcpy(&entry.pixels[y * rowBytes], src, rowBytes);
+            src += sourceStride;
+        }
+        mIndex[key] = mEntries.begin();
+        mSize += size;
+        trimToBudget();
+    }
+
+    void TileCache::setBudget(size_t budgetBytes) {
+        AutoMutex lock(mLock);
+        mBudget = budgetBytes;
+        trimToBudget();
+    }
+
+    void TileCache::clear() {
+        AutoMutex lock(mLock);
+        mIndex.clear();
+        mEntries.clear();
+        mSize = 0;
+    }
+
+    TileCacheStats TileCache::getStats() {
+        AutoMutex lock(mLock);
+        TileCacheStats stats;
+        stats.hits = mHits;
+        stats.misses = mMisses;
+        stats.evictions = mEvictions;
+        stats.tileCount = (int64_t) mEntries.size();
+        stats.sizeBytes = (int64_t) mSize;
+        stats.budgetBytes = (int64_t) mBudget;
+        return stats;
+    }
+
+    void TileCache::trimToBudget() {
+        while (mSize > mBudget && !mEntries.empty()) {
+            Entry &oldest = mEntries.back();
+            mSize -= oldest.pixels.size();
+            mIndex.erase(oldest.key);
+            mEntries.pop_back();
+            mEvictions++;
+        }
+    }
+
+}
@@ -0,0 +1,96 @@
+#ifndef TILE_CACHE_H_
+#define TILE_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include <utils/Mutex.h>
+
+namespace tools {
+
+    // Identifies one rendered tile. The zoom is kept as a bucket of 1/TILE_ZOOM_BUCKETS steps,
+    // tiles are rendered at the bucket zoom so every zoom in a bucket produces the same pixels.
+    struct TileKey {
+        int64_t document;
+        int32_t page;
+        int32_t zoomBucket;
+        int32_t column;
+        int32_t row;
+        int32_t tileSize;
+        int32_t format;
+        int32_t flags;
+        uint32_t background;
+
+        bool operator==(const TileKey &other) const;
+    };
+
+    struct TileKeyHash {
+        size_t operator()(const TileKey &key) const;
+    };
+
+    const int TILE_ZOOM_BUCKETS = 1024;
+
+    inline int32_t zoomToBucket(float zoom) {
+        return (int32_t) (zoom * TILE_ZOOM_BUCKETS + 0.5f);
+    }
+
+    inline float bucketToZoom(int32_t bucket) {
+        return (float) bucket / TILE_ZOOM_BUCKETS;
+    }
+
+    struct TileCacheStats {
+        int64_t hits;
+        int64_t misses;
+        int64_t evictions;
+        int64_t tileCount;
+        int64_t sizeBytes;
+        int64_t budgetBytes;
+    };
+
+    // LRU cache of rendered tile pixels bounded by a byte budget. It never calls into pdfium,
+    // so lookups may run without holding the render lock.
+    class TileCache {
+    public:
+        explicit TileCache(size_t budgetBytes);
+
+        // Copy the tile into dest and mark it most recently used. Returns false on a miss.
+        bool get(const TileKey &key, void *dest, int destStride);
+
+        void put(const TileKey &key, const void *source, int sourceStride, int width, int height,
+                 int bytesPerPixel);
+
+        void setBudget(size_t budgetBytes);
+
+        void clear();
+
+        TileCacheStats getStats();
+
+    private:
+        struct Entry {
+            TileKey key;
+            int width;
+            int height;
+            int rowBytes;
+            std::vector<uint8_t> pixels;
+        };
+
+        typedef std::list<Entry> EntryList;
+
+        void trimToBudget();
+
+        android::Mutex mLock;
+        EntryList mEntries;
+        std::unordered_map<TileKey, EntryList::iterator, TileKeyHash> mIndex;
+        size_t mBudget;
+        size_t mSize;
+        int64_t mHits;
+        int64_t mMisses;
+        int64_t mEvictions;
+    };
+
+}
+#endif /* TILE_CACHE_H_ */
@@ -1,12 +1,25 @@
 #include "PdfUtils.h"
 #include "JNIHelp.h"
+#include "FileSource.h"
+#include "ImageEncoder.h"
+#include "MappedRender.h"
+#include "PageRender.h"
+#include "PixelConvert.h"
+#include "RenderPyramid.h"
+#include "RenderQueue.h"
+#include "RenderWorkers.h"
+#include "ScratchPool.h"
+#include "StreamSource.h"
+#include "TileCache.h"
 
 #include "util.hpp"
 
 extern "C" {
+#include <dlfcn.h>
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <cstring>
 #include <cstdio>
 }
@@ -20,7 +33,14 @@ using namespace android;
 using namespace tools;
 
 #include <fpdfview.h>
+#include <fpdf_dataavail.h>
 #include <fpdf_doc.h>
+#include <fpdf_progressive.h>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <map>
+#include <new>
 #include <string>
 #include <vector>
 #include <fpdf_text.h>
@@ -41,6 +61,19 @@ static struct {
 static jclass gRectFClass;
 static jclass gStringClass;
 static jmethodID gStringMethodGetBytes;
+// What an open document reads from, released when the document is closed
+struct DocumentSource {
+    FileSource *file;
+    // Copy of a byte array
+    jbyte *copy;
+    // Direct buffer read in place, kept reachable while the document is open
+    jobject buffer;
+    // Download the document was opened from, shared with its loader
+    StreamSource *stream;
+};
+
+// Sources of the open documents, only used holding the render lock
+static std::map<FPDF_DOCUMENT, DocumentSource> gDocumentSources;
 
 static struct rgb {
     uint8_t red;
@@ -48,6 +81,39 @@ static struct rgb {
     uint8_t blue;
 };
 
+// Progressive render status, mirrored by PdfDocument.RenderToken.STATUS_*
+enum {
+    RENDER_STATUS_COMPLETE = 0,
+    RENDER_STATUS_PARTIAL = 1,
+    RENDER_STATUS_CANCELLED = 2,
+    RENDER_STATUS_FAILED = 3
+};
+
+// Holds one progressive render. While a render is in progress the target bitmap stays locked and
+// pdfium keeps its render context on the page, so both are released only once the render is
+// finished, cancelled or aborted.
+struct RenderToken {
+    IFSDK_PAUSE pause;
+    std::atomic<bool> cancelled;
+    int64_t deadline;
+    FPDF_PAGE page;
+    FPDF_BITMAP pdfBitmap;
+    jobject bitmap;
+    void *addr;
+    void *tmp;
+    size_t tmpCapacity;
+    int sourceStride;
+    AndroidBitmapInfo info;
+};
+
+// A Surface kept open across frames. The window reference, its format and its size are set up
+// once instead of on every frame.
+struct SurfaceSession {
+    ANativeWindow *window;
+    int32_t width;
+    int32_t height;
+};
+
 static void setRectF(JNIEnv *env,jobject outRectF, float l,float t,float r,float b){
     env->SetFloatField(outRectF, gRectFClassInfo.left, l);
     env->SetFloatField(outRectF, gRectFClassInfo.top, t);
@@ -95,23 +161,205 @@ static inline long getFileSize(int fd) {
     }
 }
 
-static uint16_t rgbTo565(rgb *color) {
-    return ((color->red >> 3) << 11) | ((color->green >> 2) << 5) | (color->blue >> 3);
+static void releaseDocumentSource(JNIEnv *env, const DocumentSource &source) {
+    delete source.file;
+    delete[] source.copy;
+    if (source.buffer != nullptr) {
+        env->DeleteGlobalRef(source.buffer);
+    }
+    if (source.stream != nullptr) {
+        source.stream->detachDocument();
+        source.stream->release();
+    }
+}
+
+// Load a document from memory which stays valid until the document is closed. The source is
+// released here if loading fails.
+static jlong openMemoryDocument(JNIEnv *env, const void *data, jlong size, jstring password,
+                                const DocumentSource &source) {
+    if (size <= 0 || size > INT_MAX) {
+        releaseDocumentSource(env, source);
+        jniThrowException(env, "java/io/IOException",
+                          size <= 0 ? "File is empty" : "File too large to open from memory");
+        return -1;
+    }
+    if (!initializeLibraryIfNeeded(env)) {
+        releaseDocumentSource(env, source);
+        return -1;
+    }
+    const char *cpassword = nullptr;
+    if (password != nullptr) {
+        cpassword = env->GetStringUTFChars(password, nullptr);
+    }
+    FPDF_DOCUMENT document = FPDF_LoadMemDocument(data, (int) size, cpassword);
+    if (nullptr != cpassword) {
+        env->ReleaseStringUTFChars(password, cpassword);
+    }
+    if (!document) {
+        releaseDocumentSource(env, source);
+        forwardPdfiumError(env);
+        destroyLibraryIfNeeded(env, false);
+        return -1;
+    }
+    gDocumentSources[document] = source;
+    return reinterpret_cast<jlong>(document);
 }
 
 static void rgbBitmapTo565(void *source, int sourceStride, void *dest, AndroidBitmapInfo *info) {
-    rgb *srcLine;
-    uint16_t *dstLine;
-    int y, x;
-    for (y = 0; y < info->height; y++) {
-        srcLine = (rgb *) source;
-        dstLine = (uint16_t *) dest;
-        for (x = 0; x < info->width; x++) {
-            dstLine[x] = rgbTo565(&srcLine[x]);
-        }
-        source = (char *) source + sourceStride;
-        dest = (char *) dest + info->stride;
+    rgb24To565(source, sourceStride, dest, info->stride, info->width, info->height);
+}
+
+static int64_t monotonicNanos() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static FPDF_BOOL needToPauseNow(IFSDK_PAUSE *pause) {
+    auto token = reinterpret_cast<RenderToken *>(pause->user);
+    if (token->cancelled.load()) {
+        return 1;
+    }
+    return token->deadline != 0 && monotonicNanos() >= token->deadline;
+}
+
+static void finishProgressiveRender(JNIEnv *env, RenderToken *token, bool completed) {
+    if (token->page == nullptr) {
+        return;
+    }
+    FPDF_RenderPage_Close(token->page);
+    if (completed && token->info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
+        rgbBitmapTo565(token->tmp, token->sourceStride, token->addr, &token->info);
+    }
+    if (token->tmp != token->addr) {
+        releaseScratch(token->tmp, token->tmpCapacity);
+    }
+    FPDFBitmap_Destroy(token->pdfBitmap);
+    AndroidBitmap_unlockPixels(env, token->bitmap);
+    env->DeleteGlobalRef(token->bitmap);
+    token->page = nullptr;
+    token->pdfBitmap = nullptr;
+    token->bitmap = nullptr;
+    token->addr = nullptr;
+    token->tmp = nullptr;
+}
+
+static bool lockTileAtlas(JNIEnv *env, jobject atlas, int tileSize, int tileCount,
+                          AndroidBitmapInfo *info, void **addr) {
+    int ret;
+    if ((ret = AndroidBitmap_getInfo(env, atlas, info)) < 0) {
+        LOGE("Fetching bitmap info failed: %s", strerror(ret * -1));
+        return false;
     }
+
+    if (info->format != ANDROID_BITMAP_FORMAT_RGBA_8888 &&
+        info->format != ANDROID_BITMAP_FORMAT_RGB_565) {
+        LOGE("Bitmap format must be RGBA_8888 or RGB_565");
+        return false;
+    }
+
+    int slotCount = (info->width / tileSize) * (info->height / tileSize);
+    if (slotCount < tileCount) {
+        LOGE("Atlas holds %d tiles, %d requested", slotCount, tileCount);
+        return false;
+    }
+
+    if ((ret = AndroidBitmap_lockPixels(env, atlas, addr)) != 0) {
+        LOGE("Locking bitmap failed: %s", strerror(ret * -1));
+        return false;
+    }
+    return true;
+}
+
+// Slots of a tile atlas are counted left to right, top to bottom
+static char *tileSlot(void *addr, const AndroidBitmapInfo &info, int tileSize, int slot) {
+    int bytesPerPixel = info.format == ANDROID_BITMAP_FORMAT_RGB_565 ? 2 : 4;
+    int slotColumns = info.width / tileSize;
+    return (char *) addr + (slot / slotColumns) * tileSize * info.stride
+           + (slot % slotColumns) * tileSize * bytesPerPixel;
+}
+
+// Above the RENDER_FLAG_* bits of a tile key
+static const int32_t TILE_KEY_ANNOT = 1 << 30;
+
+// The render options, pdfium's flags do not tell dithered or transparent tiles apart
+static TileKey makeTileKey(jlong documentId, jint pageIndex, int32_t zoomBucket, jint column,
+                           jint row, jint tileSize, int32_t format, jboolean renderAnnot,
+                           jint renderFlags, jlong backgroundColor) {
+    TileKey key;
+    key.document = documentId;
+    key.page = pageIndex;
+    key.zoomBucket = zoomBucket;
+    key.column = column;
+    key.row = row;
+    key.tileSize = tileSize;
+    key.format = format;
+    key.flags = renderFlags | (renderAnnot != JNI_FALSE ? TILE_KEY_ANNOT : 0);
+    key.background = (uint32_t) backgroundColor;
+    return key;
+}
+
+static bool lockRenderBitmap(JNIEnv *env, jobject bitmap, AndroidBitmapInfo *info,
+                             void **addr) {
+    int ret;
+    if ((ret = AndroidBitmap_getInfo(env, bitmap, info)) < 0) {
+        LOGE("Fetching bitmap info failed: %s", strerror(ret * -1));
+        return false;
+    }
+
+    if (info->format != ANDROID_BITMAP_FORMAT_RGBA_8888 &&
+        info->format != ANDROID_BITMAP_FORMAT_RGB_565 &&
+        info->format != ANDROID_BITMAP_FORMAT_A_8) {
+        LOGE("Bitmap format must be RGBA_8888, RGB_565 or ALPHA_8");
+        return false;
+    }
+
+    if ((ret = AndroidBitmap_lockPixels(env, bitmap, addr)) != 0) {
+        LOGE("Locking bitmap failed: %s", strerror(ret * -1));
+        return false;
+    }
+    return true;
+}
+
+// The locked pixels of an RGBA_8888, RGB_565 or ALPHA_8 bitmap
+static RenderTarget bitmapTarget(void *addr, const AndroidBitmapInfo &info) {
+    RenderTarget target;
+    target.pixels = addr;
+    target.width = info.width;
+    target.height = info.height;
+    target.stride = info.stride;
+    if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
+        target.format = PIXEL_FORMAT_RGB_565;
+    } else if (info.format == ANDROID_BITMAP_FORMAT_A_8) {
+        // ALPHA_8 holds the luminance, pdfium renders it directly at one byte per pixel
+        target.format = PIXEL_FORMAT_GRAY_8;
+    } else {
+        target.format = PIXEL_FORMAT_RGBA_8888;
+    }
+    return target;
+}
+
+static bool renderPageToPixels(FPDF_PAGE page, void *addr, const AndroidBitmapInfo &info,
+                               int startX, int startY, int drawSizeHor, int drawSizeVer,
+                               jlong backgroundColor, jboolean renderAnnot, jint renderFlags) {
+    return renderPage(page, bitmapTarget(addr, info), startX, startY, drawSizeHor, drawSizeVer,
+                      (uint32_t) backgroundColor, renderAnnot != JNI_FALSE, renderFlags);
+}
+
+static void updateSurfaceGeometry(SurfaceSession *session) {
+    session->width = ANativeWindow_getWidth(session->window);
+    session->height = ANativeWindow_getHeight(session->window);
+    if (ANativeWindow_getFormat(session->window) != WINDOW_FORMAT_RGBA_8888) {
+        LOGD("Set format to RGBA_8888");
+        ANativeWindow_setBuffersGeometry(session->window, session->width, session->height,
+                                         WINDOW_FORMAT_RGBA_8888);
+    }
+}
+
+// FPDFBitmap_FillRect takes ARGB and writes it in BGRA order, bitmaps rendered with
+// FPDF_REVERSE_BYTE_ORDER and the window buffer are RGBA
+static inline uint32_t argbToAbgr(uint32_t color) {
+    return (color & 0xFF00FF00) | ((color & 0xFF) << 16) | ((color >> 16) & 0xFF);
 }
 
 static FPDF_WIDESTRING GetStringUTF16LEChars(JNIEnv *env, jstring str) {
@@ -201,15 +449,17 @@ JNI_FUNC(jlong, PdfDocument, nativeOpenPageAndGetSize)(JNI_ARGS, jlong documentP
     return reinterpret_cast<jlong>(page);
 }
 
-JNI_FUNC(jlong, PdfDocument, nativeOpen)(JNI_ARGS, jint fd, jlong size, jstring password) {
+// The document is size bytes from offset on
+JNI_FUNC(jlong, PdfDocument, nativeOpen)(JNI_ARGS, jint fd, jlong offset, jlong size,
+                                         jstring password, jint fileAccess) {
     bool isInitialized = initializeLibraryIfNeeded(env);
     if (!isInitialized) {
         return -1;
     }
+    auto source = new FileSource(fd, offset, size);
+    source->open(fileAccess);
     FPDF_FILEACCESS loader;
-    loader.m_FileLen = static_cast<unsigned long>(size);
-    loader.m_Param = reinterpret_cast<void *>(intptr_t(fd));
-    loader.m_GetBlock = &getBlock;
+    source->getFileAccess(&loader);
     const char *cpassword = nullptr;
     if (password != nullptr) {
         cpassword = env->GetStringUTFChars(password, nullptr);
@@ -218,42 +468,162 @@ JNI_FUNC(jlong, PdfDocument, nativeOpen)(JNI_ARGS, jint fd, jlong size, jstring
     if (nullptr != cpassword) {
         env->ReleaseStringUTFChars(password, cpassword);
     }
-    HANDLE_PDFIUM_ERROR_STATE_WITH_RET_CODE(env, -1)
     if (!document) {
+        delete source;
         forwardPdfiumError(env);
         destroyLibraryIfNeeded(env, false);
         return -1;
     }
+    DocumentSource documentSource = {source, nullptr, nullptr, nullptr};
+    gDocumentSources[document] = documentSource;
 
     return reinterpret_cast<jlong>(document);
 }
 
 JNI_FUNC(jlong, PdfDocument, nativeOpenByteArray)(JNI_ARGS, jbyteArray data, jstring password) {
+    jsize size = env->GetArrayLength(data);
+    // pdfium reads the document in place, so it needs a copy which outlives the call. It is
+    // filled directly instead of through GetByteArrayElements, which may copy on its own.
+    auto copy = new (std::nothrow) jbyte[size > 0 ? size : 1];
+    if (copy == nullptr) {
+        jniThrowException(env, "java/lang/OutOfMemoryError", "Cannot copy document");
+        return -1;
+    }
+    env->GetByteArrayRegion(data, 0, size, copy);
+    DocumentSource source = {nullptr, copy, nullptr, nullptr};
+    return openMemoryDocument(env, copy, size, password, source);
+}
+
+JNI_FUNC(jlong, PdfDocument, nativeOpenDirectBuffer)(JNI_ARGS, jobject buffer, jint offset,
+                                                     jint length, jstring password) {
+    auto address = reinterpret_cast<const jbyte *>(env->GetDirectBufferAddress(buffer));
+    if (address == nullptr) {
+        jniThrowException(env, "java/lang/IllegalArgumentException", "Buffer is not direct");
+        return -1;
+    }
+    DocumentSource source = {nullptr, nullptr, env->NewGlobalRef(buffer), nullptr};
+    return openMemoryDocument(env, address + offset, length, password, source);
+}
+
+// Must be called holding the render lock
+JNI_FUNC(jlong, PdfDocument, nativeCreateStreamSource)(JNIEnv *env, jclass, jint fd,
+                                                       jlong length) {
+    int ownFd = dup(fd);
+    if (ownFd < 0) {
+        jniThrowException(env, "java/io/IOException", "Cannot duplicate file descriptor");
+        return 0;
+    }
+    if (!initializeLibraryIfNeeded(env)) {
+        close(ownFd);
+        return 0;
+    }
+    auto stream = new StreamSource(ownFd, length);
+    if (!stream->create()) {
+        stream->release();
+        destroyLibraryIfNeeded(env, false);
+        jniThrowException(env, "java/io/IOException", "Cannot create availability provider");
+        return 0;
+    }
+    return reinterpret_cast<jlong>(stream);
+}
+
+// Must be called holding the render lock, an open document keeps the source alive
+JNI_FUNC(void, PdfDocument, nativeReleaseStreamSource)(JNIEnv *env, jclass, jlong streamPtr) {
+    reinterpret_cast<StreamSource *>(streamPtr)->release();
+    destroyLibraryIfNeeded(env, false);
+}
+
+JNI_FUNC(void, PdfDocument, nativeAddAvailableRange)(JNIEnv *env, jclass, jlong streamPtr,
+                                                     jlong offset, jlong length) {
+    reinterpret_cast<StreamSource *>(streamPtr)->addAvailableRange(offset, length);
+}
+
+JNI_FUNC(jlongArray, PdfDocument, nativeGetRequestedRanges)(JNIEnv *env, jclass,
+                                                            jlong streamPtr) {
+    std::vector<int64_t> ranges = reinterpret_cast<StreamSource *>(streamPtr)->getRequestedRanges();
+    jlongArray result = env->NewLongArray((jsize) ranges.size());
+    if (result == nullptr) {
+        return nullptr;
+    }
+    std::vector<jlong> values(ranges.begin(), ranges.end());
+    env->SetLongArrayRegion(result, 0, (jsize) values.size(), values.data());
+    return result;
+}
+
+// Must be called holding the render lock. Returns 0 while the data needed to open the document
+// has not arrived yet.
+JNI_FUNC(jlong, PdfDocument, nativeOpenStreamDocument)(JNIEnv *env, jclass, jlong streamPtr,
+                                                       jstring password) {
+    auto stream = reinterpret_cast<StreamSource *>(streamPtr);
+    int status = stream->isDocumentAvailable();
+    if (status == PDF_DATA_NOTAVAIL) {
+        return 0;
+    }
+    if (status != PDF_DATA_AVAIL) {
+        jniThrowException(env, "java/io/IOException", "file not in PDF format or corrupted");
+        return 0;
+    }
+    if (!initializeLibraryIfNeeded(env)) {
+        return 0;
+    }
     const char *cpassword = nullptr;
     if (password != nullptr) {
         cpassword = env->GetStringUTFChars(password, nullptr);
     }
-    jbyte *cData = env->GetByteArrayElements(data, nullptr);
-    int size = (int) env->GetArrayLength(data);
-    auto *cDataCopy = new jbyte[size];
-    memcpy(cDataCopy, cData, static_cast<size_t>(size));
-    FPDF_DOCUMENT document = FPDF_LoadMemDocument(reinterpret_cast<const void *>(cDataCopy), size,
-                                                  cpassword);
-    env->ReleaseByteArrayElements(data, cData, JNI_ABORT);
+    FPDF_DOCUMENT document = stream->getDocument(cpassword);
     if (nullptr != cpassword) {
         env->ReleaseStringUTFChars(password, cpassword);
     }
-    HANDLE_PDFIUM_ERROR_STATE_WITH_RET_CODE(env, -1)
+    if (!document) {
+        forwardPdfiumError(env);
+        destroyLibraryIfNeeded(env, false);
+        return 0;
+    }
+    stream->acquire();
+    DocumentSource source = {nullptr, nullptr, nullptr, stream};
+    gDocumentSources[document] = source;
     return reinterpret_cast<jlong>(document);
 }
 
+// Must be called holding the render lock
+JNI_FUNC(jboolean, PdfDocument, nativeIsStreamPageAvailable)(JNIEnv *env, jclass,
+                                                             jlong streamPtr, jint pageIndex) {
+    auto stream = reinterpret_cast<StreamSource *>(streamPtr);
+    return static_cast<jboolean>(stream->isPageAvailable(pageIndex) == PDF_DATA_AVAIL);
+}
+
+// Must be called holding the render lock
+JNI_FUNC(jboolean, PdfDocument, nativeIsStreamLinearized)(JNIEnv *env, jclass, jlong streamPtr) {
+    auto stream = reinterpret_cast<StreamSource *>(streamPtr);
+    return static_cast<jboolean>(stream->isLinearized() == PDF_LINEARIZED);
+}
+
 JNI_FUNC(void, PdfDocument, nativeClose)(JNI_ARGS, jlong documentPtr) {
     auto document = reinterpret_cast<FPDF_DOCUMENT>(documentPtr);
     FPDF_CloseDocument(document);
+    auto source = gDocumentSources.find(document);
+    if (source != gDocumentSources.end()) {
+        releaseDocumentSource(env, source->second);
+        gDocumentSources.erase(source);
+    }
     HANDLE_PDFIUM_ERROR_STATE(env)
     destroyLibraryIfNeeded(env, true);
 }
 
+// Must be called holding the render lock
+JNI_FUNC(jboolean, PdfDocument, nativeGetFileAccessStats)(JNIEnv *env, jclass, jlong documentPtr,
+                                                          jlongArray outStats) {
+    auto source = gDocumentSources.find(reinterpret_cast<FPDF_DOCUMENT>(documentPtr));
+    if (source == gDocumentSources.end() || source->second.file == nullptr) {
+        return JNI_FALSE;
+    }
+    FileSourceStats stats = source->second.file->getStats();
+    jlong values[] = {stats.mapped ? 1 : 0, stats.reads, stats.bytesRead, stats.syscalls,
+                      stats.cacheHits, stats.cacheMisses, stats.readaheadBlocks};
+    env->SetLongArrayRegion(outStats, 0, 7, values);
+    return JNI_TRUE;
+}
+
 JNI_FUNC(jboolean, PdfDocument, nativeScaleForPrinting)(JNI_ARGS, jlong documentPtr) {
     auto document = reinterpret_cast<FPDF_DOCUMENT>(documentPtr);
     FPDF_BOOL printScaling = FPDF_VIEWERREF_GetPrintScaling(document);
@@ -317,11 +687,7 @@ JNI_FUNC(void, PdfDocument, nativeRenderPage)(JNI_ARGS, jlong pagePtr, jobject o
                                                 buffer.bits,
                                                 (int) (buffer.stride) * 4);
     HANDLE_PDFIUM_ERROR_STATE(env)
-    int flags = FPDF_REVERSE_BYTE_ORDER | FPDF_LCD_TEXT;
-
-    if (renderAnnot) {
-        flags |= FPDF_ANNOT;
-    }
+    int flags = pdfiumRenderFlags(renderAnnot, 0);
     FPDF_RenderPageBitmap(pdfBitmap, page,
                           startX, startY,
                           drawSizeHor, drawSizeVer,
@@ -331,11 +697,105 @@ JNI_FUNC(void, PdfDocument, nativeRenderPage)(JNI_ARGS, jlong pagePtr, jobject o
     HANDLE_PDFIUM_ERROR_STATE(env)
 }
 
+JNI_FUNC(jlong, PdfDocument, nativeOpenSurfaceSession)(JNIEnv *env, jclass, jobject objSurface) {
+    // ANativeWindow_fromSurface acquires a reference which the session keeps until it is closed
+    ANativeWindow *nativeWindow = ANativeWindow_fromSurface(env, objSurface);
+    if (nativeWindow == nullptr) {
+        LOGE("native window pointer null");
+        return 0;
+    }
+    auto session = new SurfaceSession();
+    session->window = nativeWindow;
+    updateSurfaceGeometry(session);
+    return reinterpret_cast<jlong>(session);
+}
+
+JNI_FUNC(void, PdfDocument, nativeUpdateSurfaceSession)(JNIEnv *env, jclass, jlong sessionPtr) {
+    updateSurfaceGeometry(reinterpret_cast<SurfaceSession *>(sessionPtr));
+}
+
+JNI_FUNC(void, PdfDocument, nativeCloseSurfaceSession)(JNIEnv *env, jclass, jlong sessionPtr) {
+    auto session = reinterpret_cast<SurfaceSession *>(sessionPtr);
+    ANativeWindow_release(session->window);
+    delete session;
+}
+
+JNI_FUNC(jboolean, PdfDocument, nativeRenderSurfaceSession)(JNIEnv *env, jclass, jlong sessionPtr,
+                                                            jlong pagePtr, jint startX,
+                                                            jint startY, jint drawSizeHor,
+                                                            jint drawSizeVer,
+                                                            jlong backgroundColor,
+                                                            jboolean renderAnnot,
+                                                            jint renderFlags,
+                                                            jintArray dirtyBounds) {
+    auto session = reinterpret_cast<SurfaceSession *>(sessionPtr);
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if (session == nullptr || page == nullptr) {
+        LOGE("Render page pointers invalid");
+        return JNI_FALSE;
+    }
+
+    ARect dirty;
+    ARect *inOutDirty = nullptr;
+    if (dirtyBounds != nullptr) {
+        jint bounds[4];
+        env->GetIntArrayRegion(dirtyBounds, 0, 4, bounds);
+        dirty.left = bounds[0];
+        dirty.top = bounds[1];
+        dirty.right = bounds[2];
+        dirty.bottom = bounds[3];
+        inOutDirty = &dirty;
+    }
+
+    ANativeWindow_Buffer buffer;
+    int ret;
+    if ((ret = ANativeWindow_lock(session->window, &buffer, inOutDirty)) != 0) {
+        LOGE("Locking native window failed: %s", strerror(ret * -1));
+        return JNI_FALSE;
+    }
+
+    // The window may grow the dirty region, e.g. when the previous buffer cannot be reused.
+    // Pixels outside of it still hold the last posted frame.
+    if (inOutDirty == nullptr) {
+        dirty.left = 0;
+        dirty.top = 0;
+        dirty.right = buffer.width;
+        dirty.bottom = buffer.height;
+    } else {
+        dirty.left = std::max(0, dirty.left);
+        dirty.top = std::max(0, dirty.top);
+        dirty.right = std::min(buffer.width, dirty.right);
+        dirty.bottom = std::min(buffer.height, dirty.bottom);
+    }
+
+    int dirtyWidth = dirty.right - dirty.left;
+    int dirtyHeight = dirty.bottom - dirty.top;
+    if (dirtyWidth > 0 && dirtyHeight > 0) {
+        int stride = buffer.stride * 4;
+        void *origin = (char *) buffer.bits + dirty.top * stride + dirty.left * 4;
+        FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx(dirtyWidth, dirtyHeight, FPDFBitmap_BGRA,
+                                                    origin, stride);
+        FPDFBitmap_FillRect(pdfBitmap, 0, 0, dirtyWidth, dirtyHeight,
+                            argbToAbgr((uint32_t) backgroundColor));
+        int flags = pdfiumRenderFlags(renderAnnot, renderFlags);
+        FPDF_RenderPageBitmap(pdfBitmap, page, startX - dirty.left, startY - dirty.top,
+                              drawSizeHor, drawSizeVer, 0, flags);
+        FPDFBitmap_Destroy(pdfBitmap);
+    }
+    ANativeWindow_unlockAndPost(session->window);
+
+    if (dirtyBounds != nullptr) {
+        jint bounds[] = {dirty.left, dirty.top, dirty.right, dirty.bottom};
+        env->SetIntArrayRegion(dirtyBounds, 0, 4, bounds);
+    }
+    return JNI_TRUE;
+}
+
 JNI_FUNC(void, PdfDocument, nativeRenderPageBitmap)(JNI_ARGS, jlong pagePtr, jobject bitmap,
                                                     jint startX, jint startY,
                                                     jint drawSizeHor, jint drawSizeVer,
                                                     jlong backgroundColor,
-                                                    jboolean renderAnnot) {
+                                                    jboolean renderAnnot, jint renderFlags) {
 
     auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
 
@@ -345,68 +805,750 @@ JNI_FUNC(void, PdfDocument, nativeRenderPageBitmap)(JNI_ARGS, jlong pagePtr, job
     }
 
     AndroidBitmapInfo info;
-    int ret;
-    if ((ret = AndroidBitmap_getInfo(env, bitmap, &info)) < 0) {
-        LOGE("Fetching bitmap info failed: %s", strerror(ret * -1));
+    void *addr;
+    if (!lockRenderBitmap(env, bitmap, &info, &addr)) {
         return;
     }
 
-    if (info.format != ANDROID_BITMAP_FORMAT_RGBA_8888 &&
-        info.format != ANDROID_BITMAP_FORMAT_RGB_565) {
-        LOGE("Bitmap format must be RGBA_8888 or RGB_565");
-        return;
+    renderPageToPixels(page, addr, info, startX, startY, drawSizeHor, drawSizeVer,
+                       backgroundColor, renderAnnot, renderFlags);
+    AndroidBitmap_unlockPixels(env, bitmap);
+    HANDLE_PDFIUM_ERROR_STATE(env)
+}
+
+JNI_FUNC(jboolean, PdfDocument, nativeRenderPageBuffer)(JNI_ARGS, jlong pagePtr, jobject buffer,
+                                                        jint width, jint height, jint stride,
+                                                        jint format, jint startX, jint startY,
+                                                        jint drawSizeHor, jint drawSizeVer,
+                                                        jlong backgroundColor,
+                                                        jboolean renderAnnot, jint renderFlags) {
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if (page == nullptr || buffer == nullptr) {
+        LOGE("Render page pointers invalid");
+        return JNI_FALSE;
+    }
+
+    RenderTarget target;
+    target.pixels = env->GetDirectBufferAddress(buffer);
+    target.width = width;
+    target.height = height;
+    target.stride = stride;
+    target.format = format;
+    size_t size = targetSize(target);
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (size == 0 || capacity < 0 || (size_t) capacity < size) {
+        LOGE("Render buffer invalid or too small for %dx%d stride %d format %d", width, height,
+             stride, format);
+        return JNI_FALSE;
+    }
+
+    bool rendered = renderPage(page, target, startX, startY, drawSizeHor, drawSizeVer,
+                               (uint32_t) backgroundColor, renderAnnot != JNI_FALSE, renderFlags);
+    return static_cast<jboolean>(rendered);
+}
+
+JNI_FUNC(jboolean, PdfDocument, nativeEncodePage)(JNIEnv *env, jclass, jlong pagePtr, jint fd,
+                                                  jint imageFormat, jint quality, jint width,
+                                                  jint height, jint startX, jint startY,
+                                                  jint drawSizeHor, jint drawSizeVer,
+                                                  jlong backgroundColor, jboolean renderAnnot,
+                                                  jint renderFlags) {
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if (page == nullptr) {
+        LOGE("Render page pointers invalid");
+        return JNI_FALSE;
+    }
+    if (!encodePage(page, fd, imageFormat, quality, width, height, startX, startY, drawSizeHor,
+                    drawSizeVer, (uint32_t) backgroundColor, renderAnnot != JNI_FALSE,
+                    renderFlags)) {
+        LOGE("Encoding %dx%d page as image format %d failed", width, height, imageFormat);
+        return JNI_FALSE;
+    }
+    return JNI_TRUE;
+}
+
+// Returns the descriptor of the rendered file, -1 on failure. outLayout receives width, height,
+// stride, format, the offset of the first row and the size of the rows.
+JNI_FUNC(jint, PdfDocument, nativeRenderPageToFile)(JNIEnv *env, jclass, jlong pagePtr,
+                                                    jstring tempDir, jint width, jint height,
+                                                    jint format, jint startX, jint startY,
+                                                    jint drawSizeHor, jint drawSizeVer,
+                                                    jlong backgroundColor, jboolean renderAnnot,
+                                                    jint renderFlags, jlongArray outLayout) {
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if (page == nullptr) {
+        LOGE("Render page pointers invalid");
+        return -1;
     }
 
+    const char *ctempDir = nullptr;
+    if (tempDir != nullptr) {
+        ctempDir = env->GetStringUTFChars(tempDir, nullptr);
+    }
+    MappedRenderHeader header;
+    int fd = renderPageToFile(page, ctempDir, width, height, format, startX, startY,
+                              drawSizeHor, drawSizeVer, (uint32_t) backgroundColor,
+                              renderAnnot != JNI_FALSE, renderFlags, &header);
+    if (ctempDir != nullptr) {
+        env->ReleaseStringUTFChars(tempDir, ctempDir);
+    }
+    if (fd < 0) {
+        LOGE("Render to file failed for %dx%d format %d", width, height, format);
+        return -1;
+    }
+
+    jlong values[] = {header.width, header.height, header.stride, header.format,
+                      (jlong) header.dataOffset, (jlong) header.dataSize};
+    env->SetLongArrayRegion(outLayout, 0, 6, values);
+    return fd;
+}
+
+JNI_FUNC(jboolean, PdfDocument, nativeRenderPageScrolled)(JNIEnv *env, jclass, jlong pagePtr,
+                                                          jobject bitmap, jint deltaX,
+                                                          jint deltaY, jint startX, jint startY,
+                                                          jint drawSizeHor, jint drawSizeVer,
+                                                          jlong backgroundColor,
+                                                          jboolean renderAnnot,
+                                                          jint renderFlags) {
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    if (page == nullptr || bitmap == nullptr) {
+        LOGE("Render page pointers invalid");
+        return JNI_FALSE;
+    }
+
+    AndroidBitmapInfo info;
     void *addr;
-    if ((ret = AndroidBitmap_lockPixels(env, bitmap, &addr)) != 0) {
-        LOGE("Locking bitmap failed: %s", strerror(ret * -1));
+    if (!lockRenderBitmap(env, bitmap, &info, &addr)) {
+        return JNI_FALSE;
+    }
+    bool rendered = scrollPage(page, bitmapTarget(addr, info), deltaX, deltaY, startX, startY,
+                               drawSizeHor, drawSizeVer, (uint32_t) backgroundColor,
+                               renderAnnot != JNI_FALSE, renderFlags);
+    AndroidBitmap_unlockPixels(env, bitmap);
+    return static_cast<jboolean>(rendered);
+}
+
+JNI_FUNC(void, PdfDocument, nativeRenderPages)(JNI_ARGS, jlong documentPtr,
+                                               jintArray pageIndices, jobjectArray bitmaps,
+                                               jintArray viewports, jlong backgroundColor,
+                                               jboolean renderAnnot, jint renderFlags,
+                                               jlong tokenPtr, jintArray outStatus,
+                                               jlongArray outNanos) {
+    auto document = reinterpret_cast<FPDF_DOCUMENT>(documentPtr);
+    auto token = reinterpret_cast<RenderToken *>(tokenPtr);
+    if (document == nullptr || pageIndices == nullptr || bitmaps == nullptr ||
+        viewports == nullptr || outStatus == nullptr || outNanos == nullptr) {
+        LOGE("Render pages arguments invalid");
+        return;
+    }
+    jsize jobCount = env->GetArrayLength(pageIndices);
+    if (env->GetArrayLength(bitmaps) < jobCount ||
+        env->GetArrayLength(viewports) < jobCount * 4 ||
+        env->GetArrayLength(outStatus) < jobCount || env->GetArrayLength(outNanos) < jobCount) {
+        LOGE("Render pages arrays too short");
         return;
     }
 
-    void *tmp;
-    int format;
-    int sourceStride;
-    int canvasHorSize = info.width;
-    int canvasVerSize = info.height;
-    if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
-        tmp = malloc(canvasVerSize * canvasHorSize * sizeof(rgb));
-        sourceStride = canvasHorSize * sizeof(rgb);
-        format = FPDFBitmap_BGR;
-    } else {
-        tmp = addr;
-        sourceStride = info.stride;
-        format = FPDFBitmap_BGRA;
+    std::vector<jint> indices((size_t) jobCount);
+    std::vector<jint> rects((size_t) jobCount * 4);
+    std::vector<jint> status((size_t) jobCount, RENDER_STATUS_FAILED);
+    std::vector<jlong> nanos((size_t) jobCount, 0);
+    env->GetIntArrayRegion(pageIndices, 0, jobCount, indices.data());
+    env->GetIntArrayRegion(viewports, 0, jobCount * 4, rects.data());
+
+    // Consecutive jobs on the same page share one loaded page
+    FPDF_PAGE page = nullptr;
+    int loadedIndex = -1;
+    for (jsize i = 0; i < jobCount; i++) {
+        if (token != nullptr && token->cancelled.load()) {
+            for (jsize j = i; j < jobCount; j++) {
+                status[j] = RENDER_STATUS_CANCELLED;
+            }
+            break;
+        }
+        int64_t jobStart = monotonicNanos();
+        if (indices[i] != loadedIndex) {
+            if (page != nullptr) {
+                FPDF_ClosePage(page);
+            }
+            page = FPDF_LoadPage(document, indices[i]);
+            loadedIndex = page != nullptr ? indices[i] : -1;
+        }
+        jobject bitmap = env->GetObjectArrayElement(bitmaps, i);
+        AndroidBitmapInfo info;
+        void *addr;
+        if (page == nullptr) {
+            LOGE("Cannot load page %d", indices[i]);
+        } else if (bitmap != nullptr && lockRenderBitmap(env, bitmap, &info, &addr)) {
+            const jint *viewport = &rects[i * 4];
+            if (renderPageToPixels(page, addr, info, viewport[0], viewport[1], viewport[2],
+                                   viewport[3], backgroundColor, renderAnnot, renderFlags)) {
+                status[i] = RENDER_STATUS_COMPLETE;
+            }
+            AndroidBitmap_unlockPixels(env, bitmap);
+        }
+        if (bitmap != nullptr) {
+            env->DeleteLocalRef(bitmap);
+        }
+        nanos[i] = monotonicNanos() - jobStart;
+    }
+    if (page != nullptr) {
+        FPDF_ClosePage(page);
     }
+    // A failed page load leaves its error behind, it is reported per job
+    FPDF_GetLastError();
 
-    FPDF_BITMAP pdfBitmap = FPDFBitmap_CreateEx(canvasHorSize, canvasVerSize, format, tmp,
-                                                sourceStride);
-    HANDLE_PDFIUM_ERROR_STATE(env)
-    unsigned int flags = FPDF_REVERSE_BYTE_ORDER | FPDF_LCD_TEXT;
+    env->SetIntArrayRegion(outStatus, 0, jobCount, status.data());
+    env->SetLongArrayRegion(outNanos, 0, jobCount, nanos.data());
+}
+
+JNI_FUNC(jboolean, PdfDocument, nativeRenderPageTiles)(JNI_ARGS, jlong pagePtr, jobject atlas,
+                                                       jint tileSize, jfloat zoom,
+                                                       jintArray tiles, jlong backgroundColor,
+                                                       jboolean renderAnnot, jint renderFlags,
+                                                       jlong tokenPtr,
+                                                       jlong cachePtr, jlong documentId,
+                                                       jint pageIndex,
+                                                       jbooleanArray completedTiles) {
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    auto token = reinterpret_cast<RenderToken *>(tokenPtr);
+    auto cache = reinterpret_cast<TileCache *>(cachePtr);
 
-    if (renderAnnot) {
-        flags |= FPDF_ANNOT;
+    if (page == nullptr || atlas == nullptr || tiles == nullptr || tileSize <= 0) {
+        LOGE("Render page pointers invalid");
+        return JNI_FALSE;
     }
 
-    if (backgroundColor != 0) {
-        FPDFBitmap_FillRect(pdfBitmap,
-                            (startX < 0) ? 0 : (int) startX,
-                            (startY < 0) ? 0 : (int) startY,
-                            (canvasHorSize < drawSizeHor) ? canvasHorSize : (int) drawSizeHor,
-                            (canvasVerSize < drawSizeVer) ? canvasVerSize : (int) drawSizeVer,
-                            backgroundColor);
+    jsize tileCount = env->GetArrayLength(tiles) / 2;
+    std::vector<jint> coords(static_cast<size_t>(tileCount * 2));
+    env->GetIntArrayRegion(tiles, 0, tileCount * 2, coords.data());
+    std::vector<jboolean> completed(static_cast<size_t>(tileCount));
+    env->GetBooleanArrayRegion(completedTiles, 0, tileCount, completed.data());
+
+    AndroidBitmapInfo info;
+    void *addr;
+    if (!lockTileAtlas(env, atlas, tileSize, tileCount, &info, &addr)) {
+        return JNI_FALSE;
     }
 
-    FPDF_RenderPageBitmap(pdfBitmap, page, startX, startY, (int) drawSizeHor, (int) drawSizeVer, 0,
-                          flags);
-    HANDLE_PDFIUM_ERROR_STATE(env)
-    if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
-        rgbBitmapTo565(tmp, sourceStride, addr, &info);
-        free(tmp);
+    int32_t zoomBucket = zoomToBucket(zoom);
+    int pageSizeHor = (int) (FPDF_GetPageWidth(page) * bucketToZoom(zoomBucket) + 0.5);
+    int pageSizeVer = (int) (FPDF_GetPageHeight(page) * bucketToZoom(zoomBucket) + 0.5);
+
+    // Tiles are rendered straight into their atlas slot, RGB_565 ones through the band buffer
+    // of renderTile
+    int bytesPerPixel = info.format == ANDROID_BITMAP_FORMAT_RGB_565 ? 2 : 4;
+    for (int i = 0; i < tileCount; i++) {
+        if (completed[i]) {
+            continue;
+        }
+        if (token != nullptr && token->cancelled.load()) {
+            break;
+        }
+        int column = coords[i * 2];
+        int row = coords[i * 2 + 1];
+        int tileLeft = column * tileSize;
+        int tileTop = row * tileSize;
+        if (column < 0 || row < 0 || tileLeft >= pageSizeHor || tileTop >= pageSizeVer) {
+            continue;
+        }
+
+        char *slot = tileSlot(addr, info, tileSize, i);
+        RenderTarget tile = bitmapTarget(slot, info);
+        tile.width = std::min((int) tileSize, pageSizeHor - tileLeft);
+        tile.height = std::min((int) tileSize, pageSizeVer - tileTop);
+        if (!renderTile(page, tile, tileLeft, tileTop, pageSizeHor, pageSizeVer,
+                        (uint32_t) backgroundColor, renderAnnot != JNI_FALSE, renderFlags)) {
+            continue;
+        }
+        if (cache != nullptr) {
+            TileKey key = makeTileKey(documentId, pageIndex, zoomBucket, column, row, tileSize,
+                                      info.format, renderAnnot, renderFlags, backgroundColor);
+            cache->put(key, slot, info.stride, tile.width, tile.height, bytesPerPixel);
+        }
+        completed[i] = JNI_TRUE;
+    }
+
+    AndroidBitmap_unlockPixels(env, atlas);
+
+    env->SetBooleanArrayRegion(completedTiles, 0, tileCount, completed.data());
+    return JNI_TRUE;
+}
+
+JNI_FUNC(jlong, PdfDocument, nativeCreateTileCache)(JNIEnv *env, jclass, jlong budgetBytes) {
+    return reinterpret_cast<jlong>(new TileCache((size_t) budgetBytes));
+}
+
+JNI_FUNC(void, PdfDocument, nativeDestroyTileCache)(JNIEnv *env, jclass, jlong cachePtr) {
+    delete reinterpret_cast<TileCache *>(cachePtr);
+}
+
+JNI_FUNC(void, PdfDocument, nativeSetTileCacheBudget)(JNIEnv *env, jclass, jlong cachePtr,
+                                                      jlong budgetBytes) {
+    reinterpret_cast<TileCache *>(cachePtr)->setBudget((size_t) budgetBytes);
+}
+
+JNI_FUNC(void, PdfDocument, nativeClearTileCache)(JNIEnv *env, jclass, jlong cachePtr) {
+    reinterpret_cast<TileCache *>(cachePtr)->clear();
+}
+
+JNI_FUNC(void, PdfDocument, nativeGetTileCacheStats)(JNIEnv *env, jclass, jlong cachePtr,
+                                                     jlongArray outStats) {
+    TileCacheStats stats = reinterpret_cast<TileCache *>(cachePtr)->getStats();
+    jlong values[] = {stats.hits, stats.misses, stats.evictions, stats.tileCount,
+                      stats.sizeBytes, stats.budgetBytes};
+    env->SetLongArrayRegion(outStats, 0, 6, values);
+}
+
+// Copies cached tiles into their atlas slots. Runs without the render lock, it never calls
+// into pdfium.
+JNI_FUNC(jboolean, PdfDocument, nativeBlitCachedTiles)(JNIEnv *env, jclass, jlong cachePtr,
+                                                       jlong documentId, jint pageIndex,
+                                                       jobject atlas, jint tileSize,
+                                                       jfloat zoom, jintArray tiles,
+                                                       jlong backgroundColor,
+                                                       jboolean renderAnnot, jint renderFlags,
+                                                       jbooleanArray completedTiles) {
+    auto cache = reinterpret_cast<TileCache *>(cachePtr);
+    if (cache == nullptr || atlas == nullptr || tiles == nullptr || tileSize <= 0) {
+        return JNI_FALSE;
+    }
+
+    jsize tileCount = env->GetArrayLength(tiles) / 2;
+    std::vector<jint> coords(static_cast<size_t>(tileCount * 2));
+    env->GetIntArrayRegion(tiles, 0, tileCount * 2, coords.data());
+    std::vector<jboolean> completed(static_cast<size_t>(tileCount), JNI_FALSE);
+
+    AndroidBitmapInfo info;
+    void *addr;
+    if (!lockTileAtlas(env, atlas, tileSize, tileCount, &info, &addr)) {
+        return JNI_FALSE;
     }
 
+    int32_t zoomBucket = zoomToBucket(zoom);
+    bool allCompleted = true;
+    for (int i = 0; i < tileCount; i++) {
+        TileKey key = makeTileKey(documentId, pageIndex, zoomBucket, coords[i * 2],
+                                  coords[i * 2 + 1], tileSize, info.format, renderAnnot,
+                                  renderFlags, backgroundColor);
+        completed[i] = static_cast<jboolean>(
+                cache->get(key, tileSlot(addr, info, tileSize, i), info.stride));
+        allCompleted &= completed[i] != JNI_FALSE;
+    }
+    AndroidBitmap_unlockPixels(env, atlas);
+
+    env->SetBooleanArrayRegion(completedTiles, 0, tileCount, completed.data());
+    return static_cast<jboolean>(allCompleted);
+}
+
+JNI_FUNC(jlong, PdfDocument, nativeCreateRenderPyramid)(JNIEnv *env, jclass, jlong budgetBytes) {
+    return reinterpret_cast<jlong>(new RenderPyramid((size_t) budgetBytes));
+}
+
+JNI_FUNC(void, PdfDocument, nativeDestroyRenderPyramid)(JNIEnv *env, jclass, jlong pyramidPtr) {
+    delete reinterpret_cast<RenderPyramid *>(pyramidPtr);
+}
+
+JNI_FUNC(jint, PdfDocument, nativeBuildRenderPyramid)(JNIEnv *env, jclass, jlong pyramidPtr,
+                                                      jlong pagePtr, jfloat scale,
+                                                      jlong backgroundColor,
+                                                      jboolean renderAnnot, jint renderFlags) {
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    return reinterpret_cast<RenderPyramid *>(pyramidPtr)->build(page, scale,
+                                                                 (uint32_t) backgroundColor,
+                                                                 renderAnnot != JNI_FALSE,
+                                                                 renderFlags);
+}
+
+JNI_FUNC(jint, PdfDocument, nativeFindPyramidLevel)(JNIEnv *env, jclass, jlong pyramidPtr,
+                                                    jfloat scale) {
+    return reinterpret_cast<RenderPyramid *>(pyramidPtr)->findLevel(scale);
+}
+
+// Returns the level scale and its size in outSize, 0 for a missing level
+JNI_FUNC(jfloat, PdfDocument, nativeGetPyramidLevel)(JNIEnv *env, jclass, jlong pyramidPtr,
+                                                     jint level, jobject outSize) {
+    int width;
+    int height;
+    float scale;
+    if (!reinterpret_cast<RenderPyramid *>(pyramidPtr)->getLevel(level, &width, &height,
+                                                                 &scale)) {
+        return 0;
+    }
+    env->SetIntField(outSize, gPointClassInfo.x, width);
+    env->SetIntField(outSize, gPointClassInfo.y, height);
+    return scale;
+}
+
+JNI_FUNC(jboolean, PdfDocument, nativeCopyPyramidLevel)(JNIEnv *env, jclass, jlong pyramidPtr,
+                                                        jint level, jobject bitmap) {
+    auto pyramid = reinterpret_cast<RenderPyramid *>(pyramidPtr);
+    int width;
+    int height;
+    float scale;
+    if (bitmap == nullptr || !pyramid->getLevel(level, &width, &height, &scale)) {
+        return JNI_FALSE;
+    }
+    AndroidBitmapInfo info;
+    void *addr;
+    if (!lockRenderBitmap(env, bitmap, &info, &addr)) {
+        return JNI_FALSE;
+    }
+    bool copied = false;
+    if (info.format != ANDROID_BITMAP_FORMAT_RGBA_8888 || (int) info.width != width ||
+        (int) info.height != height) {
+        LOGE("Pyramid level needs an RGBA_8888 bitmap of %dx%d", width, height);
+    } else {
+        copied = pyramid->copyLevel(level, addr, info.stride);
+    }
     AndroidBitmap_unlockPixels(env, bitmap);
+    return static_cast<jboolean>(copied);
+}
+
+JNI_FUNC(void, PdfDocument, nativeClearRenderPyramid)(JNIEnv *env, jclass, jlong pyramidPtr) {
+    reinterpret_cast<RenderPyramid *>(pyramidPtr)->clear();
+}
+
+JNI_FUNC(void, PdfDocument, nativeGetRenderPyramidStats)(JNIEnv *env, jclass, jlong pyramidPtr,
+                                                         jlongArray outStats) {
+    RenderPyramidStats stats = reinterpret_cast<RenderPyramid *>(pyramidPtr)->getStats();
+    jlong values[] = {stats.levelCount, stats.sizeBytes, stats.budgetBytes};
+    env->SetLongArrayRegion(outStats, 0, 3, values);
+}
+
+// The render worker helper, named like a library so it is installed next to this one into the
+// native library directory, where an app may execute files from
+static const char *RENDER_WORKER_FILE_NAME = "libpdfiumworker.so";
+
+static bool getRenderWorkerPath(std::string *outPath) {
+    Dl_info library;
+    if (dladdr(reinterpret_cast<void *>(&getRenderWorkerPath), &library) == 0 ||
+        library.dli_fname == nullptr) {
+        return false;
+    }
+    *outPath = library.dli_fname;
+    size_t slash = outPath->rfind('/');
+    if (slash == std::string::npos) {
+        return false;
+    }
+    outPath->replace(slash + 1, std::string::npos, RENDER_WORKER_FILE_NAME);
+    return true;
+}
+
+JNI_FUNC(jlong, PdfDocument, nativeCreateRenderWorkerPool)(JNIEnv *env, jclass, jint workerCount) {
+    std::string workerPath;
+    if (!getRenderWorkerPath(&workerPath)) {
+        LOGE("Cannot locate the render worker helper");
+        return 0;
+    }
+    auto pool = new RenderWorkerPool();
+    if (pool->start(workerPath.c_str(), workerCount) == 0) {
+        LOGE("Cannot start render workers from %s: %s", workerPath.c_str(), strerror(errno));
+        delete pool;
+        return 0;
+    }
+    return reinterpret_cast<jlong>(pool);
+}
+
+JNI_FUNC(void, PdfDocument, nativeDestroyRenderWorkerPool)(JNIEnv *env, jclass, jlong poolPtr) {
+    delete reinterpret_cast<RenderWorkerPool *>(poolPtr);
+}
+
+JNI_FUNC(jint, PdfDocument, nativeGetRenderWorkerCount)(JNIEnv *env, jclass, jlong poolPtr) {
+    return reinterpret_cast<RenderWorkerPool *>(poolPtr)->getWorkerCount();
+}
+
+JNI_FUNC(void, PdfDocument, nativeRenderPagesInWorkers)(JNIEnv *env, jclass, jlong poolPtr,
+                                                        jlong documentId, jint fd,
+                                                        jlong documentOffset,
+                                                        jlong documentLength,
+                                                        jstring password, jintArray pageIndices,
+                                                        jobjectArray bitmaps, jintArray viewports,
+                                                        jlong backgroundColor,
+                                                        jboolean renderAnnot, jint renderFlags,
+                                                        jintArray outStatus,
+                                                        jlongArray outNanos) {
+    auto pool = reinterpret_cast<RenderWorkerPool *>(poolPtr);
+    if (pool == nullptr || pageIndices == nullptr || bitmaps == nullptr ||
+        viewports == nullptr || outStatus == nullptr || outNanos == nullptr) {
+        LOGE("Render pages arguments invalid");
+        return;
+    }
+    jsize jobCount = env->GetArrayLength(pageIndices);
+    if (env->GetArrayLength(bitmaps) < jobCount ||
+        env->GetArrayLength(viewports) < jobCount * 4 ||
+        env->GetArrayLength(outStatus) < jobCount || env->GetArrayLength(outNanos) < jobCount) {
+        LOGE("Render pages arrays too short");
+        return;
+    }
+    // Every bitmap stays locked until the workers are done
+    if (env->EnsureLocalCapacity(jobCount) != JNI_OK) {
+        return;
+    }
+
+    std::vector<jint> indices((size_t) jobCount);
+    std::vector<jint> rects((size_t) jobCount * 4);
+    std::vector<jint> status((size_t) jobCount, RENDER_STATUS_FAILED);
+    std::vector<jlong> nanos((size_t) jobCount, 0);
+    env->GetIntArrayRegion(pageIndices, 0, jobCount, indices.data());
+    env->GetIntArrayRegion(viewports, 0, jobCount * 4, rects.data());
+
+    std::vector<jobject> locked;
+    std::vector<jsize> lockedIndices;
+    std::vector<WorkerJob> jobs;
+    for (jsize i = 0; i < jobCount; i++) {
+        jobject bitmap = env->GetObjectArrayElement(bitmaps, i);
+        AndroidBitmapInfo info;
+        void *addr;
+        if (bitmap == nullptr) {
+            continue;
+        }
+        if (!lockRenderBitmap(env, bitmap, &info, &addr)) {
+            env->DeleteLocalRef(bitmap);
+            continue;
+        }
+        WorkerJob job;
+        job.pageIndex = indices[i];
+        job.target = bitmapTarget(addr, info);
+        job.startX = rects[i * 4];
+        job.startY = rects[i * 4 + 1];
+        job.drawSizeHor = rects[i * 4 + 2];
+        job.drawSizeVer = rects[i * 4 + 3];
+        jobs.push_back(job);
+        locked.push_back(bitmap);
+        lockedIndices.push_back(i);
+    }
+
+    WorkerDocument document;
+    document.id = documentId;
+    document.fd = fd;
+    document.offset = documentOffset;
+    document.length = documentLength;
+    document.password = password != nullptr ? env->GetStringUTFChars(password, nullptr) : nullptr;
+    pool->render(document, jobs.data(), (int) jobs.size(), (uint32_t) backgroundColor,
+                 renderAnnot != JNI_FALSE, renderFlags);
+    if (document.password != nullptr) {
+        env->ReleaseStringUTFChars(password, document.password);
+    }
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        AndroidBitmap_unlockPixels(env, locked[i]);
+        env->DeleteLocalRef(locked[i]);
+        status[lockedIndices[i]] = jobs[i].rendered ? RENDER_STATUS_COMPLETE
+                                                    : RENDER_STATUS_FAILED;
+        nanos[lockedIndices[i]] = jobs[i].nanos;
+    }
+    env->SetIntArrayRegion(outStatus, 0, jobCount, status.data());
+    env->SetLongArrayRegion(outNanos, 0, jobCount, nanos.data());
+}
+
+JNI_FUNC(jlong, PdfDocument, nativeCreateRenderQueue)(JNIEnv *env, jclass) {
+    return reinterpret_cast<jlong>(new RenderQueue());
+}
+
+// The render thread must have returned from nativeTakeRenderJob
+JNI_FUNC(void, PdfDocument, nativeDestroyRenderQueue)(JNIEnv *env, jclass, jlong queuePtr) {
+    delete reinterpret_cast<RenderQueue *>(queuePtr);
+}
+
+JNI_FUNC(jlong, PdfDocument, nativeSubmitRenderJob)(JNIEnv *env, jclass, jlong queuePtr,
+                                                    jlong documentId, jint pageIndex, jlong tag,
+                                                    jint priority, jlong group) {
+    RenderKey key;
+    key.documentId = documentId;
+    key.pageIndex = pageIndex;
+    key.tag = tag;
+    return reinterpret_cast<RenderQueue *>(queuePtr)->submit(key, priority, group, nullptr);
+}
+
+// Blocks the calling thread until a job is queued or the queue is closed
+JNI_FUNC(jlong, PdfDocument, nativeTakeRenderJob)(JNIEnv *env, jclass, jlong queuePtr) {
+    return reinterpret_cast<RenderQueue *>(queuePtr)->take();
 }
 
+JNI_FUNC(jboolean, PdfDocument, nativeCancelRenderJob)(JNIEnv *env, jclass, jlong queuePtr,
+                                                       jlong jobId) {
+    return static_cast<jboolean>(reinterpret_cast<RenderQueue *>(queuePtr)->cancel(jobId));
+}
+
+JNI_FUNC(jint, PdfDocument, nativeCancelRenderGroup)(JNIEnv *env, jclass, jlong queuePtr,
+                                                     jlong group) {
+    return reinterpret_cast<RenderQueue *>(queuePtr)->cancelGroup(group);
+}
+
+JNI_FUNC(void, PdfDocument, nativeCloseRenderQueue)(JNIEnv *env, jclass, jlong queuePtr) {
+    reinterpret_cast<RenderQueue *>(queuePtr)->close();
+}
+
+JNI_FUNC(void, PdfDocument, nativeGetRenderQueueStats)(JNIEnv *env, jclass, jlong queuePtr,
+                                                       jlongArray outStats) {
+    RenderQueueStats stats = reinterpret_cast<RenderQueue *>(queuePtr)->getStats();
+    jlong values[] = {stats.queued, stats.submitted, stats.coalesced, stats.cancelled,
+                      stats.taken};
+    env->SetLongArrayRegion(outStats, 0, 5, values);
+}
+
+JNI_FUNC(jlong, PdfDocument, nativeCreateRenderToken)(JNIEnv *env, jclass) {
+    auto token = new RenderToken();
+    token->pause.version = 1;
+    token->pause.NeedToPauseNow = &needToPauseNow;
+    token->pause.user = token;
+    token->cancelled.store(false);
+    return reinterpret_cast<jlong>(token);
+}
+
+JNI_FUNC(void, PdfDocument, nativeCancelRenderToken)(JNIEnv *env, jclass, jlong tokenPtr) {
+    auto token = reinterpret_cast<RenderToken *>(tokenPtr);
+    token->cancelled.store(true);
+}
+
+JNI_FUNC(jboolean, PdfDocument, nativeIsRenderTokenCancelled)(JNIEnv *env, jclass,
+                                                              jlong tokenPtr) {
+    auto token = reinterpret_cast<RenderToken *>(tokenPtr);
+    return static_cast<jboolean>(token->cancelled.load());
+}
+
+JNI_FUNC(void, PdfDocument, nativeAbortRenderToken)(JNIEnv *env, jclass, jlong tokenPtr) {
+    auto token = reinterpret_cast<RenderToken *>(tokenPtr);
+    finishProgressiveRender(env, token, false);
+}
+
+JNI_FUNC(void, PdfDocument, nativeDestroyRenderToken)(JNIEnv *env, jclass, jlong tokenPtr) {
+    auto token = reinterpret_cast<RenderToken *>(tokenPtr);
+    finishProgressiveRender(env, token, false);
+    delete token;
+}
+
+JNI_FUNC(jint, PdfDocument, nativeRenderPageBitmapProgressive)(JNI_ARGS, jlong pagePtr,
+                                                               jlong tokenPtr, jobject bitmap,
+                                                               jint startX, jint startY,
+                                                               jint drawSizeHor, jint drawSizeVer,
+                                                               jlong backgroundColor,
+                                                               jboolean renderAnnot,
+                                                               jint renderFlags,
+                                                               jlong timeSliceMillis,
+                                                               jboolean publishPartial) {
+    auto page = reinterpret_cast<FPDF_PAGE>(pagePtr);
+    auto token = reinterpret_cast<RenderToken *>(tokenPtr);
+
+    if (page == nullptr || token == nullptr || bitmap == nullptr) {
+        LOGE("Render page pointers invalid");
+        return RENDER_STATUS_FAILED;
+    }
+
+    // A token drives one render at a time, a request for another page or bitmap starts over
+    if (token->page != nullptr &&
+        (token->page != page || !env->IsSameObject(token->bitmap, bitmap))) {
+        finishProgressiveRender(env, token, false);
+    }
+
+    if (token->cancelled.load()) {
+        finishProgressiveRender(env, token, false);
+        return RENDER_STATUS_CANCELLED;
+    }
+
+    token->deadline = timeSliceMillis > 0 ? monotonicNanos() + timeSliceMillis * 1000000LL : 0;
+
+    int status;
+    if (token->page == nullptr) {
+        AndroidBitmapInfo &info = token->info;
+        int ret;
+        if ((ret = AndroidBitmap_getInfo(env, bitmap, &info)) < 0) {
+            LOGE("Fetching bitmap info failed: %s", strerror(ret * -1));
+            return RENDER_STATUS_FAILED;
+        }
+
+        if (info.format != ANDROID_BITMAP_FORMAT_RGBA_8888 &&
+            info.format != ANDROID_BITMAP_FORMAT_RGB_565) {
+            LOGE("Bitmap format must be RGBA_8888 or RGB_565");
+            return RENDER_STATUS_FAILED;
+        }
+
+        void *addr;
+        if ((ret = AndroidBitmap_lockPixels(env, bitmap, &addr)) != 0) {
+            LOGE("Locking bitmap failed: %s", strerror(ret * -1));
+            return RENDER_STATUS_FAILED;
+        }
+
+        int format;
+        int canvasHorSize = info.width;
+        int canvasVerSize = info.height;
+        token->addr = addr;
+        if (info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
+            // Unlike the blocking renders, which go through small bands, pdfium keeps drawing
+            // into one bitmap between slices, so the BGR copy has to hold the whole frame
+            token->tmp = acquireScratch(canvasVerSize * canvasHorSize * sizeof(rgb),
+                                        &token->tmpCapacity);
+            if (token->tmp == nullptr) {
+                LOGE("Cannot allocate the RGB_565 render buffer");
+                AndroidBitmap_unlockPixels(env, bitmap);
+                return RENDER_STATUS_FAILED;
+            }
+            token->sourceStride = canvasHorSize * sizeof(rgb);
+            format = FPDFBitmap_BGR;
+            // Scratch memory holds whatever its last user left, outside of the page as well
+            memset(token->tmp, 0, (size_t) canvasVerSize * token->sourceStride);
+        } else {
+            token->tmp = addr;
+            token->sourceStride = info.stride;
+            format = FPDFBitmap_BGRA;
+        }
+
+        token->pdfBitmap = FPDFBitmap_CreateEx(canvasHorSize, canvasVerSize, format, token->tmp,
+                                               token->sourceStride);
+        token->bitmap = env->NewGlobalRef(bitmap);
+        token->page = page;
+
+        int flags = pdfiumRenderFlags(renderAnnot, renderFlags);
+
+        int fillLeft, fillTop, fillWidth, fillHeight;
+        pageArea(bitmapTarget(addr, info), startX, startY, drawSizeHor, drawSizeVer, &fillLeft,
+                 &fillTop, &fillWidth, &fillHeight);
+        if (backgroundColor != 0 && fillWidth > 0 && fillHeight > 0) {
+            FPDFBitmap_FillRect(token->pdfBitmap, fillLeft, fillTop, fillWidth, fillHeight,
+                                argbToAbgr((uint32_t) backgroundColor));
+        }
+
+        status = FPDF_RenderPageBitmap_Start(token->pdfBitmap, page, startX, startY,
+                                             (int) drawSizeHor, (int) drawSizeVer, 0, flags,
+                                             &token->pause);
+    } else {
+        status = FPDF_RenderPage_Continue(page, &token->pause);
+    }
+
+    switch (status) {
+        case FPDF_RENDER_DONE:
+            finishProgressiveRender(env, token, true);
+            return RENDER_STATUS_COMPLETE;
+        case FPDF_RENDER_TOBECOUNTINUED:
+            if (token->cancelled.load()) {
+                finishProgressiveRender(env, token, false);
+                return RENDER_STATUS_CANCELLED;
+            }
+            // RGBA_8888 is drawn in place. RGB_565 converts the whole frame, which costs as much
+            // as a slice of a simple page, so it only happens when the caller shows partial pages.
+            if (publishPartial && token->info.format == ANDROID_BITMAP_FORMAT_RGB_565) {
+                rgbBitmapTo565(token->tmp, token->sourceStride, token->addr, &token->info);
+            }
+            return RENDER_STATUS_PARTIAL;
+        default:
+            LOGE("Progressive render failed with status %d", status);
+            finishProgressiveRender(env, token, false);
+            return RENDER_STATUS_FAILED;
+    }
+}
+
+JNI_FUNC(void, PdfDocument, nativeTrimScratchBuffers)(JNIEnv *env, jclass) {
+    trimScratch();
+}
+
+JNI_FUNC(void, PdfDocument, nativeGetScratchBufferStats)(JNIEnv *env, jclass,
+                                                         jlongArray outStats) {
+    ScratchPoolStats stats = getScratchStats();
+    jlong values[] = {stats.acquires, stats.allocations, stats.trims, stats.idleBuffers,
+                      stats.idleBytes, stats.usedBytes, stats.highWaterBytes};
+    env->SetLongArrayRegion(outStats, 0, 7, values);
+}
 
 JNI_FUNC(jstring, PdfDocument, nativeGetMetaText)(JNI_ARGS, jlong docPtr, jstring tag) {
     const char *ctag = env->GetStringUTFChars(tag, nullptr);
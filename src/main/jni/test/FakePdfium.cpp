@@ -0,0 +1,174 @@
+// The part of the pdfium API used by the render code, enough to run it on a host without
+// pdfium. A page is a deterministic pattern of the page coordinates and index with a few
+// holes, so moved and freshly rendered pixels can be compared and uncovered pixels stay
+// visible. Any file starting with %PDF is a document, see HostTest.h for its password, the
+// page which crashes and what the availability provider asks for.
+
+#include <signal.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <fpdf_dataavail.h>
+#include <fpdf_edit.h>
+#include <fpdfview.h>
+
+#include "HostTest.h"
+
+namespace {
+
+    struct FakeBitmap {
+        int width;
+        int height;
+        int format;
+        int stride;
+        uint8_t *pixels;
+    };
+
+    struct FakeAvail {
+        FX_FILEAVAIL *fileAvail;
+        FPDF_FILEACCESS *file;
+    };
+
+    FakeAvail *lastAvail = nullptr;
+
+    int formatBytes(int format) {
+        switch (format) {
+            case FPDFBitmap_Gray:
+                return 1;
+            case FPDFBitmap_BGR:
+                return 3;
+            default:
+                return 4;
+        }
+    }
+
+}
+
+FPDF_FILEACCESS *fakePdfiumAvailLoader() {
+    return lastAvail != nullptr ? lastAvail->file : nullptr;
+}
+
+extern "C" {
+
+void FPDF_InitLibrary() {
+}
+
+void FPDF_DestroyLibrary() {
+}
+
+FPDF_DOCUMENT FPDF_LoadCustomDocument(FPDF_FILEACCESS *file, FPDF_BYTESTRING password) {
+    static char document;
+    unsigned char header[4];
+    if (file->m_FileLen < sizeof(header) ||
+        !file->m_GetBlock(file->m_Param, 0, header, sizeof(header)) ||
+        memcmp(header, "%PDF", sizeof(header)) != 0) {
+        return nullptr;
+    }
+    if (password != nullptr && strcmp(password, FAKE_PDFIUM_PASSWORD) != 0) {
+        return nullptr;
+    }
+    return (FPDF_DOCUMENT) &document;
+}
+
+void FPDF_CloseDocument(FPDF_DOCUMENT document) {
+}
+
+FPDF_PAGE FPDF_LoadPage(FPDF_DOCUMENT document, int page_index) {
+    if (page_index == FAKE_PDFIUM_CRASH_PAGE) {
+        // Like a crash on a broken page, without a core dump
+        raise(SIGKILL);
+    }
+    return page_index >= 0 ? (FPDF_PAGE) (intptr_t) (page_index + 1) : nullptr;
+}
+
+void FPDF_ClosePage(FPDF_PAGE page) {
+}
+
+FPDF_BITMAP FPDFBitmap_CreateEx(int width, int height, int format, void *first_scan,
+                                int stride) {
+    return (FPDF_BITMAP) new FakeBitmap{width, height, format, stride, (uint8_t *) first_scan};
+}
+
+void FPDFBitmap_Destroy(FPDF_BITMAP bitmap) {
+    delete (FakeBitmap *) bitmap;
+}
+
+void FPDFBitmap_FillRect(FPDF_BITMAP bitmap, int left, int top, int width, int height,
+                         FPDF_DWORD color) {
+    auto *target = (FakeBitmap *) bitmap;
+    int pixelBytes = formatBytes(target->format);
+    for (int y = std::max(0, top); y < std::min(target->height, top + height); y++) {
+        for (int x = std::max(0, left); x < std::min(target->width, left + width); x++) {
+            uint8_t *pixel = target->pixels + (size_t) y * target->stride + x * pixelBytes;
+            for (int channel = 0; channel < pixelBytes; channel++) {
+                pixel[channel] = (uint8_t) (color >> (8 * channel));
+            }
+        }
+    }
+}
+
+void FPDF_RenderPageBitmap(FPDF_BITMAP bitmap, FPDF_PAGE page, int start_x, int start_y,
+                           int size_x, int size_y, int rotate, int flags) {
+    auto *target = (FakeBitmap *) bitmap;
+    int pixelBytes = formatBytes(target->format);
+    int pageValue = (int) (intptr_t) page;
+    for (int y = 0; y < target->height; y++) {
+        for (int x = 0; x < target->width; x++) {
+            int pageX = x - start_x;
+            int pageY = y - start_y;
+            if (pageX < 0 || pageY < 0 || pageX >= size_x || pageY >= size_y ||
+                (pageX * 7 + pageY * 3) % 5 == 0) {
+                continue;
+            }
+            uint8_t *pixel = target->pixels + (size_t) y * target->stride + x * pixelBytes;
+            for (int channel = 0; channel < pixelBytes; channel++) {
+                pixel[channel] = (uint8_t) (pageX * 31 + pageY * 17 + channel * 5 + pageValue);
+            }
+        }
+    }
+}
+
+FPDF_BOOL FPDFPage_HasTransparency(FPDF_PAGE page) {
+    return 0;
+}
+
+FPDF_AVAIL FPDFAvail_Create(FX_FILEAVAIL *file_avail, FPDF_FILEACCESS *file) {
+    lastAvail = new FakeAvail{file_avail, file};
+    return lastAvail;
+}
+
+void FPDFAvail_Destroy(FPDF_AVAIL avail) {
+    if (avail == lastAvail) {
+        lastAvail = nullptr;
+    }
+    delete (FakeAvail *) avail;
+}
+
+int FPDFAvail_IsDocAvail(FPDF_AVAIL avail, FX_DOWNLOADHINTS *hints) {
+    auto *fake = (FakeAvail *) avail;
+    size_t length = fake->file->m_FileLen;
+    int status = PDF_DATA_AVAIL;
+    for (size_t offset = 0; offset < length; offset += FAKE_PDFIUM_AVAIL_CHUNK) {
+        size_t size = std::min(FAKE_PDFIUM_AVAIL_CHUNK, length - offset);
+        if (!fake->fileAvail->IsDataAvail(fake->fileAvail, offset, size)) {
+            hints->AddSegment(hints, offset, FAKE_PDFIUM_AVAIL_CHUNK);
+            status = PDF_DATA_NOTAVAIL;
+        }
+    }
+    return status;
+}
+
+FPDF_DOCUMENT FPDFAvail_GetDocument(FPDF_AVAIL avail, FPDF_BYTESTRING password) {
+    return FPDF_LoadCustomDocument(((FakeAvail *) avail)->file, password);
+}
+
+int FPDFAvail_IsPageAvail(FPDF_AVAIL avail, int page_index, FX_DOWNLOADHINTS *hints) {
+    return FPDFAvail_IsDocAvail(avail, hints);
+}
+
+int FPDFAvail_IsLinearized(FPDF_AVAIL avail) {
+    return PDF_NOT_LINEARIZED;
+}
+
+}
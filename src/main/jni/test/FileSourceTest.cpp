@@ -0,0 +1,247 @@
+// FileSource against the bytes of a temporary file. The read path has to return the file's
+// bytes for any read, count cache hits and misses, read ahead once reads move on block by
+// block, bypass the cache for large reads and retry blocks which failed, also while several
+// threads read at once. Both paths have to honour the document's offset and length in the
+// file. The mmap2 path of 32 bit ABIs is not built here, the mapping goes through mmap.
+
+#include "HostTest.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "FileSource.h"
+
+using namespace tools;
+using hosttest::Random;
+
+// Mirrors the constants of FileSource.cpp
+static const size_t BLOCK = 64 * 1024;
+static const size_t CACHE_BYTES = 32 * BLOCK;
+
+static std::vector<uint8_t> gContent;
+
+static int createFile(size_t size) {
+    char path[] = "/tmp/FileSourceTestXXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    unlink(path);
+    CHECK(write(fd, gContent.data(), size) == (ssize_t) size);
+    return fd;
+}
+
+// Reads through the loader pdfium gets
+class Reader {
+public:
+    Reader(int fd, int64_t offset, int64_t length, int fileAccess)
+            : mSource(fd, offset, length), mOffset(offset) {
+        mSource.open(fileAccess);
+        mSource.getFileAccess(&mAccess);
+    }
+
+    bool read(int64_t position, size_t size, std::vector<uint8_t> &out) {
+        out.assign(size, 0);
+        return mAccess.m_GetBlock(mAccess.m_Param, (unsigned long) position, out.data(),
+                                  (unsigned long) size) != 0;
+    }
+
+    // Read and compare with the file content
+    void check(int64_t position, size_t size) {
+        std::vector<uint8_t> out;
+        CHECK(read(position, size, out));
+        CHECK(memcmp(out.data(), &gContent[(size_t) (mOffset + position)], size) == 0);
+    }
+
+    void checkBlock(int64_t index) {
+        check(index * (int64_t) BLOCK + 100, 200);
+    }
+
+    FileSourceStats stats() {
+        return mSource.getStats();
+    }
+
+private:
+    FileSource mSource;
+    int64_t mOffset;
+    FPDF_FILEACCESS mAccess;
+};
+
+static bool waitForReadahead(Reader &reader, int64_t blocks) {
+    for (int i = 0; i < 200 && reader.stats().readaheadBlocks < blocks; i++) {
+        usleep(10 * 1000);
+    }
+    return reader.stats().readaheadBlocks == blocks;
+}
+
+static void testReadsMatchFile(int fd) {
+    Reader reader(fd, 0, (int64_t) gContent.size(), FILE_ACCESS_READ);
+    CHECK(!reader.stats().mapped);
+    Random random(1);
+    for (int i = 0; i < 2000; i++) {
+        size_t size = 1 + random.nextInt(i % 10 == 0 ? 3 * (int) BLOCK : 2000);
+        int64_t position = random.nextInt((int) (gContent.size() - size));
+        reader.check(position, size);
+    }
+    // The last bytes, in a block shorter than the others
+    reader.check((int64_t) gContent.size() - 10, 10);
+    std::vector<uint8_t> out;
+    CHECK(!reader.read((int64_t) gContent.size() - 10, 11, out));
+}
+
+static void testHitsAndMisses(int fd) {
+    Reader reader(fd, 0, (int64_t) gContent.size(), FILE_ACCESS_READ);
+    // Far apart, so nothing is read ahead
+    reader.checkBlock(5);
+    reader.check(5 * BLOCK + 5000, 3000);
+    reader.checkBlock(10);
+    reader.checkBlock(5);
+    FileSourceStats stats = reader.stats();
+    CHECK_EQ(2, stats.cacheMisses);
+    CHECK_EQ(2, stats.cacheHits);
+    CHECK_EQ(2, stats.syscalls);
+    CHECK_EQ(4, stats.reads);
+
+    // Across a block boundary, one block is cached and one is not
+    reader.check(11 * BLOCK - 50, 100);
+    stats = reader.stats();
+    CHECK_EQ(3, stats.cacheMisses);
+    CHECK_EQ(3, stats.cacheHits);
+    CHECK_EQ(0, stats.readaheadBlocks);
+}
+
+static void testReadahead(int fd) {
+    Reader reader(fd, 0, (int64_t) gContent.size(), FILE_ACCESS_READ);
+    reader.checkBlock(3);
+    reader.checkBlock(4);
+    usleep(50 * 1000);
+    CHECK_EQ(0, reader.stats().readaheadBlocks);
+    // The second block in a row after the first one, the next four are read ahead
+    reader.checkBlock(5);
+    CHECK(waitForReadahead(reader, 4));
+    // The window moves along with the reads and stops at the last block. Once the readahead
+    // caught up every following block is a hit.
+    int64_t lastBlock = (int64_t) ((gContent.size() - 1) / BLOCK);
+    int64_t misses = reader.stats().cacheMisses;
+    for (int64_t index = 6; index <= lastBlock; index++) {
+        reader.checkBlock(index);
+        CHECK(waitForReadahead(reader, std::min(index + 4, lastBlock) - 5));
+    }
+    FileSourceStats stats = reader.stats();
+    CHECK_EQ(misses, stats.cacheMisses);
+    CHECK_EQ(lastBlock - 5, stats.cacheHits);
+    CHECK_EQ(3 + lastBlock - 5, stats.syscalls);
+}
+
+static void testLargeReadsBypassCache(int fd) {
+    Reader reader(fd, 0, (int64_t) gContent.size(), FILE_ACCESS_READ);
+    reader.check(1000, CACHE_BYTES / 2 + 1);
+    FileSourceStats stats = reader.stats();
+    CHECK_EQ(1, stats.syscalls);
+    CHECK_EQ(0, stats.cacheMisses);
+    CHECK_EQ(0, stats.readaheadBlocks);
+    // Nothing was cached
+    reader.checkBlock(0);
+    CHECK_EQ(1, reader.stats().cacheMisses);
+    // Half of the cache still goes through it, some of the blocks may be read ahead by then
+    reader.check(3 * BLOCK, CACHE_BYTES / 2);
+    stats = reader.stats();
+    CHECK_EQ(1 + 16, stats.cacheMisses + stats.cacheHits);
+}
+
+static void testFailedBlockIsRetried() {
+    // The document is longer than the file so far, like one still being written
+    size_t written = 2 * BLOCK + 1000;
+    int fd = createFile(written);
+    Reader reader(fd, 0, (int64_t) gContent.size(), FILE_ACCESS_READ);
+    reader.checkBlock(0);
+    std::vector<uint8_t> out;
+    CHECK(!reader.read(2 * BLOCK + 500, 1000, out));
+    CHECK(!reader.read(2 * BLOCK, 10, out));
+    FileSourceStats stats = reader.stats();
+    CHECK_EQ(3, stats.cacheMisses);
+    CHECK_EQ(0, stats.cacheHits);
+
+    CHECK(pwrite(fd, &gContent[written], gContent.size() - written, (off_t) written) ==
+          (ssize_t) (gContent.size() - written));
+    reader.check(2 * BLOCK + 500, 1000);
+    reader.check(2 * BLOCK, 10);
+    stats = reader.stats();
+    CHECK_EQ(4, stats.cacheMisses);
+    CHECK_EQ(1, stats.cacheHits);
+    close(fd);
+}
+
+// A document which starts at a page boundary or in the middle of a page and ends before the
+// file does, as an entry of an archive
+static void testOffsetAndLength(int fd, int fileAccess) {
+    static const int64_t OFFSETS[] = {3 * 4096, 3 * 4096 + 123};
+    for (int64_t offset : OFFSETS) {
+        int64_t length = (int64_t) gContent.size() - offset - 5000;
+        Reader reader(fd, offset, length, fileAccess);
+        CHECK(reader.stats().mapped == (fileAccess == FILE_ACCESS_MAPPED));
+        Random random(2);
+        for (int i = 0; i < 500; i++) {
+            size_t size = 1 + random.nextInt(3000);
+            reader.check(random.nextInt((int) (length - (int64_t) size)), size);
+        }
+        reader.check(0, 100);
+        reader.check(length - 100, 100);
+        // The bytes after the document are there in the file but not part of it
+        std::vector<uint8_t> out;
+        CHECK(!reader.read(length - 100, 101, out));
+        CHECK(!reader.read(length, 1, out));
+    }
+}
+
+// Threads read at random, loading, evicting and waiting for blocks other threads are reading,
+// while the readahead thread runs
+static void testConcurrentReads(int fd) {
+    Reader reader(fd, 0, (int64_t) gContent.size(), FILE_ACCESS_READ);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&reader, t]() {
+            Random random((uint32_t) (t + 1));
+            int64_t position = 0;
+            for (int i = 0; i < 3000; i++) {
+                size_t size = 1 + random.nextInt(3000);
+                // Runs of sequential reads mixed with jumps
+                if (random.nextInt(8) == 0 ||
+                    position + (int64_t) size > (int64_t) gContent.size()) {
+                    position = random.nextInt((int) (gContent.size() - size));
+                }
+                reader.check(position, size);
+                position += (int64_t) size;
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    FileSourceStats stats = reader.stats();
+    CHECK_EQ(4 * 3000, stats.reads);
+    CHECK(stats.readaheadBlocks > 0);
+}
+
+int main() {
+    // Larger than the cache, with a short last block
+    gContent.resize(4 * CACHE_BYTES + 12345);
+    Random random(42);
+    random.fill(gContent.data(), gContent.size());
+    int fd = createFile(gContent.size());
+
+    testReadsMatchFile(fd);
+    testHitsAndMisses(fd);
+    testReadahead(fd);
+    testLargeReadsBypassCache(fd);
+    testFailedBlockIsRetried();
+    testOffsetAndLength(fd, FILE_ACCESS_MAPPED);
+    testOffsetAndLength(fd, FILE_ACCESS_READ);
+    testConcurrentReads(fd);
+    close(fd);
+    printf("FileSourceTest passed\n");
+    return 0;
+}
@@ -0,0 +1,113 @@
+#ifndef HOST_TEST_H_
+#define HOST_TEST_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+#include <fpdfview.h>
+
+// Checks of the host tests, which build the engine code under ../src with the desktop compiler.
+// A failed check prints where it failed and ends the test binary with a non-zero status.
+#define CHECK(condition)                                                          \
+    do {                                                                          \
+        if (!(condition)) {                                                       \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,      \
+                    #condition);                                                  \
+            exit(1);                                                              \
+        }                                                                         \
+    } while (0)
+
+#define CHECK_EQ(expected, actual)                                                \
+    do {                                                                          \
+        long long expectedValue = (long long) (expected);                         \
+        long long actualValue = (long long) (actual);                             \
+        if (expectedValue != actualValue) {                                       \
+            fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__,       \
+                    __LINE__, #actual, actualValue, expectedValue);               \
+            exit(1);                                                              \
+        }                                                                         \
+    } while (0)
+
+// The PixelConvert kernel variant of the vector unit of the host, SSSE3 on x86 and NEON on ARM
+#if defined(__i386__) || defined(__x86_64__)
+#define VECTOR_KERNEL(name) name##_ssse3
+#define HAVE_VECTOR_KERNELS
+
+static inline bool vectorKernelsSupported() {
+    return __builtin_cpu_supports("ssse3") != 0;
+}
+#elif defined(__aarch64__) || defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define VECTOR_KERNEL(name) name##_neon
+#define HAVE_VECTOR_KERNELS
+
+static inline bool vectorKernelsSupported() {
+    return true;
+}
+#endif
+
+// What FakePdfium does beyond drawing pages. Documents open without a password as well.
+static const char FAKE_PDFIUM_PASSWORD[] = "secret";
+// FPDF_LoadPage kills the process on this page
+static const int FAKE_PDFIUM_CRASH_PAGE = 13;
+// FPDFAvail_IsDocAvail needs the whole file and hints every missing chunk of this size, the last
+// one reaches past the end of the file like the rounded up hints of pdfium
+static const size_t FAKE_PDFIUM_AVAIL_CHUNK = 1024;
+
+// The loader of the last FPDFAvail_Create, nullptr once that provider is destroyed
+FPDF_FILEACCESS *fakePdfiumAvailLoader();
+
+namespace hosttest {
+
+    // Reproducible pseudo random bytes, the same on every host
+    class Random {
+    public:
+        explicit Random(uint32_t seed) : mState(seed != 0 ? seed : 1) {
+        }
+
+        uint32_t next() {
+            mState ^= mState << 13;
+            mState ^= mState >> 17;
+            mState ^= mState << 5;
+            return mState;
+        }
+
+        int nextInt(int bound) {
+            return (int) (next() % (uint32_t) bound);
+        }
+
+        void fill(void *data, size_t size) {
+            auto *bytes = (uint8_t *) data;
+            for (size_t i = 0; i < size; i++) {
+                bytes[i] = (uint8_t) next();
+            }
+        }
+
+    private:
+        uint32_t mState;
+    };
+
+    inline double elapsedMillis(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                         start).count();
+    }
+
+    // Fastest of several runs, the least disturbed by other work on the host
+    template<typename Run>
+    double bestMillis(int runs, Run run) {
+        double best = 0;
+        for (int i = 0; i < runs; i++) {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            double millis = elapsedMillis(start);
+            if (i == 0 || millis < best) {
+                best = millis;
+            }
+        }
+        return best;
+    }
+
+}
+#endif /* HOST_TEST_H_ */
@@ -0,0 +1,208 @@
+// encodePage against FakePdfium pages. PNG output is inflated and unfiltered and has to match
+// a direct renderPage of the whole image, JPEG output has to be a well formed baseline stream
+// with its entropy coded 0xFF bytes stuffed. The sizes cover a single band, several bands and
+// heights which are not a multiple of the 16 row JPEG blocks.
+
+#include "HostTest.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <string>
+#include <vector>
+
+#include "ImageEncoder.h"
+#include "PageRender.h"
+#include "PixelConvert.h"
+
+using namespace tools;
+
+// Sizes of one band, then several bands which end in the middle of a JPEG block row
+static const int SIZES[][2] = {{37, 23}, {300, 16}, {1000, 1001}, {700, 2500}};
+
+static std::vector<uint8_t> encode(int imageFormat, int width, int height, int renderFlags) {
+    char path[] = "/tmp/ImageEncoderTestXXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    unlink(path);
+    // The page is smaller than the image, the rest is the white or transparent backdrop
+    CHECK(encodePage((FPDF_PAGE) 1, fd, imageFormat, 90, width, height, 5, -3, width - 9,
+                     height - 2, 0xFFFFFFFF, false, renderFlags));
+    off_t size = lseek(fd, 0, SEEK_END);
+    std::vector<uint8_t> data((size_t) size);
+    CHECK(pread(fd, data.data(), data.size(), 0) == size);
+    close(fd);
+    return data;
+}
+
+static uint32_t bigEndian32(const uint8_t *data) {
+    return (uint32_t) data[0] << 24 | (uint32_t) data[1] << 16 | (uint32_t) data[2] << 8 |
+           data[3];
+}
+
+static int bigEndian16(const uint8_t *data) {
+    return data[0] << 8 | data[1];
+}
+
+// The rows encodePage renders, with the backdrop it starts from
+static std::vector<uint8_t> renderReference(int width, int height, int format, int renderFlags) {
+    int stride = width * bytesPerPixel(format);
+    std::vector<uint8_t> pixels((size_t) stride * height,
+                                format == PIXEL_FORMAT_RGBA_8888 ? 0 : 0xFF);
+    RenderTarget target = {pixels.data(), width, height, stride, format};
+    CHECK(renderPage((FPDF_PAGE) 1, target, 5, -3, width - 9, height - 2, 0xFFFFFFFF, false,
+                     renderFlags));
+    if (format == PIXEL_FORMAT_RGBA_8888) {
+        unpremultiply(pixels.data(), stride, pixels.data(), stride, width, height);
+    }
+    return pixels;
+}
+
+static uint8_t paeth(int left, int up, int upLeft) {
+    int estimate = left + up - upLeft;
+    int toLeft = abs(estimate - left);
+    int toUp = abs(estimate - up);
+    int toUpLeft = abs(estimate - upLeft);
+    if (toLeft <= toUp && toLeft <= toUpLeft) {
+        return (uint8_t) left;
+    }
+    return (uint8_t) (toUp <= toUpLeft ? up : upLeft);
+}
+
+static void testPng(int width, int height, int renderFlags) {
+    bool alpha = (renderFlags & RENDER_FLAG_TRANSPARENT) != 0;
+    int pixelBytes = alpha ? 4 : 3;
+    std::vector<uint8_t> png = encode(IMAGE_FORMAT_PNG, width, height, renderFlags);
+    static const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    CHECK(png.size() > sizeof(signature));
+    CHECK(memcmp(png.data(), signature, sizeof(signature)) == 0);
+
+    std::string idat;
+    std::vector<std::string> chunkTypes;
+    size_t offset = sizeof(signature);
+    while (offset + 12 <= png.size()) {
+        uint32_t size = bigEndian32(&png[offset]);
+        CHECK(offset + 12 + size <= png.size());
+        const uint8_t *type = &png[offset + 4];
+        const uint8_t *data = type + 4;
+        uLong crc = crc32(crc32(0, type, 4), data, size);
+        CHECK_EQ(crc, bigEndian32(data + size));
+        chunkTypes.push_back(std::string((const char *) type, 4));
+        if (chunkTypes.back() == "IHDR") {
+            CHECK_EQ(width, bigEndian32(data));
+            CHECK_EQ(height, bigEndian32(data + 4));
+            CHECK_EQ(8, data[8]);
+            CHECK_EQ(alpha ? 6 : 2, data[9]);
+        } else if (chunkTypes.back() == "IDAT") {
+            idat.append((const char *) data, size);
+        }
+        offset += 12 + size;
+    }
+    CHECK_EQ(png.size(), offset);
+    CHECK(chunkTypes.front() == "IHDR");
+    CHECK(chunkTypes.back() == "IEND");
+
+    int rowBytes = width * pixelBytes;
+    std::vector<uint8_t> filtered((size_t) (rowBytes + 1) * height);
+    uLongf inflatedSize = filtered.size();
+    CHECK_EQ(Z_OK, uncompress(filtered.data(), &inflatedSize, (const Bytef *) idat.data(),
+                              idat.size()));
+    CHECK_EQ(filtered.size(), inflatedSize);
+
+    std::vector<uint8_t> image((size_t) rowBytes * height);
+    std::vector<uint8_t> zero((size_t) rowBytes, 0);
+    for (int y = 0; y < height; y++) {
+        const uint8_t *in = &filtered[(size_t) y * (rowBytes + 1)];
+        uint8_t *row = &image[(size_t) y * rowBytes];
+        const uint8_t *up = y > 0 ? row - rowBytes : zero.data();
+        int filter = in[0];
+        CHECK(filter <= 4);
+        for (int i = 0; i < rowBytes; i++) {
+            int left = i >= pixelBytes ? row[i - pixelBytes] : 0;
+            int upLeft = i >= pixelBytes ? up[i - pixelBytes] : 0;
+            int predicted = filter == 1 ? left : filter == 2 ? up[i]
+                          : filter == 3 ? (left + up[i]) >> 1
+                          : filter == 4 ? paeth(left, up[i], upLeft) : 0;
+            row[i] = (uint8_t) (in[1 + i] + predicted);
+        }
+    }
+    CHECK(image == renderReference(width, height,
+                                   alpha ? PIXEL_FORMAT_RGBA_8888 : PIXEL_FORMAT_RGB_888,
+                                   renderFlags));
+}
+
+static void testJpeg(int width, int height) {
+    std::vector<uint8_t> jpeg = encode(IMAGE_FORMAT_JPEG, width, height, 0);
+    CHECK(jpeg.size() > 4);
+    CHECK_EQ(0xFFD8, bigEndian16(jpeg.data()));
+
+    // Marker segments up to the start of the scan
+    bool frame = false;
+    int quantTables = 0;
+    int huffmanTables = 0;
+    size_t offset = 2;
+    for (;;) {
+        CHECK(offset + 4 <= jpeg.size());
+        CHECK_EQ(0xFF, jpeg[offset]);
+        int marker = jpeg[offset + 1];
+        int length = bigEndian16(&jpeg[offset + 2]);
+        const uint8_t *data = &jpeg[offset + 4];
+        CHECK(offset + 2 + length <= jpeg.size());
+        if (marker == 0xC0) {
+            // Baseline, 8 bit, three components with 2x2 subsampled chroma
+            CHECK_EQ(8, data[0]);
+            CHECK_EQ(height, bigEndian16(data + 1));
+            CHECK_EQ(width, bigEndian16(data + 3));
+            CHECK_EQ(3, data[5]);
+            CHECK_EQ(0x22, data[7]);
+            frame = true;
+        } else if (marker == 0xDB) {
+            quantTables += (length - 2) / 65;
+        } else if (marker == 0xC4) {
+            // Class and id, 16 code counts, then the values
+            for (const uint8_t *table = data; table < data + length - 2;) {
+                int values = 0;
+                for (int i = 0; i < 16; i++) {
+                    values += table[1 + i];
+                }
+                table += 17 + values;
+                huffmanTables++;
+            }
+        } else {
+            // Other markers of a baseline encoder
+            CHECK(marker == 0xE0 || marker == 0xDA);
+        }
+        offset += 2 + length;
+        if (marker == 0xDA) {
+            break;
+        }
+    }
+    CHECK(frame);
+    CHECK_EQ(2, quantTables);
+    CHECK_EQ(4, huffmanTables);
+
+    // The entropy coded data has no markers, every 0xFF in it is followed by a stuffed zero
+    CHECK_EQ(0xFFD9, bigEndian16(&jpeg[jpeg.size() - 2]));
+    int stuffed = 0;
+    for (size_t i = offset; i < jpeg.size() - 2; i++) {
+        if (jpeg[i] == 0xFF) {
+            CHECK_EQ(0, jpeg[i + 1]);
+            stuffed++;
+            i++;
+        }
+    }
+    // The page pattern changes every pixel, its coefficients fill the data with 0xFF bytes
+    CHECK(stuffed > 0);
+}
+
+int main() {
+    for (const int *size : SIZES) {
+        testPng(size[0], size[1], 0);
+        testPng(size[0], size[1], RENDER_FLAG_TRANSPARENT);
+        testJpeg(size[0], size[1]);
+    }
+    printf("ImageEncoderTest passed\n");
+    return 0;
+}
@@ -0,0 +1,66 @@
+// RGB_565 rendering through the 256 KB band buffer of renderPage against the previous
+// full-frame path, which rendered the whole target into one BGR buffer and converted it
+// afterwards. Reports the time per frame and the peak scratch memory of both. The page comes
+// from FakePdfium, so the time includes a cheap stand-in for pdfium and compares the overhead
+// of the two paths rather than real page content.
+
+#include "HostTest.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include "PageRender.h"
+#include "PixelConvert.h"
+#include "ScratchPool.h"
+
+using namespace tools;
+
+static const int RUNS = 10;
+static const uint32_t BACKGROUND = 0xFFFFFFFF;
+
+// The RGB_565 path before banding
+static void renderFullFrame565(FPDF_PAGE page, const RenderTarget &target) {
+    int sourceStride = target.width * 3;
+    size_t capacity;
+    void *frame = acquireScratch((size_t) target.height * sourceStride, &capacity);
+    FPDF_BITMAP bitmap = FPDFBitmap_CreateEx(target.width, target.height, FPDFBitmap_BGR, frame,
+                                             sourceStride);
+    FPDFBitmap_FillRect(bitmap, 0, 0, target.width, target.height, BACKGROUND);
+    FPDF_RenderPageBitmap(bitmap, page, 0, 0, target.width, target.height, 0,
+                          pdfiumRenderFlags(false, 0));
+    FPDFBitmap_Destroy(bitmap);
+    rgb24To565(frame, sourceStride, target.pixels, target.stride, target.width, target.height);
+    releaseScratch(frame, capacity);
+}
+
+// The scratch pool only records the highest use of the process. All banded renders run first
+// and the sizes grow, so the high water mark after each render is the peak of that render.
+static const int SIZES[][2] = {{720, 1280}, {1440, 2560}, {2160, 3840}};
+
+template<typename Render>
+static void benchmark(const char *name, Render render) {
+    for (const int *size : SIZES) {
+        int width = size[0];
+        int height = size[1];
+        std::vector<uint16_t> pixels((size_t) width * height);
+        RenderTarget target = {pixels.data(), width, height, width * 2, PIXEL_FORMAT_RGB_565};
+        double millis = hosttest::bestMillis(RUNS, [&]() {
+            render(target);
+        });
+        printf("%-10s %5dx%-5d %8.2f ms/frame %8lld KB peak scratch\n", name, width, height,
+               millis, (long long) getScratchStats().highWaterBytes / 1024);
+    }
+}
+
+int main() {
+    FPDF_PAGE page = (FPDF_PAGE) 1;
+    printf("RGB_565 render, best of %d runs\n", RUNS);
+    benchmark("banded", [page](const RenderTarget &target) {
+        CHECK(renderPage(page, target, 0, 0, target.width, target.height, BACKGROUND, false, 0));
+    });
+    benchmark("full frame", [page](const RenderTarget &target) {
+        renderFullFrame565(page, target);
+    });
+    return 0;
+}
@@ -0,0 +1,109 @@
+// scrollPage against a full render of the new position, which it has to match pixel for pixel
+// in every format, with and without the RGB_565 dither. renderTile into a used atlas slot
+// against a render into a fresh one.
+
+#include "HostTest.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "PageRender.h"
+
+using namespace tools;
+using hosttest::Random;
+
+static void testScrollMatchesFullRender(int format, int renderFlags) {
+    Random random((uint32_t) (format * 16 + renderFlags));
+    FPDF_PAGE page = (FPDF_PAGE) 1;
+    int pixelBytes = bytesPerPixel(format);
+    for (int i = 0; i < 3000; i++) {
+        int width = 1 + random.nextInt(40);
+        int height = 1 + random.nextInt(40);
+        int stride = width * pixelBytes + random.nextInt(8);
+        int drawSizeHor = random.nextInt(80);
+        int drawSizeVer = random.nextInt(80);
+        int startX = random.nextInt(60) - 30;
+        int startY = random.nextInt(60) - 30;
+        int deltaX = random.nextInt(50) - 25;
+        int deltaY = random.nextInt(50) - 25;
+        uint32_t backgroundColor = random.nextInt(2) != 0 ? 0xFF112233 : 0;
+
+        std::vector<uint8_t> scrolled((size_t) stride * height);
+        std::vector<uint8_t> rendered((size_t) stride * height);
+        RenderTarget scrolledTarget = {scrolled.data(), width, height, stride, format};
+        RenderTarget renderedTarget = {rendered.data(), width, height, stride, format};
+        CHECK(renderPage(page, scrolledTarget, startX, startY, drawSizeHor, drawSizeVer,
+                         backgroundColor, false, renderFlags));
+        CHECK(scrollPage(page, scrolledTarget, deltaX, deltaY, startX + deltaX, startY + deltaY,
+                         drawSizeHor, drawSizeVer, backgroundColor, false, renderFlags));
+        CHECK(renderPage(page, renderedTarget, startX + deltaX, startY + deltaY, drawSizeHor,
+                         drawSizeVer, backgroundColor, false, renderFlags));
+        for (int y = 0; y < height; y++) {
+            CHECK(memcmp(&scrolled[(size_t) y * stride], &rendered[(size_t) y * stride],
+                         (size_t) width * pixelBytes) == 0);
+        }
+    }
+}
+
+static const int TILE_SIZE = 64;
+
+// Tile of a page of pageSizeHor x pageSizeVer in the first slot of a two slot atlas row
+static void renderAtlasTile(std::vector<uint8_t> &atlas, int format, int column, int row,
+                            int pageSizeHor, int pageSizeVer, uint32_t backgroundColor,
+                            int renderFlags) {
+    FPDF_PAGE page = (FPDF_PAGE) 1;
+    int tileLeft = column * TILE_SIZE;
+    int tileTop = row * TILE_SIZE;
+    RenderTarget tile = {atlas.data(), std::min(TILE_SIZE, pageSizeHor - tileLeft),
+                         std::min(TILE_SIZE, pageSizeVer - tileTop),
+                         2 * TILE_SIZE * bytesPerPixel(format), format};
+    CHECK(renderTile(page, tile, tileLeft, tileTop, pageSizeHor, pageSizeVer, backgroundColor,
+                     false, renderFlags));
+}
+
+static void testTileIgnoresEarlierPixels(int format, int renderFlags) {
+    Random random((uint32_t) (format * 16 + renderFlags));
+    int stride = 2 * TILE_SIZE * bytesPerPixel(format);
+    for (uint32_t backgroundColor : {0u, 0x80112233u, 0xFF112233u}) {
+        for (int i = 0; i < 50; i++) {
+            int pageSizeHor = TILE_SIZE + random.nextInt(3 * TILE_SIZE);
+            int pageSizeVer = TILE_SIZE + random.nextInt(3 * TILE_SIZE);
+            int column = random.nextInt((pageSizeHor + TILE_SIZE - 1) / TILE_SIZE);
+            int row = random.nextInt((pageSizeVer + TILE_SIZE - 1) / TILE_SIZE);
+
+            // The slot holds garbage and then another tile before it is reused
+            std::vector<uint8_t> used((size_t) stride * TILE_SIZE);
+            random.fill(used.data(), used.size());
+            renderAtlasTile(used, format, 0, 0, pageSizeHor, pageSizeVer, backgroundColor,
+                            renderFlags);
+            renderAtlasTile(used, format, column, row, pageSizeHor, pageSizeVer,
+                            backgroundColor, renderFlags);
+            std::vector<uint8_t> fresh((size_t) stride * TILE_SIZE);
+            renderAtlasTile(fresh, format, column, row, pageSizeHor, pageSizeVer,
+                            backgroundColor, renderFlags);
+
+            int width = std::min(TILE_SIZE, pageSizeHor - column * TILE_SIZE);
+            int height = std::min(TILE_SIZE, pageSizeVer - row * TILE_SIZE);
+            for (int y = 0; y < height; y++) {
+                CHECK(memcmp(&used[(size_t) y * stride], &fresh[(size_t) y * stride],
+                             (size_t) width * bytesPerPixel(format)) == 0);
+            }
+        }
+    }
+}
+
+int main() {
+    testScrollMatchesFullRender(PIXEL_FORMAT_RGBA_8888, 0);
+    testScrollMatchesFullRender(PIXEL_FORMAT_BGR_888, 0);
+    testScrollMatchesFullRender(PIXEL_FORMAT_GRAY_8, 0);
+    testScrollMatchesFullRender(PIXEL_FORMAT_RGB_565, 0);
+    testScrollMatchesFullRender(PIXEL_FORMAT_RGB_565, RENDER_FLAG_DITHER);
+    testTileIgnoresEarlierPixels(PIXEL_FORMAT_RGBA_8888, 0);
+    testTileIgnoresEarlierPixels(PIXEL_FORMAT_RGBA_8888, RENDER_FLAG_TRANSPARENT);
+    testTileIgnoresEarlierPixels(PIXEL_FORMAT_RGB_565, 0);
+    testTileIgnoresEarlierPixels(PIXEL_FORMAT_RGB_565, RENDER_FLAG_DITHER);
+    printf("PageRenderTest passed\n");
+    return 0;
+}
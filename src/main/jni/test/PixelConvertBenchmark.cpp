@@ -0,0 +1,96 @@
+// Time of the RGB_565 conversions for one 1440x2560 frame, the scalar kernels against the
+// vector kernels of the host CPU. The per pixel conversion through a packed rgb struct that
+// rgbBitmapTo565 used before the kernels existed is timed as the baseline.
+
+#include "HostTest.h"
+
+#include <vector>
+
+#include "PixelConvert.h"
+
+using namespace tools;
+
+static const int FRAME_WIDTH = 1440;
+static const int FRAME_HEIGHT = 2560;
+static const int RUNS = 20;
+
+struct rgb {
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+};
+
+static uint16_t rgbTo565(rgb *color) {
+    return ((color->red >> 3) << 11) | ((color->green >> 2) << 5) | (color->blue >> 3);
+}
+
+static void perPixelTo565(const uint8_t *source, uint16_t *dest, int width) {
+    auto *color = (rgb *) source;
+    for (int x = 0; x < width; x++) {
+        dest[x] = rgbTo565(color++);
+    }
+}
+
+template<typename Convert>
+static double frameMillis(int sourceBytes, const std::vector<uint8_t> &source,
+                          std::vector<uint16_t> &dest, Convert convertRow) {
+    return hosttest::bestMillis(RUNS, [&]() {
+        for (int y = 0; y < FRAME_HEIGHT; y++) {
+            convertRow(&source[(size_t) y * FRAME_WIDTH * sourceBytes],
+                       &dest[(size_t) y * FRAME_WIDTH], y);
+        }
+    });
+}
+
+static void report(const char *name, double millis, double baseline) {
+    printf("%-28s %8.2f ms/frame %6.2fx\n", name, millis, baseline / millis);
+}
+
+int main() {
+    hosttest::Random random(565);
+    std::vector<uint8_t> source((size_t) FRAME_WIDTH * FRAME_HEIGHT * 4);
+    random.fill(source.data(), source.size());
+    std::vector<uint16_t> dest((size_t) FRAME_WIDTH * FRAME_HEIGHT);
+
+    printf("RGB_565 conversion of a %dx%d frame, best of %d runs\n", FRAME_WIDTH,
+           FRAME_HEIGHT, RUNS);
+    double baseline = frameMillis(3, source, dest, [](const uint8_t *s, uint16_t *d, int) {
+        perPixelTo565(s, d, FRAME_WIDTH);
+    });
+    report("per pixel rgb struct", baseline, baseline);
+    report("rgb24 scalar", frameMillis(3, source, dest, [](const uint8_t *s, uint16_t *d, int) {
+        rgb24To565Row_scalar(s, d, FRAME_WIDTH);
+    }), baseline);
+    report("rgb24 dither scalar", frameMillis(3, source, dest, [](const uint8_t *s, uint16_t *d,
+                                                                  int y) {
+        rgb24To565DitherRow_scalar(s, d, FRAME_WIDTH, 0, y);
+    }), baseline);
+    report("bgra scalar", frameMillis(4, source, dest, [](const uint8_t *s, uint16_t *d, int) {
+        bgraTo565Row_scalar(s, d, FRAME_WIDTH);
+    }), baseline);
+    report("bgra dither scalar", frameMillis(4, source, dest, [](const uint8_t *s, uint16_t *d,
+                                                                 int y) {
+        bgraTo565DitherRow_scalar(s, d, FRAME_WIDTH, 0, y);
+    }), baseline);
+#if defined(HAVE_VECTOR_KERNELS)
+    if (!vectorKernelsSupported()) {
+        printf("vector kernels are not supported by this CPU\n");
+        return 0;
+    }
+    report("rgb24 vector", frameMillis(3, source, dest, [](const uint8_t *s, uint16_t *d, int) {
+        VECTOR_KERNEL(rgb24To565Row)(s, d, FRAME_WIDTH);
+    }), baseline);
+    report("rgb24 dither vector", frameMillis(3, source, dest, [](const uint8_t *s, uint16_t *d,
+                                                                  int y) {
+        VECTOR_KERNEL(rgb24To565DitherRow)(s, d, FRAME_WIDTH, 0, y);
+    }), baseline);
+    report("bgra vector", frameMillis(4, source, dest, [](const uint8_t *s, uint16_t *d, int) {
+        VECTOR_KERNEL(bgraTo565Row)(s, d, FRAME_WIDTH);
+    }), baseline);
+    report("bgra dither vector", frameMillis(4, source, dest, [](const uint8_t *s, uint16_t *d,
+                                                                 int y) {
+        VECTOR_KERNEL(bgraTo565DitherRow)(s, d, FRAME_WIDTH, 0, y);
+    }), baseline);
+#endif
+    return 0;
+}
@@ -0,0 +1,289 @@
+// Golden pixels of the PixelConvert kernels and equality of the vector kernels with the scalar
+// ones. Vector kernels of the host CPU are checked, SSSE3 on x86 and NEON on ARM.
+
+#include "HostTest.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include "PixelConvert.h"
+
+using namespace tools;
+using hosttest::Random;
+
+// Widths up to here cover a few full vectors and every tail length
+static const int MAX_WIDTH = 70;
+
+static void testRgb24To565() {
+    const uint8_t source[] = {0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0xFF,
+                              0x00, 0x00, 0x00, 0xFF, 0x12, 0x34, 0x56};
+    const uint16_t expected[] = {0x0000, 0xFFFF, 0xF800, 0x07E0, 0x001F, 0x11AA};
+    uint16_t dest[6];
+    rgb24To565(source, sizeof(source), dest, sizeof(dest), 6, 1);
+    for (int i = 0; i < 6; i++) {
+        CHECK_EQ(expected[i], dest[i]);
+    }
+}
+
+static void testBgraTo565() {
+    const uint8_t source[] = {0xFF, 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0x00, 0xFF,
+                              0xFF, 0x56, 0x34, 0x12, 0x80};
+    const uint16_t expected[] = {0x001F, 0x07E0, 0xF800, 0x11AA};
+    uint16_t dest[4];
+    bgraTo565(source, sizeof(source), dest, sizeof(dest), 4, 1);
+    for (int i = 0; i < 4; i++) {
+        CHECK_EQ(expected[i], dest[i]);
+    }
+}
+
+// A flat 0x7C, 0x7E, 0x7A lies between two 565 levels in every channel, the 4x4 pattern
+// alternates between both
+static const uint16_t kDitherGolden[4][4] = {
+        {0x7BEF, 0x840F, 0x7BEF, 0x840F},
+        {0x8410, 0x7BEF, 0x8410, 0x7BEF},
+        {0x7BEF, 0x840F, 0x7BEF, 0x840F},
+        {0x8410, 0x7BEF, 0x8410, 0x7BEF}};
+
+static void testDither() {
+    const int size = 8;
+    uint8_t rgb[size * size * 3];
+    uint8_t bgra[size * size * 4];
+    for (int i = 0; i < size * size; i++) {
+        rgb[i * 3] = 0x7C;
+        rgb[i * 3 + 1] = 0x7E;
+        rgb[i * 3 + 2] = 0x7A;
+        bgra[i * 4] = 0x7A;
+        bgra[i * 4 + 1] = 0x7E;
+        bgra[i * 4 + 2] = 0x7C;
+        bgra[i * 4 + 3] = 0xFF;
+    }
+    // The origin is the page position of the first pixel and shifts the pattern with it,
+    // negative positions included
+    const int origins[][2] = {{0, 0}, {1, 2}, {3, 1}, {-1, -3}, {-6, 5}};
+    for (const int *origin : origins) {
+        uint16_t fromRgb[size * size];
+        uint16_t fromBgra[size * size];
+        rgb24To565Dither(rgb, size * 3, fromRgb, size * 2, size, size, origin[0], origin[1]);
+        bgraTo565Dither(bgra, size * 4, fromBgra, size * 2, size, size, origin[0], origin[1]);
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                uint16_t expected = kDitherGolden[(origin[1] + y) & 3][(origin[0] + x) & 3];
+                CHECK_EQ(expected, fromRgb[y * size + x]);
+                CHECK_EQ(expected, fromBgra[y * size + x]);
+            }
+        }
+    }
+
+    // Offsets saturate instead of wrapping white to black
+    uint8_t white[16 * 4];
+    memset(white, 0xFF, sizeof(white));
+    uint16_t dest[16];
+    for (int y = 0; y < 4; y++) {
+        rgb24To565DitherRow_scalar(white, dest, 16, 0, y);
+        for (int x = 0; x < 16; x++) {
+            CHECK_EQ(0xFFFF, dest[x]);
+        }
+        bgraTo565DitherRow_scalar(white, dest, 16, 0, y);
+        for (int x = 0; x < 16; x++) {
+            CHECK_EQ(0xFFFF, dest[x]);
+        }
+    }
+}
+
+// A row converted in two pieces at their page positions equals the row converted at once
+static void testDitherSplitRows() {
+    Random random(14);
+    uint8_t source[MAX_WIDTH * 4];
+    uint16_t whole[MAX_WIDTH];
+    uint16_t pieces[MAX_WIDTH];
+    for (int i = 0; i < 1000; i++) {
+        random.fill(source, sizeof(source));
+        int width = 1 + random.nextInt(MAX_WIDTH);
+        int split = random.nextInt(width + 1);
+        int x = random.nextInt(64) - 32;
+        int y = random.nextInt(64) - 32;
+        rgb24To565Dither(source, 0, whole, 0, width, 1, x, y);
+        rgb24To565Dither(source, 0, pieces, 0, split, 1, x, y);
+        rgb24To565Dither(source + split * 3, 0, pieces + split, 0, width - split, 1, x + split,
+                         y);
+        CHECK(memcmp(whole, pieces, width * 2) == 0);
+        bgraTo565Dither(source, 0, whole, 0, width, 1, x, y);
+        bgraTo565Dither(source, 0, pieces, 0, split, 1, x, y);
+        bgraTo565Dither(source + split * 4, 0, pieces + split, 0, width - split, 1, x + split,
+                        y);
+        CHECK(memcmp(whole, pieces, width * 2) == 0);
+    }
+}
+
+static void testSwapRedBlue() {
+    uint8_t pixels[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    const uint8_t expected[] = {3, 2, 1, 4, 7, 6, 5, 8};
+    uint8_t dest[8];
+    swapRedBlue(pixels, sizeof(pixels), dest, sizeof(dest), 2, 1);
+    CHECK(memcmp(expected, dest, sizeof(expected)) == 0);
+    // In place
+    swapRedBlue(pixels, sizeof(pixels), pixels, sizeof(pixels), 2, 1);
+    CHECK(memcmp(expected, pixels, sizeof(expected)) == 0);
+}
+
+static void testGray8() {
+    const uint8_t source[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF,
+                              0xFF, 0x00, 0xFF, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0xFF, 0x80, 0x80,
+                              0x80, 0x00};
+    // White, black, red, green, blue and a gray with zero alpha, alpha is ignored
+    const uint8_t expected[] = {255, 0, 76, 149, 30, 128};
+    uint8_t dest[6];
+    bgraToGray8(source, sizeof(source), dest, sizeof(dest), 6, 1);
+    CHECK(memcmp(expected, dest, sizeof(expected)) == 0);
+}
+
+static void testPremultiply() {
+    const uint8_t source[] = {200, 100, 50, 128, 200, 100, 50, 0, 200, 100, 50, 255};
+    const uint8_t expected[] = {100, 50, 25, 128, 0, 0, 0, 0, 200, 100, 50, 255};
+    uint8_t dest[12];
+    premultiply(source, sizeof(source), dest, sizeof(dest), 3, 1);
+    CHECK(memcmp(expected, dest, sizeof(expected)) == 0);
+
+    // Every value and alpha: premultiply rounds exactly, and unpremultiply gets back to the
+    // straight value within the precision left by alpha
+    std::vector<uint8_t> straight(256 * 4);
+    std::vector<uint8_t> multiplied(256 * 4);
+    std::vector<uint8_t> restored(256 * 4);
+    for (int alpha = 0; alpha < 256; alpha++) {
+        for (int value = 0; value < 256; value++) {
+            uint8_t *pixel = &straight[value * 4];
+            pixel[0] = pixel[1] = pixel[2] = (uint8_t) value;
+            pixel[3] = (uint8_t) alpha;
+        }
+        premultiply(straight.data(), 0, multiplied.data(), 0, 256, 1);
+        unpremultiply(multiplied.data(), 0, restored.data(), 0, 256, 1);
+        for (int value = 0; value < 256; value++) {
+            CHECK_EQ((2 * value * alpha + 255) / 510, multiplied[value * 4]);
+            CHECK_EQ(alpha, multiplied[value * 4 + 3]);
+            CHECK_EQ(alpha, restored[value * 4 + 3]);
+            if (alpha == 0) {
+                CHECK_EQ(0, restored[value * 4]);
+            } else {
+                int error = abs(restored[value * 4] - value);
+                CHECK(error * 2 * alpha <= 255 + 2 * alpha);
+            }
+        }
+    }
+}
+
+static void testRgb24Packing() {
+    const uint8_t source[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    const uint8_t swapped[] = {3, 2, 1, 7, 6, 5};
+    const uint8_t kept[] = {1, 2, 3, 5, 6, 7};
+    uint8_t dest[6];
+    bgraToRgb24(source, sizeof(source), dest, sizeof(dest), 2, 1);
+    CHECK(memcmp(swapped, dest, sizeof(dest)) == 0);
+    rgbaToRgb24(source, sizeof(source), dest, sizeof(dest), 2, 1);
+    CHECK(memcmp(kept, dest, sizeof(dest)) == 0);
+}
+
+static void testDownsample2x() {
+    // 4x2 pixels to 2x1, the second dest pixel checks rounding up at both averaging steps
+    const uint8_t source[] = {0, 0, 0, 0, 4, 8, 12, 255, 1, 0, 0, 0, 2, 0, 0, 0,
+                              8, 16, 24, 255, 12, 0, 4, 255, 0, 1, 0, 0, 0, 0, 0, 0};
+    const uint8_t expected[] = {6, 6, 10, 192, 1, 1, 0, 0};
+    uint8_t dest[8];
+    downsample2x(source, 16, dest, sizeof(dest), 2, 1);
+    CHECK(memcmp(expected, dest, sizeof(expected)) == 0);
+}
+
+#if defined(HAVE_VECTOR_KERNELS)
+static void compare565(Rgb24To565Row scalar, Rgb24To565Row vector, int sourceBytes) {
+    Random random(565);
+    uint8_t source[MAX_WIDTH * 4];
+    uint16_t expected[MAX_WIDTH];
+    uint16_t actual[MAX_WIDTH];
+    for (int width = 0; width <= MAX_WIDTH; width++) {
+        random.fill(source, (size_t) width * sourceBytes);
+        scalar(source, expected, width);
+        vector(source, actual, width);
+        CHECK(memcmp(expected, actual, (size_t) width * 2) == 0);
+    }
+}
+
+static void compareDither(Rgb24To565DitherRow scalar, Rgb24To565DitherRow vector,
+                          int sourceBytes) {
+    Random random(4);
+    uint8_t source[MAX_WIDTH * 4];
+    uint16_t expected[MAX_WIDTH];
+    uint16_t actual[MAX_WIDTH];
+    for (int width = 0; width <= MAX_WIDTH; width++) {
+        for (int x = -4; x < 4; x++) {
+            for (int y = -4; y < 4; y++) {
+                random.fill(source, (size_t) width * sourceBytes);
+                scalar(source, expected, width, x, y);
+                vector(source, actual, width, x, y);
+                CHECK(memcmp(expected, actual, (size_t) width * 2) == 0);
+            }
+        }
+    }
+}
+
+static void comparePixel32(Pixel32Row scalar, Pixel32Row vector, int destBytes) {
+    Random random(32);
+    uint8_t source[MAX_WIDTH * 4];
+    uint8_t expected[MAX_WIDTH * 4];
+    uint8_t actual[MAX_WIDTH * 4];
+    for (int width = 0; width <= MAX_WIDTH; width++) {
+        random.fill(source, sizeof(source));
+        scalar(source, expected, width);
+        vector(source, actual, width);
+        CHECK(memcmp(expected, actual, (size_t) width * destBytes) == 0);
+    }
+}
+
+static void compareDownsample() {
+    Random random(2);
+    uint8_t top[MAX_WIDTH * 8];
+    uint8_t bottom[MAX_WIDTH * 8];
+    uint8_t expected[MAX_WIDTH * 4];
+    uint8_t actual[MAX_WIDTH * 4];
+    for (int width = 0; width <= MAX_WIDTH; width++) {
+        random.fill(top, sizeof(top));
+        random.fill(bottom, sizeof(bottom));
+        downsample2xRow_scalar(top, bottom, expected, width);
+        VECTOR_KERNEL(downsample2xRow)(top, bottom, actual, width);
+        CHECK(memcmp(expected, actual, (size_t) width * 4) == 0);
+    }
+}
+
+static void testVectorKernels() {
+    if (!vectorKernelsSupported()) {
+        printf("vector kernels are not supported by this CPU, skipped\n");
+        return;
+    }
+    compare565(&rgb24To565Row_scalar, &VECTOR_KERNEL(rgb24To565Row), 3);
+    compare565(&bgraTo565Row_scalar, &VECTOR_KERNEL(bgraTo565Row), 4);
+    compareDither(&rgb24To565DitherRow_scalar, &VECTOR_KERNEL(rgb24To565DitherRow), 3);
+    compareDither(&bgraTo565DitherRow_scalar, &VECTOR_KERNEL(bgraTo565DitherRow), 4);
+    comparePixel32(&swapRedBlueRow_scalar, &VECTOR_KERNEL(swapRedBlueRow), 4);
+    comparePixel32(&bgraToGray8Row_scalar, &VECTOR_KERNEL(bgraToGray8Row), 1);
+    comparePixel32(&premultiplyRow_scalar, &VECTOR_KERNEL(premultiplyRow), 4);
+    comparePixel32(&bgraToRgb24Row_scalar, &VECTOR_KERNEL(bgraToRgb24Row), 3);
+    comparePixel32(&rgbaToRgb24Row_scalar, &VECTOR_KERNEL(rgbaToRgb24Row), 3);
+    compareDownsample();
+}
+#endif
+
+int main() {
+    testRgb24To565();
+    testBgraTo565();
+    testDither();
+    testDitherSplitRows();
+    testSwapRedBlue();
+    testGray8();
+    testPremultiply();
+    testRgb24Packing();
+    testDownsample2x();
+#if defined(HAVE_VECTOR_KERNELS)
+    testVectorKernels();
+#endif
+    printf("PixelConvertTest passed\n");
+    return 0;
+}
@@ -0,0 +1,138 @@
+// RenderQueue order, coalescing and cancellation, and close() waking a blocked take().
+
+#include "HostTest.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+
+#include "RenderQueue.h"
+
+using namespace tools;
+
+static RenderKey pageKey(int pageIndex, int64_t tag = 0) {
+    RenderKey key = {1, pageIndex, tag};
+    return key;
+}
+
+static int64_t submit(RenderQueue &queue, const RenderKey &key, int priority, int64_t group,
+                      bool expectCoalesced) {
+    bool coalesced = !expectCoalesced;
+    int64_t id = queue.submit(key, priority, group, &coalesced);
+    CHECK(id > 0);
+    CHECK(coalesced == expectCoalesced);
+    return id;
+}
+
+static void testPriorityThenNewestFirst() {
+    RenderQueue queue;
+    int64_t background = submit(queue, pageKey(1), RENDER_PRIORITY_BACKGROUND, 1, false);
+    int64_t prefetch = submit(queue, pageKey(2), RENDER_PRIORITY_PREFETCH, 1, false);
+    int64_t visibleOld = submit(queue, pageKey(3), RENDER_PRIORITY_VISIBLE, 1, false);
+    int64_t visibleNew = submit(queue, pageKey(4), RENDER_PRIORITY_VISIBLE, 1, false);
+    int64_t near = submit(queue, pageKey(5), RENDER_PRIORITY_NEAR_VISIBLE, 1, false);
+    // Out of range priorities are clamped
+    int64_t clamped = submit(queue, pageKey(6), 99, 1, false);
+    CHECK_EQ(6, queue.getStats().queued);
+    CHECK_EQ(visibleNew, queue.take());
+    CHECK_EQ(visibleOld, queue.take());
+    CHECK_EQ(near, queue.take());
+    CHECK_EQ(prefetch, queue.take());
+    CHECK_EQ(clamped, queue.take());
+    CHECK_EQ(background, queue.take());
+    RenderQueueStats stats = queue.getStats();
+    CHECK_EQ(0, stats.queued);
+    CHECK_EQ(6, stats.taken);
+}
+
+static void testCoalescing() {
+    RenderQueue queue;
+    int64_t first = submit(queue, pageKey(1), RENDER_PRIORITY_PREFETCH, 1, false);
+    int64_t other = submit(queue, pageKey(2), RENDER_PRIORITY_VISIBLE, 1, false);
+    // Another tag of the same page is another job
+    int64_t tagged = submit(queue, pageKey(1, 7), RENDER_PRIORITY_BACKGROUND, 1, false);
+    CHECK(tagged != first);
+
+    // Keeps its id, becomes visible and moves to group 2
+    CHECK_EQ(first, submit(queue, pageKey(1), RENDER_PRIORITY_VISIBLE, 2, true));
+    // A less urgent repeat keeps the visible priority but is the most recent request now
+    CHECK_EQ(first, submit(queue, pageKey(1), RENDER_PRIORITY_BACKGROUND, 3, true));
+    CHECK_EQ(3, queue.getStats().queued);
+    CHECK_EQ(first, queue.take());
+    CHECK_EQ(other, queue.take());
+
+    // The job left group 2 for group 3
+    int64_t again = submit(queue, pageKey(1), RENDER_PRIORITY_PREFETCH, 2, false);
+    CHECK(again != first);
+    CHECK_EQ(again, submit(queue, pageKey(1), RENDER_PRIORITY_PREFETCH, 3, true));
+    CHECK_EQ(0, queue.cancelGroup(2));
+    CHECK_EQ(1, queue.cancelGroup(3));
+    CHECK_EQ(tagged, queue.take());
+
+    RenderQueueStats stats = queue.getStats();
+    CHECK_EQ(7, stats.submitted);
+    CHECK_EQ(3, stats.coalesced);
+    CHECK_EQ(1, stats.cancelled);
+    CHECK_EQ(3, stats.taken);
+}
+
+static void testCancel() {
+    RenderQueue queue;
+    int64_t kept = submit(queue, pageKey(1), RENDER_PRIORITY_VISIBLE, 1, false);
+    int64_t shown = submit(queue, pageKey(2), RENDER_PRIORITY_VISIBLE, 2, false);
+    submit(queue, pageKey(3), RENDER_PRIORITY_PREFETCH, 2, false);
+    submit(queue, pageKey(4), RENDER_PRIORITY_BACKGROUND, 2, false);
+    CHECK(queue.cancel(shown));
+    CHECK(!queue.cancel(shown));
+    CHECK_EQ(2, queue.cancelGroup(2));
+    CHECK_EQ(0, queue.cancelGroup(2));
+    CHECK_EQ(kept, queue.take());
+    CHECK(!queue.cancel(kept));
+    // A cancelled key can be submitted again as a new job
+    CHECK(submit(queue, pageKey(2), RENDER_PRIORITY_VISIBLE, 2, false) != shown);
+    RenderQueueStats stats = queue.getStats();
+    CHECK_EQ(1, stats.queued);
+    CHECK_EQ(3, stats.cancelled);
+}
+
+static void testCloseWakesTake() {
+    RenderQueue queue;
+    std::atomic<bool> returned(false);
+    int64_t taken = 0;
+    std::thread taker([&]() {
+        taken = queue.take();
+        returned = true;
+    });
+    // Long enough for take() to wait on the empty queue
+    usleep(50 * 1000);
+    CHECK(!returned);
+    queue.close();
+    taker.join();
+    CHECK_EQ(-1, taken);
+    // Closed for good, jobs submitted afterwards are never taken
+    submit(queue, pageKey(1), RENDER_PRIORITY_VISIBLE, 1, false);
+    CHECK_EQ(-1, queue.take());
+}
+
+static void testTakeWaitsForSubmit() {
+    RenderQueue queue;
+    int64_t taken = 0;
+    std::thread taker([&]() {
+        taken = queue.take();
+    });
+    usleep(50 * 1000);
+    int64_t id = submit(queue, pageKey(1), RENDER_PRIORITY_VISIBLE, 1, false);
+    taker.join();
+    CHECK_EQ(id, taken);
+}
+
+int main() {
+    testPriorityThenNewestFirst();
+    testCoalescing();
+    testCancel();
+    testCloseWakesTake();
+    testTakeWaitsForSubmit();
+    printf("RenderQueueTest passed\n");
+    return 0;
+}
@@ -0,0 +1,257 @@
+// RenderWorkerPool with the host build of the helper executable, which renders FakePdfium
+// pages. The workers have to match an in-process render of the same page, survive wrong
+// passwords, lose only themselves on a crash and start as fresh processes without the files
+// and locks of the pool's process.
+
+#include "HostTest.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PageRender.h"
+#include "RenderWorkers.h"
+
+using namespace tools;
+using hosttest::Random;
+
+static const int WORKER_COUNT = 4;
+
+static std::string gWorkerPath;
+static WorkerDocument gDocument;
+
+struct Jobs {
+    std::vector<WorkerJob> jobs;
+    std::vector<std::vector<uint8_t>> rendered;
+    std::vector<std::vector<uint8_t>> expected;
+
+    // Random targets of every format, with the same initial pixels in both buffers
+    Jobs(Random &random, int count) : jobs((size_t) count), rendered((size_t) count),
+                                      expected((size_t) count) {
+        static const int FORMATS[] = {PIXEL_FORMAT_RGBA_8888, PIXEL_FORMAT_RGB_565,
+                                      PIXEL_FORMAT_GRAY_8, PIXEL_FORMAT_BGR_888};
+        for (int i = 0; i < count; i++) {
+            int format = FORMATS[i % 4];
+            int width = 20 + random.nextInt(300);
+            int height = 20 + random.nextInt(300);
+            int stride = (width * bytesPerPixel(format) + 3) & ~3;
+            rendered[i].resize((size_t) stride * height);
+            random.fill(rendered[i].data(), rendered[i].size());
+            expected[i] = rendered[i];
+            WorkerJob &job = jobs[i];
+            job.pageIndex = i % 5;
+            job.target = {rendered[i].data(), width, height, stride, format};
+            job.startX = random.nextInt(40) - 20;
+            job.startY = random.nextInt(40) - 20;
+            job.drawSizeHor = width - random.nextInt(30);
+            job.drawSizeVer = height + random.nextInt(30);
+        }
+    }
+
+    void checkRendered(uint32_t backgroundColor) {
+        for (size_t i = 0; i < jobs.size(); i++) {
+            const WorkerJob &job = jobs[i];
+            CHECK(job.rendered);
+            RenderTarget target = job.target;
+            target.pixels = expected[i].data();
+            CHECK(renderPage((FPDF_PAGE) (intptr_t) (job.pageIndex + 1), target, job.startX,
+                             job.startY, job.drawSizeHor, job.drawSizeVer, backgroundColor,
+                             false, 0));
+            CHECK(rendered[i] == expected[i]);
+        }
+    }
+};
+
+static void testWorkersMatchInProcessRender() {
+    RenderWorkerPool pool;
+    CHECK_EQ(WORKER_COUNT, pool.start(gWorkerPath.c_str(), WORKER_COUNT));
+    Random random(1);
+    // The transparent background makes the workers start from the pixels of the target
+    for (uint32_t backgroundColor : {0xFF102030u, 0x80102030u, 0u}) {
+        Jobs jobs(random, 40);
+        pool.render(gDocument, jobs.jobs.data(), (int) jobs.jobs.size(), backgroundColor, false,
+                    0);
+        jobs.checkRendered(backgroundColor);
+    }
+    CHECK_EQ(WORKER_COUNT, pool.getWorkerCount());
+}
+
+static void testPasswords() {
+    RenderWorkerPool pool;
+    CHECK_EQ(WORKER_COUNT, pool.start(gWorkerPath.c_str(), WORKER_COUNT));
+    Random random(2);
+    WorkerDocument document = gDocument;
+    document.id = 2;
+    document.password = "wrong";
+    Jobs failing(random, 8);
+    pool.render(document, failing.jobs.data(), (int) failing.jobs.size(), 0xFFFFFFFF, false, 0);
+    for (const WorkerJob &job : failing.jobs) {
+        CHECK(!job.rendered);
+    }
+    CHECK_EQ(WORKER_COUNT, pool.getWorkerCount());
+
+    document.id = 3;
+    document.password = FAKE_PDFIUM_PASSWORD;
+    Jobs jobs(random, 8);
+    pool.render(document, jobs.jobs.data(), (int) jobs.jobs.size(), 0xFFFFFFFF, false, 0);
+    jobs.checkRendered(0xFFFFFFFF);
+}
+
+static void testCrashOnlyLosesItsWorker() {
+    RenderWorkerPool pool;
+    CHECK_EQ(WORKER_COUNT, pool.start(gWorkerPath.c_str(), WORKER_COUNT));
+    Random random(3);
+    Jobs jobs(random, 20);
+    jobs.jobs[7].pageIndex = FAKE_PDFIUM_CRASH_PAGE;
+    pool.render(gDocument, jobs.jobs.data(), (int) jobs.jobs.size(), 0xFFFFFFFF, false, 0);
+    CHECK(!jobs.jobs[7].rendered);
+    CHECK_EQ(WORKER_COUNT - 1, pool.getWorkerCount());
+    jobs.jobs.erase(jobs.jobs.begin() + 7);
+    jobs.rendered.erase(jobs.rendered.begin() + 7);
+    jobs.expected.erase(jobs.expected.begin() + 7);
+    jobs.checkRendered(0xFFFFFFFF);
+}
+
+// Processes whose parent is this one
+static std::vector<pid_t> childProcesses() {
+    std::vector<pid_t> children;
+    DIR *directory = opendir("/proc");
+    CHECK(directory != nullptr);
+    while (struct dirent *entry = readdir(directory)) {
+        pid_t pid = atoi(entry->d_name);
+        if (pid <= 0) {
+            continue;
+        }
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+        FILE *file = fopen(path, "r");
+        if (file == nullptr) {
+            continue;
+        }
+        char stat[512];
+        size_t size = fread(stat, 1, sizeof(stat) - 1, file);
+        fclose(file);
+        stat[size] = 0;
+        // pid (comm) state ppid, the name may contain spaces and parentheses
+        const char *end = strrchr(stat, ')');
+        char state;
+        int parent;
+        if (end != nullptr && sscanf(end + 1, " %c %d", &state, &parent) == 2 &&
+            parent == getpid()) {
+            children.push_back(pid);
+        }
+    }
+    closedir(directory);
+    return children;
+}
+
+static std::string readLink(const std::string &path) {
+    char target[PATH_MAX];
+    ssize_t size = readlink(path.c_str(), target, sizeof(target) - 1);
+    return size > 0 ? std::string(target, (size_t) size) : std::string();
+}
+
+static void testWorkersDoNotInheritFiles() {
+    // Left open across exec by the process, like the binder driver of an app
+    int pipeFds[2];
+    CHECK(pipe(pipeFds) == 0);
+    std::string leaked = readLink("/proc/self/fd/" + std::to_string(pipeFds[0]));
+
+    RenderWorkerPool pool;
+    CHECK_EQ(WORKER_COUNT, pool.start(gWorkerPath.c_str(), WORKER_COUNT));
+    std::vector<pid_t> workers = childProcesses();
+    CHECK_EQ(WORKER_COUNT, workers.size());
+    char helperPath[PATH_MAX];
+    CHECK(realpath(gWorkerPath.c_str(), helperPath) != nullptr);
+    for (pid_t worker : workers) {
+        std::string directory = "/proc/" + std::to_string(worker);
+        CHECK(readLink(directory + "/exe") == helperPath);
+        DIR *fds = opendir((directory + "/fd").c_str());
+        CHECK(fds != nullptr);
+        int count = 0;
+        while (struct dirent *entry = readdir(fds)) {
+            if (entry->d_name[0] == '.') {
+                continue;
+            }
+            count++;
+            CHECK(readLink(directory + "/fd/" + entry->d_name) != leaked);
+        }
+        closedir(fds);
+        // Standard streams and the socket
+        CHECK(count <= 4);
+    }
+    close(pipeFds[0]);
+    close(pipeFds[1]);
+}
+
+// A fork copies the locks other threads hold, a child which allocated before exec could wait
+// forever for one of them. The helper is executed right after the fork, so pools start while
+// other threads allocate.
+static void testStartWhileThreadsAllocate() {
+    std::atomic<bool> running(true);
+    std::mutex mutex;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&running, &mutex]() {
+            while (running) {
+                std::lock_guard<std::mutex> guard(mutex);
+                std::vector<std::string> strings;
+                for (int j = 0; j < 64; j++) {
+                    strings.push_back(std::string(1000 + j, 'x'));
+                }
+            }
+        });
+    }
+    for (int i = 0; i < 20; i++) {
+        RenderWorkerPool pool;
+        CHECK_EQ(WORKER_COUNT, pool.start(gWorkerPath.c_str(), WORKER_COUNT));
+    }
+    running = false;
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+static void testMissingHelper() {
+    RenderWorkerPool pool;
+    CHECK_EQ(0, pool.start((gWorkerPath + ".missing").c_str(), WORKER_COUNT));
+    CHECK_EQ(0, pool.getWorkerCount());
+    CHECK(childProcesses().empty());
+}
+
+int main(int argc, char **argv) {
+    // The host helper is built next to the test
+    gWorkerPath = argv[0];
+    gWorkerPath.replace(gWorkerPath.rfind('/') + 1, std::string::npos, "RenderWorker");
+
+    char documentPath[] = "/tmp/RenderWorkersTestXXXXXX";
+    int fd = mkstemp(documentPath);
+    CHECK(fd >= 0);
+    unlink(documentPath);
+    static const char content[] = "%PDF-1.4\n";
+    CHECK(write(fd, content, sizeof(content) - 1) == sizeof(content) - 1);
+    gDocument.id = 1;
+    gDocument.fd = fd;
+    gDocument.offset = 0;
+    gDocument.length = sizeof(content) - 1;
+    gDocument.password = nullptr;
+
+    testWorkersMatchInProcessRender();
+    testPasswords();
+    testCrashOnlyLosesItsWorker();
+    testWorkersDoNotInheritFiles();
+    testStartWhileThreadsAllocate();
+    testMissingHelper();
+    close(fd);
+    printf("RenderWorkersTest passed\n");
+    return 0;
+}
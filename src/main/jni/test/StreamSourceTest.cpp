@@ -0,0 +1,176 @@
+// StreamSource against a download written into a temporary file. Reported ranges merge when
+// they touch, download hints are clamped to the file and forgotten once they arrived, pdfium
+// only reads reported bytes even when the file already holds more, and the source lives until
+// its last reference is released.
+
+#include "HostTest.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "StreamSource.h"
+
+using namespace tools;
+using hosttest::Random;
+
+// Ten hint chunks and a short last one
+static const int64_t LENGTH = 10 * (int64_t) FAKE_PDFIUM_AVAIL_CHUNK + 100;
+
+static std::vector<uint8_t> gContent;
+
+// A download which has written the first bytes so far
+static int createFile(size_t written) {
+    char path[] = "/tmp/StreamSourceTestXXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    unlink(path);
+    CHECK(write(fd, gContent.data(), written) == (ssize_t) written);
+    return fd;
+}
+
+static StreamSource *createSource(size_t written) {
+    auto source = new StreamSource(createFile(written), LENGTH);
+    CHECK(source->create());
+    return source;
+}
+
+// Read through the loader pdfium gets and compare with the content
+static bool read(int64_t position, size_t size) {
+    FPDF_FILEACCESS *loader = fakePdfiumAvailLoader();
+    CHECK(loader != nullptr);
+    std::vector<uint8_t> out(size);
+    if (!loader->m_GetBlock(loader->m_Param, (unsigned long) position, out.data(),
+                            (unsigned long) size)) {
+        return false;
+    }
+    CHECK(memcmp(out.data(), &gContent[(size_t) position], size) == 0);
+    return true;
+}
+
+static void checkRanges(StreamSource *source, const std::vector<int64_t> &expected) {
+    CHECK(source->getRequestedRanges() == expected);
+}
+
+static void testAvailableRangesMerge() {
+    StreamSource *source = createSource((size_t) LENGTH);
+    // Touching in any order
+    source->addAvailableRange(100, 100);
+    source->addAvailableRange(0, 100);
+    CHECK(read(50, 100));
+    // Overlapping, and one range bridging two others
+    source->addAvailableRange(300, 100);
+    source->addAvailableRange(500, 100);
+    CHECK(!read(300, 300));
+    source->addAvailableRange(350, 200);
+    CHECK(read(300, 300));
+    CHECK(!read(150, 200));
+    source->addAvailableRange(200, 100);
+    CHECK(read(0, 600));
+    CHECK(!read(0, 601));
+    // Clamped to the file
+    source->addAvailableRange(-100, 700);
+    source->addAvailableRange(LENGTH - 10, 100);
+    CHECK(read(LENGTH - 10, 10));
+    CHECK(!read(LENGTH - 10, 11));
+    source->release();
+}
+
+static void testRequestedRanges() {
+    StreamSource *source = createSource((size_t) LENGTH);
+    int64_t chunk = (int64_t) FAKE_PDFIUM_AVAIL_CHUNK;
+    // The hints of every chunk merge into one range, the last one ends at the end of the file
+    CHECK_EQ(PDF_DATA_NOTAVAIL, source->isDocumentAvailable());
+    checkRanges(source, {0, LENGTH});
+    // Hinted again, still one range
+    CHECK_EQ(PDF_DATA_NOTAVAIL, source->isDocumentAvailable());
+    checkRanges(source, {0, LENGTH});
+
+    // What arrived is dropped, what is left of a partly arrived range stays
+    source->addAvailableRange(0, chunk);
+    source->addAvailableRange(3 * chunk + 10, chunk);
+    source->addAvailableRange(LENGTH - 50, 50);
+    checkRanges(source, {chunk, 2 * chunk + 10, 4 * chunk + 10, LENGTH - 50 - (4 * chunk + 10)});
+    source->addAvailableRange(chunk, 2 * chunk + 10);
+    checkRanges(source, {4 * chunk + 10, LENGTH - 50 - (4 * chunk + 10)});
+    // Forgotten once arrived, even without new hints
+    source->addAvailableRange(4 * chunk, LENGTH);
+    checkRanges(source, {});
+    checkRanges(source, {});
+    CHECK_EQ(PDF_DATA_AVAIL, source->isDocumentAvailable());
+    checkRanges(source, {});
+    source->release();
+}
+
+static void testUnreportedBytesAreNotRead() {
+    // Only part of the file is written and reported so far
+    size_t written = 3000;
+    int fd = createFile(written);
+    auto source = new StreamSource(fd, LENGTH);
+    CHECK(source->create());
+    source->addAvailableRange(0, 2000);
+    CHECK(read(0, 2000));
+    CHECK(!read(1500, 1000));
+
+    // The download writes on, the file holds those bytes before they are reported
+    CHECK(pwrite(fd, &gContent[written], 3000, (off_t) written) == 3000);
+    CHECK(!read(2500, 1000));
+    CHECK(!read(4000, 100));
+    source->addAvailableRange(2000, 4000);
+    CHECK(read(1500, 4500));
+    CHECK(!read(5000, 1001));
+    // Nothing is read past the document, whatever is reported
+    source->addAvailableRange(0, 2 * LENGTH);
+    CHECK(!read(LENGTH - 1, 2));
+    source->release();
+}
+
+static void testDocument() {
+    StreamSource *source = createSource((size_t) LENGTH);
+    CHECK_EQ(PDF_DATA_NOTAVAIL, source->isDocumentAvailable());
+    CHECK_EQ(PDF_DATA_ERROR, source->isPageAvailable(0));
+    source->addAvailableRange(0, LENGTH);
+    CHECK_EQ(PDF_DATA_AVAIL, source->isDocumentAvailable());
+    CHECK_EQ(PDF_NOT_LINEARIZED, source->isLinearized());
+    CHECK(source->getDocument(FAKE_PDFIUM_PASSWORD) != nullptr);
+    // Opened at most once
+    CHECK(source->getDocument(FAKE_PDFIUM_PASSWORD) == nullptr);
+    CHECK_EQ(PDF_DATA_AVAIL, source->isPageAvailable(3));
+    source->detachDocument();
+    CHECK_EQ(PDF_DATA_ERROR, source->isPageAvailable(3));
+    source->release();
+}
+
+// The loader and the document each hold a reference, the last release closes the file
+static void testReleaseByLastOwner() {
+    int fd = createFile((size_t) LENGTH);
+    auto source = new StreamSource(fd, LENGTH);
+    CHECK(source->create());
+    source->acquire();
+    source->release();
+    CHECK(fcntl(fd, F_GETFD) != -1);
+    CHECK(fakePdfiumAvailLoader() != nullptr);
+    source->addAvailableRange(0, LENGTH);
+    CHECK(read(0, (size_t) LENGTH));
+    source->release();
+    CHECK(fcntl(fd, F_GETFD) == -1);
+    CHECK(fakePdfiumAvailLoader() == nullptr);
+}
+
+int main() {
+    gContent.resize((size_t) LENGTH);
+    Random random(7);
+    random.fill(gContent.data(), gContent.size());
+    memcpy(gContent.data(), "%PDF", 4);
+
+    testAvailableRangesMerge();
+    testRequestedRanges();
+    testUnreportedBytesAreNotRead();
+    testDocument();
+    testReleaseByLastOwner();
+    printf("StreamSourceTest passed\n");
+    return 0;
+}
@@ -0,0 +1,106 @@
+// TileCache with tiles from renderTile. A tile rendered into a used atlas slot and served from
+// the cache has to match a render into a fresh atlas, the budget evicts the least recently used
+// tiles first.
+
+#include "HostTest.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "PageRender.h"
+#include "TileCache.h"
+
+using namespace tools;
+using hosttest::Random;
+
+static const int TILE_SIZE = 64;
+// Atlas of two slots side by side, the tile goes into the first one
+static const int ATLAS_STRIDE = 2 * TILE_SIZE * 4;
+
+static TileKey tileKey(int column, int row) {
+    TileKey key;
+    memset(&key, 0, sizeof(key));
+    key.document = 1;
+    key.zoomBucket = TILE_ZOOM_BUCKETS;
+    key.column = column;
+    key.row = row;
+    key.tileSize = TILE_SIZE;
+    key.format = PIXEL_FORMAT_RGBA_8888;
+    return key;
+}
+
+static void renderAtlasTile(std::vector<uint8_t> &atlas, int column, int row, int pageSize) {
+    RenderTarget tile = {atlas.data(), std::min(TILE_SIZE, pageSize - column * TILE_SIZE),
+                         std::min(TILE_SIZE, pageSize - row * TILE_SIZE), ATLAS_STRIDE,
+                         PIXEL_FORMAT_RGBA_8888};
+    CHECK(renderTile((FPDF_PAGE) 1, tile, column * TILE_SIZE, row * TILE_SIZE, pageSize,
+                     pageSize, 0, false, 0));
+}
+
+static void testCachedTileMatchesFreshRender() {
+    Random random(1);
+    // Edge tiles of the page only cover part of their slot
+    int pageSize = 3 * TILE_SIZE - 10;
+    TileCache cache(1024 * 1024);
+    std::vector<uint8_t> atlas((size_t) ATLAS_STRIDE * TILE_SIZE);
+    random.fill(atlas.data(), atlas.size());
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 3; column++) {
+            // The slot is reused for every tile, as in an atlas the viewer recycles
+            renderAtlasTile(atlas, column, row, pageSize);
+            int width = std::min(TILE_SIZE, pageSize - column * TILE_SIZE);
+            int height = std::min(TILE_SIZE, pageSize - row * TILE_SIZE);
+            cache.put(tileKey(column, row), atlas.data(), ATLAS_STRIDE, width, height, 4);
+        }
+    }
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 3; column++) {
+            std::vector<uint8_t> cached((size_t) ATLAS_STRIDE * TILE_SIZE);
+            CHECK(cache.get(tileKey(column, row), cached.data(), ATLAS_STRIDE));
+            std::vector<uint8_t> fresh((size_t) ATLAS_STRIDE * TILE_SIZE);
+            renderAtlasTile(fresh, column, row, pageSize);
+            CHECK(cached == fresh);
+        }
+    }
+    TileCacheStats stats = cache.getStats();
+    CHECK_EQ(9, stats.hits);
+    CHECK_EQ(0, stats.misses);
+    CHECK_EQ(9, stats.tileCount);
+}
+
+static void testBudgetEvictsLeastRecentlyUsed() {
+    size_t tileBytes = (size_t) TILE_SIZE * TILE_SIZE * 4;
+    TileCache cache(3 * tileBytes);
+    std::vector<uint8_t> pixels((size_t) ATLAS_STRIDE * TILE_SIZE);
+    for (int column = 0; column < 3; column++) {
+        cache.put(tileKey(column, 0), pixels.data(), ATLAS_STRIDE, TILE_SIZE, TILE_SIZE, 4);
+    }
+    // Tile 0 becomes the most recently used, tile 1 is evicted by the fourth one
+    CHECK(cache.get(tileKey(0, 0), pixels.data(), ATLAS_STRIDE));
+    cache.put(tileKey(3, 0), pixels.data(), ATLAS_STRIDE, TILE_SIZE, TILE_SIZE, 4);
+    CHECK(cache.get(tileKey(0, 0), pixels.data(), ATLAS_STRIDE));
+    CHECK(!cache.get(tileKey(1, 0), pixels.data(), ATLAS_STRIDE));
+    CHECK(cache.get(tileKey(2, 0), pixels.data(), ATLAS_STRIDE));
+    TileCacheStats stats = cache.getStats();
+    CHECK_EQ(1, stats.evictions);
+    CHECK_EQ(3 * tileBytes, stats.sizeBytes);
+
+    // A different background is a different tile
+    TileKey key = tileKey(0, 0);
+    key.background = 0xFFFFFFFF;
+    CHECK(!cache.get(key, pixels.data(), ATLAS_STRIDE));
+
+    cache.setBudget(tileBytes);
+    CHECK_EQ(1, cache.getStats().tileCount);
+    cache.clear();
+    CHECK_EQ(0, cache.getStats().sizeBytes);
+}
+
+int main() {
+    testCachedTileMatchesFreshRender();
+    testBudgetEvictsLeastRecentlyUsed();
+    printf("TileCacheTest passed\n");
+    return 0;
+}